@@ -0,0 +1,425 @@
+// =================================================================================================
+//
+// Name ............: ImageCorrelation.h
+// Description .....: Normalized cross-correlation through a built-in real FFT.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// The FFT plans, the per-screen spectra and moment tables, and the correlation surface and its
+// peaks. Free of OS dependencies; checked against a naive DFT and a brute-force correlation by
+// tests/ImageCorrelationTest.cpp.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <complex>
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <bit>
+
+#include "ImageKernels.h"
+#include "ImageParallel.h"
+#include "ImageWindowStats.h"
+
+// =================================================================================================
+// #BLOCK# NORMALIZED CROSS-CORRELATION
+// Brightness- and contrast-invariant matching. The correlation of a template with every screen
+// position is computed at once in the frequency domain, the window statistics come from
+// summed-area tables, so the cost hardly depends on the template size.
+// =================================================================================================
+
+namespace Correlation {
+
+    using Complex = std::complex<float>;
+
+    // Plain complex product; std::complex's operator* adds NaN/Inf recovery that is not needed here.
+    inline Complex Multiply(Complex a, Complex b) noexcept {
+        return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+    }
+
+    inline Complex MultiplyConjugate(Complex a, Complex b) noexcept {
+        return { a.real() * b.real() + a.imag() * b.imag(), a.imag() * b.real() - a.real() * b.imag() };
+    }
+
+    /**
+     * @class FftPlan
+     * @brief Bit-reversal table and twiddle factors of an in-place radix-2 complex FFT of one size.
+     */
+    class FftPlan {
+    public:
+        explicit FftPlan(int size) : size_(size), reversed_(size, 0), twiddles_{ std::vector<Complex>(std::max(1, size / 2)), std::vector<Complex>(std::max(1, size / 2)) } {
+            const int bits = std::countr_zero(static_cast<unsigned>(size));
+            for (int i = 1; i < size; ++i) {
+                reversed_[i] = (reversed_[i >> 1] >> 1) | ((i & 1) << (bits - 1));
+            }
+            constexpr double kTwoPi = 6.283185307179586;
+            for (int i = 0; i < size / 2; ++i) {
+                const double angle = kTwoPi * i / size;
+                twiddles_[0][i] = { static_cast<float>(std::cos(angle)), static_cast<float>(-std::sin(angle)) };
+                twiddles_[1][i] = std::conj(twiddles_[0][i]);
+            }
+        }
+
+        int Size() const noexcept { return size_; }
+
+        /**
+         * @brief Transforms `count` interleaved sequences at once: element i of sequence k is
+         * data[i * count + k]. Every butterfly then runs over `count` contiguous values, which the
+         * compiler vectorizes. The inverse transform is not scaled by 1 / size.
+         */
+        void TransformMany(Complex* data, int count, bool inverse) const noexcept {
+            for (int i = 0; i < size_; ++i) {
+                if (i < reversed_[i]) std::swap_ranges(data + static_cast<size_t>(i) * count,
+                    data + static_cast<size_t>(i + 1) * count, data + static_cast<size_t>(reversed_[i]) * count);
+            }
+            const Complex* twiddles = twiddles_[inverse].data();
+            for (int half = 1; half < size_; half <<= 1) {
+                const int step = size_ / (half * 2);
+                for (int start = 0; start < size_; start += half * 2) {
+                    for (int k = 0; k < half; ++k) {
+                        const float wr = twiddles[k * step].real(), wi = twiddles[k * step].imag();
+                        float* lower = reinterpret_cast<float*>(data + static_cast<size_t>(start + k) * count);
+                        float* upper = reinterpret_cast<float*>(data + static_cast<size_t>(start + k + half) * count);
+                        for (int j = 0; j < 2 * count; j += 2) {
+                            const float odd_r = upper[j] * wr - upper[j + 1] * wi;
+                            const float odd_i = upper[j] * wi + upper[j + 1] * wr;
+                            upper[j] = lower[j] - odd_r;
+                            upper[j + 1] = lower[j + 1] - odd_i;
+                            lower[j] += odd_r;
+                            lower[j + 1] += odd_i;
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief Transforms `data` in place. The inverse transform is not scaled by 1 / size.
+         */
+        void Transform(Complex* data, bool inverse) const noexcept {
+            for (int i = 0; i < size_; ++i) {
+                if (i < reversed_[i]) std::swap(data[i], data[reversed_[i]]);
+            }
+            const Complex* twiddles = twiddles_[inverse].data();
+            for (int half = 1; half < size_; half <<= 1) {
+                const int step = size_ / (half * 2);
+                for (int start = 0; start < size_; start += half * 2) {
+                    Complex* lower = data + start;
+                    Complex* upper = lower + half;
+                    for (int k = 0; k < half; ++k) {
+                        const Complex odd = Multiply(upper[k], twiddles[k * step]);
+                        upper[k] = lower[k] - odd;
+                        lower[k] += odd;
+                    }
+                }
+            }
+        }
+
+    private:
+        int size_;
+        std::vector<int> reversed_;
+        std::vector<Complex> twiddles_[2]; // Forward, inverse.
+    };
+
+    /**
+     * @class RealFftPlan
+     * @brief FFT of a real sequence of even length N through a complex FFT of length N / 2.
+     * The even and odd samples are packed into one complex sequence, transformed together and then
+     * separated, which halves both the work and the spectrum size (N / 2 + 1 bins).
+     */
+    class RealFftPlan {
+    public:
+        explicit RealFftPlan(int size) : half_(size / 2), twiddles_(size / 2 + 1) {
+            constexpr double kTwoPi = 6.283185307179586;
+            for (int k = 0; k <= size / 2; ++k) {
+                const double angle = kTwoPi * k / size;
+                twiddles_[k] = { static_cast<float>(std::cos(angle)), static_cast<float>(-std::sin(angle)) };
+            }
+        }
+
+        int Bins() const noexcept { return half_.Size() + 1; }
+
+        /**
+         * @brief Transforms `size` real samples into `size / 2 + 1` bins. `scratch` holds size / 2 values.
+         */
+        void Forward(const float* input, Complex* output, Complex* scratch) const noexcept {
+            const int m = half_.Size();
+            for (int k = 0; k < m; ++k) scratch[k] = { input[2 * k], input[2 * k + 1] };
+            half_.Transform(scratch, false);
+
+            for (int k = 0; k <= m; ++k) {
+                const Complex z = scratch[k % m];
+                const Complex mirrored = std::conj(scratch[(m - k) % m]);
+                const Complex even = (z + mirrored) * 0.5f;
+                const Complex diff = z - mirrored;
+                const Complex odd = { diff.imag() * 0.5f, -diff.real() * 0.5f }; // diff / 2i
+                output[k] = even + Multiply(twiddles_[k], odd);
+            }
+        }
+
+        /**
+         * @brief Inverse of Forward, scaled by size / 2.
+         */
+        void Inverse(const Complex* input, float* output, Complex* scratch) const noexcept {
+            const int m = half_.Size();
+            for (int k = 0; k < m; ++k) {
+                const Complex mirrored = std::conj(input[m - k]);
+                const Complex even = (input[k] + mirrored) * 0.5f;
+                const Complex odd = MultiplyConjugate((input[k] - mirrored) * 0.5f, twiddles_[k]);
+                scratch[k] = { even.real() - odd.imag(), even.imag() + odd.real() }; // even + i * odd
+            }
+            half_.Transform(scratch, true);
+            for (int k = 0; k < m; ++k) {
+                output[2 * k] = scratch[k].real();
+                output[2 * k + 1] = scratch[k].imag();
+            }
+        }
+
+    private:
+        FftPlan half_;
+        std::vector<Complex> twiddles_;
+    };
+
+    /**
+     * @struct Spectrum
+     * @brief 2D spectra of the three color channels of an image zero-padded to width x height
+     * (powers of two). Each row holds `bins` = width / 2 + 1 values; the rest follows from symmetry.
+     */
+    struct Spectrum {
+        int width = 0;
+        int height = 0;
+        int bins = 0;
+        std::array<std::vector<Complex>, 3> channels;
+    };
+
+    /**
+     * @brief Runs body(begin, end) over [0, count) split into bands across `threads` cores.
+     */
+    template <class Body>
+    inline void ForEachRange(int count, int threads, Body&& body) {
+        const int bands = std::max(1, std::min(count, threads * 4));
+        const int band_size = (count + bands - 1) / bands;
+        RunBands(bands, threads, [&](int band) {
+            const int begin = band * band_size;
+            const int end = std::min(count, begin + band_size);
+            if (begin < end) body(begin, end);
+        });
+    }
+
+    // Bin columns gathered per pass, so that each row is read in one contiguous chunk.
+    constexpr int kColumnBlock = 16;
+
+    /**
+     * @brief Column pass of a 2D transform: a complex FFT down every bin column.
+     */
+    inline void TransformColumns(std::vector<Complex>& data, int bins, const FftPlan& columns, bool inverse, int threads) {
+        const int height = columns.Size();
+        const int blocks = (bins + kColumnBlock - 1) / kColumnBlock;
+        ForEachRange(blocks, threads, [&](int begin, int end) {
+            std::vector<Complex> block(static_cast<size_t>(kColumnBlock) * height);
+            for (int b = begin; b < end; ++b) {
+                const int first = b * kColumnBlock;
+                const int count = std::min(kColumnBlock, bins - first);
+                for (int y = 0; y < height; ++y) {
+                    std::copy_n(&data[static_cast<size_t>(y) * bins + first], count, &block[static_cast<size_t>(y) * count]);
+                }
+                columns.TransformMany(block.data(), count, inverse);
+                for (int y = 0; y < height; ++y) {
+                    std::copy_n(&block[static_cast<size_t>(y) * count], count, &data[static_cast<size_t>(y) * bins + first]);
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief Zero-padded width x height 2D spectrum of one channel of `image`, with `value(pixel)`
+     * giving the samples. `data` is resized to height rows of width / 2 + 1 bins.
+     */
+    template <class Value>
+    inline void TransformChannel(const PixelBuffer& image, int width, int height, Value&& value, std::vector<Complex>& data, int threads) {
+        const int bins = width / 2 + 1;
+        const RealFftPlan rows(width);
+        const FftPlan columns(height);
+
+        // Rows below the image are all zero and stay zero after the row pass.
+        data.resize(static_cast<size_t>(bins) * height);
+        std::fill(data.begin() + static_cast<size_t>(bins) * image.height, data.end(), Complex{});
+        ForEachRange(image.height, threads, [&](int begin, int end) {
+            std::vector<float> samples(width, 0.0f);
+            std::vector<Complex> scratch(width / 2);
+            for (int y = begin; y < end; ++y) {
+                const COLORREF* row = &image.pixels[static_cast<size_t>(y) * image.width];
+                for (int x = 0; x < image.width; ++x) samples[x] = value(row[x]);
+                rows.Forward(samples.data(), &data[static_cast<size_t>(y) * bins], scratch.data());
+            }
+        });
+        TransformColumns(data, bins, columns, false, threads);
+    }
+
+    inline int NextPowerOfTwo(int value) noexcept {
+        return static_cast<int>(std::bit_ceil(static_cast<unsigned>(std::max(value, 2))));
+    }
+
+    /**
+     * @struct ScreenData
+     * @brief The per-screen half of a correlation search: the screen spectra (with the channel
+     * means removed, which keeps the float transforms accurate) and 64-bit window moment tables.
+     */
+    struct ScreenData {
+        Spectrum spectrum;
+        WindowStats::IntegralTable<uint64_t> sums;
+        WindowStats::IntegralTable<uint64_t> squares;
+    };
+
+    inline ScreenData BuildScreenData(const PixelBuffer& screen, int threads) {
+        ScreenData data;
+        data.sums = WindowStats::BuildIntegralImage<uint64_t>(screen, false);
+        data.squares = WindowStats::BuildIntegralImage<uint64_t>(screen, true);
+
+        float means[3];
+        const double pixels = std::max<double>(1.0, static_cast<double>(screen.width) * screen.height);
+        for (int c = 0; c < 3; ++c) {
+            means[c] = static_cast<float>(WindowStats::WindowSum(data.sums.channels[c], data.sums.stride, 0, 0, screen.width, screen.height) / pixels);
+        }
+        Spectrum& spectrum = data.spectrum;
+        spectrum.width = NextPowerOfTwo(screen.width);
+        spectrum.height = NextPowerOfTwo(screen.height);
+        spectrum.bins = spectrum.width / 2 + 1;
+        for (int c = 0; c < 3; ++c) {
+            TransformChannel(screen, spectrum.width, spectrum.height,
+                [&](COLORREF pixel) { return static_cast<float>((pixel >> (c * 8)) & 0xFF) - means[c]; },
+                spectrum.channels[c], threads);
+        }
+        return data;
+    }
+
+    // Windows whose summed per-channel variance stays below this (in squared levels per pixel) are
+    // treated as flat: their correlation is undefined and reported as 0.
+    constexpr double kMinWindowVariance = 1.0;
+
+    /**
+     * @struct Surface
+     * @brief Correlation coefficient of the template at every position where it fits on the screen.
+     */
+    struct Surface {
+        int width = 0;
+        int height = 0;
+        std::vector<float> values;
+    };
+
+    /**
+     * @brief Computes the normalized cross-correlation of `source` at every screen position.
+     * The three channels are treated as one signal: the template minus its per-channel mean is
+     * correlated with the screen, and divided by the template energy times the summed channel
+     * variance of the screen window. Transparent pixels take no part in the numerator but do in
+     * the window variance, which lowers the coefficients of partly transparent templates somewhat.
+     * @return An empty surface if the template does not fit or has no contrast.
+     */
+    inline Surface ComputeSurface(const ScreenData& screen_data, const PixelBuffer& screen, const PixelBuffer& source,
+        COLORREF transparent_color, int threads) {
+
+        Surface surface;
+        if (source.width > screen.width || source.height > screen.height || source.pixels.empty()) return surface;
+
+        // Template channels minus their means over the opaque pixels; transparent pixels become 0.
+        double means[3] = {};
+        size_t opaque = 0;
+        for (COLORREF pixel : source.pixels) {
+            if (pixel == transparent_color) continue;
+            ++opaque;
+            for (int c = 0; c < 3; ++c) means[c] += (pixel >> (c * 8)) & 0xFF;
+        }
+        if (opaque == 0) return surface;
+        double energy = 0.0;
+        for (int c = 0; c < 3; ++c) means[c] /= static_cast<double>(opaque);
+        for (COLORREF pixel : source.pixels) {
+            if (pixel == transparent_color) continue;
+            for (int c = 0; c < 3; ++c) {
+                const double centered = ((pixel >> (c * 8)) & 0xFF) - means[c];
+                energy += centered * centered;
+            }
+        }
+        if (energy < 1.0) return surface; // A flat template correlates with nothing.
+
+        // Cross-power spectrum summed over the channels; its inverse is the correlation numerator.
+        // One channel of the template is transformed at a time to keep the working set small.
+        const Spectrum& screen_spectrum = screen_data.spectrum;
+        std::vector<Complex> product(screen_spectrum.channels[0].size(), Complex{});
+        std::vector<Complex> channel;
+        for (int c = 0; c < 3; ++c) {
+            TransformChannel(source, screen_spectrum.width, screen_spectrum.height,
+                [&](COLORREF pixel) {
+                    return pixel == transparent_color ? 0.0f : static_cast<float>(((pixel >> (c * 8)) & 0xFF) - means[c]);
+                }, channel, threads);
+            const std::vector<Complex>& screen_channel = screen_spectrum.channels[c];
+            ForEachRange(static_cast<int>(product.size()), threads, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) product[i] += MultiplyConjugate(screen_channel[i], channel[i]);
+            });
+        }
+        const FftPlan columns(screen_spectrum.height);
+        TransformColumns(product, screen_spectrum.bins, columns, true, threads);
+
+        surface.width = screen.width - source.width + 1;
+        surface.height = screen.height - source.height + 1;
+        surface.values.assign(static_cast<size_t>(surface.width) * surface.height, 0.0f);
+
+        const RealFftPlan rows(screen_spectrum.width);
+        const double scale = 1.0 / (static_cast<double>(screen_spectrum.width / 2) * screen_spectrum.height);
+        const double area = static_cast<double>(source.width) * source.height;
+        const auto& sums = screen_data.sums;
+        const auto& squares = screen_data.squares;
+
+        ForEachRange(surface.height, threads, [&](int begin, int end) {
+            std::vector<float> numerators(screen_spectrum.width);
+            std::vector<Complex> scratch(screen_spectrum.width / 2);
+            for (int y = begin; y < end; ++y) {
+                rows.Inverse(&product[static_cast<size_t>(y) * screen_spectrum.bins], numerators.data(), scratch.data());
+                float* out = &surface.values[static_cast<size_t>(y) * surface.width];
+                for (int x = 0; x < surface.width; ++x) {
+                    double variance = 0.0;
+                    for (int c = 0; c < 3; ++c) {
+                        const double sum = static_cast<double>(WindowStats::WindowSum(sums.channels[c], sums.stride, x, y, source.width, source.height));
+                        const double square = static_cast<double>(WindowStats::WindowSum(squares.channels[c], squares.stride, x, y, source.width, source.height));
+                        variance += square - sum * sum / area;
+                    }
+                    if (variance < area * kMinWindowVariance) continue;
+                    const double coefficient = numerators[x] * scale / std::sqrt(energy * variance);
+                    out[x] = static_cast<float>(std::clamp(coefficient, -1.0, 1.0));
+                }
+            }
+        });
+        return surface;
+    }
+
+    /**
+     * @brief Local maxima of the surface that reach `threshold`, in scan order. Of several equal
+     * neighbouring values only the first in scan order is reported.
+     */
+    inline std::vector<std::pair<int, int>> FindPeaks(const Surface& surface, float threshold) {
+        std::vector<std::pair<int, int>> peaks;
+        auto at = [&](int x, int y) { return surface.values[static_cast<size_t>(y) * surface.width + x]; };
+        for (int y = 0; y < surface.height; ++y) {
+            for (int x = 0; x < surface.width; ++x) {
+                const float value = at(x, y);
+                if (value < threshold) continue;
+                bool peak = true;
+                for (int dy = -1; dy <= 1 && peak; ++dy) {
+                    for (int dx = -1; dx <= 1 && peak; ++dx) {
+                        const int nx = x + dx, ny = y + dy;
+                        if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= surface.width || ny >= surface.height) continue;
+                        const bool earlier = dy < 0 || (dy == 0 && dx < 0);
+                        peak = earlier ? value > at(nx, ny) : value >= at(nx, ny);
+                    }
+                }
+                if (peak) peaks.emplace_back(x, y);
+            }
+        }
+        return peaks;
+    }
+}
@@ -0,0 +1,167 @@
+// =================================================================================================
+//
+// Name ............: ImageExactMatch.h
+// Description .....: Rolling-hash search for tolerance-0 templates.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Free of OS dependencies like ImageKernels.h; checked against a brute-force exact scan, including
+// screens built to collide with the hashes, by tests/ImageExactMatchTest.cpp.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "ImageKernels.h"
+#include "ImageTemplate.h"
+
+// =================================================================================================
+// #BLOCK# EXACT MATCH ENGINE
+// Rolling-hash search for tolerance-0 templates; cost is linear in the screen size.
+// =================================================================================================
+
+namespace ExactMatch {
+
+    // Polynomial bases for the horizontal and vertical rolling hashes (odd, so invertible mod 2^64).
+    constexpr uint64_t kRowBase = 0x9E3779B97F4A7C15ull;
+    constexpr uint64_t kColumnBase = 0xC2B2AE3D27D4EB4Full;
+
+    /**
+     * @brief True if every constrained pixel of the template demands one exact RGB value.
+     */
+    inline bool IsExact(const ToleranceBounds& bounds) noexcept {
+        for (size_t i = 0; i < bounds.lo.size(); ++i) {
+            if (TemplateAnalysis::IsUnconstrained(bounds.lo[i], bounds.hi[i])) continue;
+            if ((bounds.lo[i] & 0x00FFFFFF) != (bounds.hi[i] & 0x00FFFFFF)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief True if the template has no transparent (unconstrained) pixel.
+     */
+    inline bool IsFullyConstrained(const ToleranceBounds& bounds) noexcept {
+        for (size_t i = 0; i < bounds.lo.size(); ++i) {
+            if (TemplateAnalysis::IsUnconstrained(bounds.lo[i], bounds.hi[i])) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Finds the longest horizontal run of constrained pixels (the first one on ties).
+     * @return A span with length 0 if the template has no constrained pixel at all.
+     */
+    inline OpaqueSpan LongestSpan(const ToleranceBounds& bounds) noexcept {
+        OpaqueSpan best{ 0, 0, 0 };
+        for (int y = 0; y < bounds.height; ++y) {
+            const size_t row = static_cast<size_t>(y) * bounds.width;
+            for (int x = 0; x < bounds.width;) {
+                if (TemplateAnalysis::IsUnconstrained(bounds.lo[row + x], bounds.hi[row + x])) { ++x; continue; }
+                int end = x;
+                while (end < bounds.width && !TemplateAnalysis::IsUnconstrained(bounds.lo[row + end], bounds.hi[row + end])) ++end;
+                if (end - x > best.length) best = { y, x, end - x };
+                x = end;
+            }
+        }
+        return best;
+    }
+
+    inline uint64_t PowMod64(uint64_t base, int exponent) noexcept {
+        uint64_t result = 1;
+        while (exponent-- > 0) result *= base;
+        return result;
+    }
+
+    /**
+     * @brief Rolling hash of every window of `length` pixels in a row of RGB values.
+     * out[i] receives the hash of row[i .. i + length - 1] for i in [0, count).
+     */
+    inline void RowWindowHashes(const COLORREF* row, int length, int count, uint64_t top_power, uint64_t* out) noexcept {
+        uint64_t hash = 0;
+        for (int i = 0; i < length; ++i) hash = hash * kRowBase + (row[i] & 0x00FFFFFF);
+        for (int i = 0; i < count; ++i) {
+            out[i] = hash;
+            if (i + 1 < count) {
+                hash = (hash - (row[i] & 0x00FFFFFF) * top_power) * kRowBase + (row[i + length] & 0x00FFFFFF);
+            }
+        }
+    }
+
+    inline uint64_t SpanHash(const COLORREF* values, int length) noexcept {
+        uint64_t hash = 0;
+        for (int i = 0; i < length; ++i) hash = hash * kRowBase + (values[i] & 0x00FFFFFF);
+        return hash;
+    }
+
+    /**
+     * @brief Exact search for a fully constrained template with a 2D Rabin-Karp hash.
+     * Row hashes of every template-wide window are combined vertically with a second rolling hash,
+     * so each candidate costs O(1) regardless of the template size. Hash hits are verified.
+     * `cancelled` is polled once per row; the scan stops as soon as it returns true.
+     */
+    template <class Verify, class OnMatch, class Cancelled>
+    inline void Scan2D(const PixelBuffer& screen, const ToleranceBounds& bounds, int max_x, int max_y,
+        Verify&& verify, OnMatch&& on_match, Cancelled&& cancelled) {
+
+        const int w = bounds.width, h = bounds.height;
+        const int count = max_x + 1;
+        const uint64_t row_top_power = PowMod64(kRowBase, w - 1);
+        const uint64_t column_top_power = PowMod64(kColumnBase, h - 1);
+
+        // Hash of the template, computed from its exact colors (lo == hi for every pixel).
+        uint64_t target = 0;
+        for (int y = 0; y < h; ++y) target = target * kColumnBase + SpanHash(&bounds.lo[static_cast<size_t>(y) * w], w);
+
+        // Row hashes of the last h screen rows (ring buffer) and the running vertical hash per column.
+        std::vector<uint64_t> ring(static_cast<size_t>(h) * count);
+        std::vector<uint64_t> column(count, 0);
+        for (int y = 0; y < h; ++y) {
+            uint64_t* row_hashes = &ring[static_cast<size_t>(y) * count];
+            RowWindowHashes(&screen.pixels[static_cast<size_t>(y) * screen.width], w, count, row_top_power, row_hashes);
+            for (int x = 0; x < count; ++x) column[x] = column[x] * kColumnBase + row_hashes[x];
+        }
+
+        for (int y = 0; y <= max_y; ++y) {
+            if (cancelled()) return;
+            for (int x = 0; x < count; ++x) {
+                if (column[x] == target && verify(x, y) && !on_match(x, y)) return;
+            }
+            if (y == max_y) break;
+
+            // Slide the window down: drop screen row y, add screen row y + h.
+            uint64_t* row_hashes = &ring[static_cast<size_t>(y % h) * count];
+            for (int x = 0; x < count; ++x) column[x] -= row_hashes[x] * column_top_power;
+            RowWindowHashes(&screen.pixels[static_cast<size_t>(y + h) * screen.width], w, count, row_top_power, row_hashes);
+            for (int x = 0; x < count; ++x) column[x] = column[x] * kColumnBase + row_hashes[x];
+        }
+    }
+
+    /**
+     * @brief Exact search for a template with transparent pixels: only its longest opaque span is
+     * hashed, with a rolling hash along each screen row, and every hit is verified in full.
+     * `cancelled` is polled once per row, as in Scan2D.
+     */
+    template <class Verify, class OnMatch, class Cancelled>
+    inline void ScanSpan(const PixelBuffer& screen, const ToleranceBounds& bounds, const OpaqueSpan& span,
+        int max_x, int max_y, Verify&& verify, OnMatch&& on_match, Cancelled&& cancelled) {
+
+        const int count = max_x + 1;
+        const uint64_t top_power = PowMod64(kRowBase, span.length - 1);
+        const uint64_t target = SpanHash(&bounds.lo[static_cast<size_t>(span.y) * bounds.width + span.x], span.length);
+
+        std::vector<uint64_t> row_hashes(count);
+        for (int y = 0; y <= max_y; ++y) {
+            if (cancelled()) return;
+            const COLORREF* row = &screen.pixels[static_cast<size_t>(y + span.y) * screen.width + span.x];
+            RowWindowHashes(row, span.length, count, top_power, row_hashes.data());
+            for (int x = 0; x < count; ++x) {
+                if (row_hashes[x] == target && verify(x, y) && !on_match(x, y)) return;
+            }
+        }
+    }
+}
@@ -0,0 +1,1777 @@
+// =================================================================================================
+//
+// Name ............: ImageKernels.h
+// Description .....: Image data structures and the per-instruction-set pixel comparison kernels.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// The scalar, SSE2, SSE4.1, AVX2 and AVX-512BW comparison kernels, the table that groups them per
+// instruction set level, CPU detection, and the data structures they work on. Pixels are Win32
+// COLORREFs (0x00BBGGRR); without windows.h the type and its channel macros are defined here, so
+// ImageSearchDLL.cpp and the tests in tests/ share one copy of the kernels on any platform.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <optional>
+#include <string_view>
+#include <bit>
+#include <atomic>
+#include <mutex>
+#include <iterator>
+#include <cwctype>
+
+// SIMD Headers for CPU extensions
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// The resampler kernels are part of the kernel table. Defines ISA_TARGET.
+#include "ImageResample.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+// The Win32 pixel type and channel macros, as in wingdi.h.
+using COLORREF = uint32_t;
+#ifndef RGB
+#define RGB(r, g, b) ((COLORREF)(((uint8_t)(r) | ((uint16_t)((uint8_t)(g)) << 8)) | (((uint32_t)(uint8_t)(b)) << 16)))
+#endif
+#ifndef GetRValue
+#define GetRValue(rgb) ((uint8_t)(rgb))
+#define GetGValue(rgb) ((uint8_t)(((uint16_t)(rgb)) >> 8))
+#define GetBValue(rgb) ((uint8_t)((rgb) >> 16))
+#endif
+#endif
+
+// =================================================================================================
+// #BLOCK# CPU FEATURE DETECTION
+// Instruction set levels and what the host CPU and OS support.
+// =================================================================================================
+
+/**
+ * @enum SimdLevel
+ * @brief Instruction set levels with a dedicated set of comparison kernels, in ascending order.
+ */
+enum class SimdLevel : int {
+    Scalar = 0,
+    SSE2,
+    SSE41,
+    AVX2,
+    AVX512BW
+};
+
+/**
+ * @brief Reads the XCR0 register, which tells which register states the OS saves on context switch.
+ */
+ISA_TARGET("xsave") inline unsigned long long ReadXcr0() noexcept {
+    return _xgetbv(0);
+}
+
+/**
+ * @brief Runs CPUID for a leaf and subleaf; info receives EAX, EBX, ECX and EDX.
+ */
+inline void ReadCpuId(int info[4], int leaf, int subleaf) noexcept {
+#if defined(_MSC_VER)
+    __cpuidex(info, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+/**
+ * @brief Detects the highest instruction set supported by the host CPU and enabled by the OS.
+ */
+inline SimdLevel DetectSimdLevel() noexcept {
+    int cpuInfo[4];
+    ReadCpuId(cpuInfo, 0, 0);
+    const int max_leaf = cpuInfo[0];
+
+    ReadCpuId(cpuInfo, 1, 0);
+    const bool sse2 = (cpuInfo[3] & (1 << 26)) != 0;
+    const bool sse41 = (cpuInfo[2] & (1 << 19)) != 0;
+    const bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+
+    // AVX state (XMM + YMM) and AVX-512 state (opmask + ZMM) must both be enabled by the OS.
+    const unsigned long long xcr0 = osxsave ? ReadXcr0() : 0;
+    const bool os_avx = (xcr0 & 0x06) == 0x06;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false, avx512bw = false;
+    if (max_leaf >= 7) {
+        ReadCpuId(cpuInfo, 7, 0);
+        // EBX bit 5 = AVX2, bit 16 = AVX-512F, bit 30 = AVX-512BW.
+        avx2 = os_avx && (cpuInfo[1] & (1 << 5)) != 0;
+        avx512bw = os_avx512 && (cpuInfo[1] & (1 << 16)) != 0 && (cpuInfo[1] & (1 << 30)) != 0;
+    }
+
+    SimdLevel detected = SimdLevel::Scalar;
+    if (sse2) detected = SimdLevel::SSE2;
+    if (sse2 && sse41) detected = SimdLevel::SSE41;
+    if (avx2 && sse41) detected = SimdLevel::AVX2;
+    if (avx2 && avx512bw) detected = SimdLevel::AVX512BW;
+    return detected;
+}
+
+/**
+ * @brief Parses an instruction set name ("scalar", "sse2", "sse41", "avx2", "avx512").
+ */
+inline std::optional<SimdLevel> ParseSimdLevel(std::wstring_view name) noexcept {
+    if (name == L"scalar") return SimdLevel::Scalar;
+    if (name == L"sse2") return SimdLevel::SSE2;
+    if (name == L"sse41") return SimdLevel::SSE41;
+    if (name == L"avx2") return SimdLevel::AVX2;
+    if (name == L"avx512") return SimdLevel::AVX512BW;
+    return std::nullopt;
+}
+
+inline const wchar_t* GetSimdLevelName(SimdLevel level) noexcept {
+    switch (level) {
+    case SimdLevel::SSE2: return L"SSE2";
+    case SimdLevel::SSE41: return L"SSE4.1";
+    case SimdLevel::AVX2: return L"AVX2";
+    case SimdLevel::AVX512BW: return L"AVX-512BW";
+    default: return L"Scalar";
+    }
+}
+
+// =================================================================================================
+// #BLOCK# DATA STRUCTURES
+// Core data structures used for representing images and results.
+// =================================================================================================
+
+/**
+ * @struct PixelBuffer
+ * @brief A container for raw 32-bit pixel data (COLORREF) along with image dimensions.
+ */
+struct PixelBuffer {
+    std::vector<COLORREF> pixels;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @struct MatchResult
+ * @brief Represents a single found match, containing its location and dimensions.
+ */
+struct MatchResult {
+    int x, y, w, h;
+    // Sum of per-channel distances to the tolerance bounds; only set by the scoring search.
+    uint64_t score = 0;
+    // Normalized cross-correlation coefficient (-1..1); only set by the correlation search.
+    float correlation = 0.0f;
+    // Rotation of the matching template variant in degrees; only set by rotation searches.
+    float angle = 0.0f;
+};
+
+/**
+ * @struct AnchorPixel
+ * @brief A single distinctive template pixel, tested at every candidate before the full comparison.
+ */
+struct AnchorPixel {
+    int x, y;
+    COLORREF lo, hi;
+};
+
+/**
+ * @struct OpaqueSpan
+ * @brief A horizontal run of constrained template pixels.
+ */
+struct OpaqueSpan {
+    int y, x, length;
+};
+
+/**
+ * @struct ToleranceBounds
+ * @brief Per-pixel saturated lower/upper bounds of a template, laid out like its PixelBuffer.
+ * A screen pixel matches template pixel i when every byte lies within [lo[i], hi[i]]. Transparent
+ * pixels and the alpha byte use the full 0x00..0xFF range, so they always pass without a test.
+ */
+struct ToleranceBounds {
+    std::vector<COLORREF> lo;
+    std::vector<COLORREF> hi;
+    int width = 0;
+    int height = 0;
+
+    // The runs the comparison kernels visit, in row order. Fully transparent rows have none, and
+    // transparent gaps shorter than TemplateAnalysis::kSpanMergeGap are folded into one span.
+    std::vector<OpaqueSpan> spans;
+
+    // Narrow templates (width <= 4) also keep their bounds with `packed_rows` rows per 8-pixel group,
+    // each row in an 8 / packed_rows lane slot. Padding lanes and missing rows are unconstrained.
+    // Empty (packed_rows == 0) for wider templates. See TemplateAnalysis::PackNarrowRows.
+    std::vector<COLORREF> packed_lo;
+    std::vector<COLORREF> packed_hi;
+    int packed_rows = 0;
+};
+
+/**
+ * @struct PlanarBuffer
+ * @brief A PixelBuffer split into one byte plane per channel. planes[c] holds byte c of every pixel
+ * (B, G, R for a DIB capture) in the same row-major layout; the alpha byte is dropped.
+ */
+struct PlanarBuffer {
+    std::array<std::vector<uint8_t>, 3> planes;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @struct PlanarBounds
+ * @brief ToleranceBounds split into byte planes like PlanarBuffer. `spans` as in ToleranceBounds.
+ */
+struct PlanarBounds {
+    std::array<std::vector<uint8_t>, 3> lo;
+    std::array<std::vector<uint8_t>, 3> hi;
+    int width = 0;
+    int height = 0;
+    std::vector<OpaqueSpan> spans;
+};
+
+/**
+ * @struct BytePlane
+ * @brief One 8-bit value per pixel of a PixelBuffer (its luma or gradient magnitude), in the same
+ * row-major layout.
+ */
+struct BytePlane {
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+};
+
+/**
+ * @struct ByteBounds
+ * @brief Per-pixel bounds of a template on a BytePlane, the counterpart of ToleranceBounds.
+ * A screen value matches template pixel i when it lies within [lo[i], hi[i]]; transparent pixels
+ * use 0..255. `spans` lists the constrained runs exactly as in ToleranceBounds.
+ */
+struct ByteBounds {
+    std::vector<uint8_t> lo;
+    std::vector<uint8_t> hi;
+    int width = 0;
+    int height = 0;
+    std::vector<OpaqueSpan> spans;
+};
+
+
+// =================================================================================================
+// #BLOCK# OPTIMIZED SIMD PIXEL COMPARISON (CONSISTENT LOGIC)
+// Contains the core pixel-matching algorithms, including the scalar and AVX2 versions.
+// =================================================================================================
+
+namespace PixelComparison {
+
+    /**
+     * @brief Tests a single screen pixel against precomputed bounds (R, G and B bytes only).
+     */
+    inline bool PixelWithinBounds(COLORREF pixel, COLORREF lo, COLORREF hi) noexcept {
+        // Unsigned wrap-around turns each two-sided range test into a single comparison.
+        auto in_range = [](unsigned v, unsigned l, unsigned h) noexcept { return (v - l) <= (h - l); };
+        return in_range(GetRValue(pixel), GetRValue(lo), GetRValue(hi)) &
+            in_range(GetGValue(pixel), GetGValue(lo), GetGValue(hi)) &
+            in_range(GetBValue(pixel), GetBValue(lo), GetBValue(hi));
+    }
+
+    /**
+     * @brief Range check of a candidate against precomputed tolerance bounds (standard C++ version).
+     * All CheckBoundsMatch kernels visit only the opaque spans of the template (ToleranceBounds::spans).
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    inline bool CheckBoundsMatch_Scalar(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; ++x) {
+                if (!PixelWithinBounds(screen_row[x], lo_row[x], hi_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate against precomputed tolerance bounds (SSE2 version, 4 pixels).
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    ISA_TARGET("sse2")
+    inline bool CheckBoundsMatch_SSE2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 3 < span.length; x += 4) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)) != 0xFFFF) {
+                    return false;
+                }
+            }
+
+            for (; x < span.length; ++x) {
+                if (!PixelWithinBounds(screen_row[x], lo_row[x], hi_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate against precomputed tolerance bounds (SSE4.1 version, 4 pixels).
+     * PTEST replaces the compare and movemask of the SSE2 version.
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    ISA_TARGET("sse4.1")
+    inline bool CheckBoundsMatch_SSE41(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 3 < span.length; x += 4) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                __m128i v_mismatch = _mm_xor_si128(v_clamped, v_screen);
+                if (!_mm_testz_si128(v_mismatch, v_mismatch)) {
+                    return false;
+                }
+            }
+
+            for (; x < span.length; ++x) {
+                if (!PixelWithinBounds(screen_row[x], lo_row[x], hi_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns a lane mask with the lowest `count` 32-bit lanes set, for masked loads.
+     */
+    ISA_TARGET("avx2") inline __m256i LaneMask_AVX2(int count) noexcept {
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+
+    /**
+     * @brief Range check of a candidate against precomputed tolerance bounds (AVX2 optimized version).
+     * Clamping the screen bytes into [lo, hi] leaves them unchanged exactly when they are in range, so
+     * one min/max pair and an XOR replace the absolute-difference and tolerance arithmetic.
+     * The last 1-7 pixels of each span use masked loads; masked-off lanes read as zero in the screen
+     * and in both bounds, so they always pass and no scalar tail is needed.
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    ISA_TARGET("avx2")
+    inline bool CheckBoundsMatch_AVX2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 7 < span.length; x += 8) {
+                __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+                __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo_row + x));
+                __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi_row + x));
+
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                __m256i v_mismatch = _mm256_xor_si256(v_clamped, v_screen);
+                if (!_mm256_testz_si256(v_mismatch, v_mismatch)) {
+                    return false;
+                }
+            }
+
+            if (x < span.length) {
+                const __m256i tail_mask = LaneMask_AVX2(span.length - x);
+                __m256i v_screen = _mm256_maskload_epi32(reinterpret_cast<const int*>(screen_row + x), tail_mask);
+                __m256i v_lo = _mm256_maskload_epi32(reinterpret_cast<const int*>(lo_row + x), tail_mask);
+                __m256i v_hi = _mm256_maskload_epi32(reinterpret_cast<const int*>(hi_row + x), tail_mask);
+
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                __m256i v_mismatch = _mm256_xor_si256(v_clamped, v_screen);
+                if (!_mm256_testz_si256(v_mismatch, v_mismatch)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Loads the pixels of a screen row selected by `row_mask`; the other lanes are zero.
+     */
+    ISA_TARGET("avx2") inline __m128i LoadRowSlot_AVX2(const COLORREF* row, __m128i row_mask) noexcept {
+        return _mm_maskload_epi32(reinterpret_cast<const int*>(row), row_mask);
+    }
+
+    /**
+     * @brief Range check of a narrow template against its packed bounds (AVX2, width <= 4).
+     * RowsPerVector screen rows are gathered into one vector, each into an 8 / RowsPerVector lane
+     * slot, so a 2-pixel pip checks 4 rows per compare instead of running a scalar loop per row.
+     * Rows past the template bottom reuse its last row; their packed bounds are unconstrained.
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    template <int RowsPerVector>
+    ISA_TARGET("avx2")
+    inline bool CheckBoundsMatchPacked_AVX2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        static_assert(RowsPerVector == 2 || RowsPerVector == 4, "A row slot must hold 4 or 2 lanes.");
+        const __m128i row_mask = _mm256_castsi256_si128(LaneMask_AVX2(bounds.width));
+        const COLORREF* screen_origin = &screen.pixels[start_y * screen.width + start_x];
+        const __m256i* lo_groups = reinterpret_cast<const __m256i*>(bounds.packed_lo.data());
+        const __m256i* hi_groups = reinterpret_cast<const __m256i*>(bounds.packed_hi.data());
+
+        for (int y = 0, group = 0; y < bounds.height; y += RowsPerVector, ++group) {
+            const COLORREF* rows[RowsPerVector];
+            for (int r = 0; r < RowsPerVector; ++r) {
+                rows[r] = screen_origin + std::min(y + r, bounds.height - 1) * screen.width;
+            }
+
+            __m256i v_screen;
+            if constexpr (RowsPerVector == 2) {
+                v_screen = _mm256_set_m128i(LoadRowSlot_AVX2(rows[1], row_mask), LoadRowSlot_AVX2(rows[0], row_mask));
+            }
+            else {
+                v_screen = _mm256_set_m128i(
+                    _mm_unpacklo_epi64(LoadRowSlot_AVX2(rows[2], row_mask), LoadRowSlot_AVX2(rows[3], row_mask)),
+                    _mm_unpacklo_epi64(LoadRowSlot_AVX2(rows[0], row_mask), LoadRowSlot_AVX2(rows[1], row_mask)));
+            }
+            __m256i v_lo = _mm256_loadu_si256(lo_groups + group);
+            __m256i v_hi = _mm256_loadu_si256(hi_groups + group);
+
+            __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+            __m256i v_mismatch = _mm256_xor_si256(v_clamped, v_screen);
+            if (!_mm256_testz_si256(v_mismatch, v_mismatch)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Entry point of the AVX2 kernel set: narrow templates go to the packed-row kernel.
+     */
+    ISA_TARGET("avx2")
+    inline bool CheckBoundsMatchAny_AVX2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        switch (bounds.packed_rows) {
+        case 4: return CheckBoundsMatchPacked_AVX2<4>(screen, bounds, start_x, start_y);
+        case 2: return CheckBoundsMatchPacked_AVX2<2>(screen, bounds, start_x, start_y);
+        default: return CheckBoundsMatch_AVX2(screen, bounds, start_x, start_y);
+        }
+    }
+
+    /**
+     * @brief Range check of a candidate against precomputed tolerance bounds (AVX-512BW version).
+     * 16 pixels per step; the span tail uses a masked load, where the zeroed lanes of screen, lo and hi
+     * always compare as in range.
+     * @return True if every screen pixel lies within the bounds of its template pixel.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline bool CheckBoundsMatch_AVX512BW(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y) noexcept {
+
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 15 < span.length; x += 16) {
+                __m512i v_screen = _mm512_loadu_si512(screen_row + x);
+                __m512i v_lo = _mm512_loadu_si512(lo_row + x);
+                __m512i v_hi = _mm512_loadu_si512(hi_row + x);
+
+                __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm512_cmpneq_epi32_mask(v_clamped, v_screen) != 0) {
+                    return false;
+                }
+            }
+
+            if (x < span.length) {
+                const __mmask16 tail_mask = static_cast<__mmask16>((1u << (span.length - x)) - 1);
+                __m512i v_screen = _mm512_maskz_loadu_epi32(tail_mask, screen_row + x);
+                __m512i v_lo = _mm512_maskz_loadu_epi32(tail_mask, lo_row + x);
+                __m512i v_hi = _mm512_maskz_loadu_epi32(tail_mask, hi_row + x);
+
+                __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm512_cmpneq_epi32_mask(v_clamped, v_screen) != 0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Tests 4 consecutive candidate positions at once against a list of probe pixels (SSE2).
+     * See ProbeCandidates_AVX2. The caller must guarantee that start_x + 3 is a valid candidate column.
+     * @return A bitmask where bit i is set if candidate (start_x + i, start_y) passed every probe.
+     */
+    ISA_TARGET("sse2")
+    inline uint32_t ProbeCandidates_SSE2(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+
+        uint32_t survivors = 0xF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_ptr));
+            __m128i v_lo = _mm_set1_epi32(static_cast<int>(probe.lo));
+            __m128i v_hi = _mm_set1_epi32(static_cast<int>(probe.hi));
+
+            __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+            __m128i v_pass = _mm_cmpeq_epi32(v_clamped, v_screen);
+            survivors &= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(v_pass)));
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Tests 8 consecutive candidate positions at once against a list of probe pixels (AVX2).
+     * Each probe pixel is broadcast and compared against the 8 screen pixels it would cover for the
+     * candidates start_x .. start_x + 7. Lanes that fail are cleared, and the loop stops as soon as
+     * no candidate is left, so a typical call touches only one or two probe pixels.
+     * The caller must guarantee that start_x + 7 is still a valid candidate column.
+     * @return A bitmask where bit i is set if candidate (start_x + i, start_y) passed every probe.
+     */
+    ISA_TARGET("avx2")
+    inline uint32_t ProbeCandidates_AVX2(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+
+        uint32_t survivors = 0xFF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_ptr));
+            __m256i v_lo = _mm256_set1_epi32(static_cast<int>(probe.lo));
+            __m256i v_hi = _mm256_set1_epi32(static_cast<int>(probe.hi));
+
+            // Same range test as CheckBoundsMatch_AVX2; a lane passes if clamping leaves it unchanged.
+            __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+            __m256i v_pass = _mm256_cmpeq_epi32(v_clamped, v_screen);
+            survivors &= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(v_pass)));
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Tests 16 consecutive candidate positions at once against a list of probe pixels (AVX-512BW).
+     * See ProbeCandidates_AVX2. The caller must guarantee that start_x + 15 is a valid candidate column.
+     * @return A bitmask where bit i is set if candidate (start_x + i, start_y) passed every probe.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline uint32_t ProbeCandidates_AVX512BW(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+
+        __mmask16 survivors = 0xFFFF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m512i v_screen = _mm512_loadu_si512(screen_ptr);
+            __m512i v_lo = _mm512_set1_epi32(static_cast<int>(probe.lo));
+            __m512i v_hi = _mm512_set1_epi32(static_cast<int>(probe.hi));
+
+            __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+            survivors = _mm512_mask_cmpeq_epi32_mask(survivors, v_clamped, v_screen);
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Distance of one pixel to its bounds: per channel, how far it lies below lo or above hi.
+     * For bounds built with tolerance 0 this is the sum of absolute R, G and B differences.
+     */
+    inline uint32_t PixelDistance(COLORREF pixel, COLORREF lo, COLORREF hi) noexcept {
+        uint32_t distance = 0;
+        for (int shift = 0; shift < 24; shift += 8) {
+            int v = (pixel >> shift) & 0xFF, l = (lo >> shift) & 0xFF, h = (hi >> shift) & 0xFF;
+            distance += v > h ? v - h : (l > v ? l - v : 0);
+        }
+        return distance;
+    }
+
+    /**
+     * @brief Score of a candidate: the sum of PixelDistance over the opaque spans (standard C++ version).
+     * Transparent pixels have the full 0..255 range and add nothing.
+     * @param limit The candidate is abandoned once its partial score exceeds this value.
+     * @return The exact score if it is <= limit, otherwise some value > limit.
+     */
+    inline uint64_t ScoreBounds_Scalar(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, uint64_t limit) noexcept {
+
+        uint64_t score = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; ++x) {
+                score += PixelDistance(screen_row[x], lo_row[x], hi_row[x]);
+            }
+            if (score > limit) return score;
+        }
+        return score;
+    }
+
+    /**
+     * @brief Score of a candidate (SSE2 version, 4 pixels). See ScoreBounds_Scalar.
+     * The per-byte distance is subs(screen, hi) | subs(lo, screen), summed with PSADBW.
+     */
+    ISA_TARGET("sse2")
+    inline uint64_t ScoreBounds_SSE2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, uint64_t limit) noexcept {
+
+        const __m128i v_zero = _mm_setzero_si128();
+        uint64_t score = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            __m128i v_sum = v_zero;
+            int x = 0;
+            for (; x + 3 < span.length; x += 4) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_distance = _mm_or_si128(_mm_subs_epu8(v_screen, v_hi), _mm_subs_epu8(v_lo, v_screen));
+                v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(v_distance, v_zero));
+            }
+            v_sum = _mm_add_epi64(v_sum, _mm_unpackhi_epi64(v_sum, v_sum));
+            uint64_t span_score;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(&span_score), v_sum);
+            score += span_score;
+
+            for (; x < span.length; ++x) {
+                score += PixelDistance(screen_row[x], lo_row[x], hi_row[x]);
+            }
+            if (score > limit) return score;
+        }
+        return score;
+    }
+
+    /**
+     * @brief Score of a candidate (AVX2 version, 8 pixels with a masked tail). See ScoreBounds_Scalar.
+     */
+    ISA_TARGET("avx2")
+    inline uint64_t ScoreBounds_AVX2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, uint64_t limit) noexcept {
+
+        const __m256i v_zero = _mm256_setzero_si256();
+        uint64_t score = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            __m256i v_sum = v_zero;
+            int x = 0;
+            for (; x + 7 < span.length; x += 8) {
+                __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+                __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo_row + x));
+                __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi_row + x));
+
+                __m256i v_distance = _mm256_or_si256(_mm256_subs_epu8(v_screen, v_hi), _mm256_subs_epu8(v_lo, v_screen));
+                v_sum = _mm256_add_epi64(v_sum, _mm256_sad_epu8(v_distance, v_zero));
+            }
+            if (x < span.length) {
+                // Masked-off lanes are zero in all three inputs, so their distance is zero.
+                const __m256i tail_mask = LaneMask_AVX2(span.length - x);
+                __m256i v_screen = _mm256_maskload_epi32(reinterpret_cast<const int*>(screen_row + x), tail_mask);
+                __m256i v_lo = _mm256_maskload_epi32(reinterpret_cast<const int*>(lo_row + x), tail_mask);
+                __m256i v_hi = _mm256_maskload_epi32(reinterpret_cast<const int*>(hi_row + x), tail_mask);
+
+                __m256i v_distance = _mm256_or_si256(_mm256_subs_epu8(v_screen, v_hi), _mm256_subs_epu8(v_lo, v_screen));
+                v_sum = _mm256_add_epi64(v_sum, _mm256_sad_epu8(v_distance, v_zero));
+            }
+
+            __m128i v_half = _mm_add_epi64(_mm256_castsi256_si128(v_sum), _mm256_extracti128_si256(v_sum, 1));
+            v_half = _mm_add_epi64(v_half, _mm_unpackhi_epi64(v_half, v_half));
+            uint64_t span_score;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(&span_score), v_half);
+            score += span_score;
+            if (score > limit) return score;
+        }
+        return score;
+    }
+
+    /**
+     * @brief Score of a candidate (AVX-512BW version, 16 pixels with a masked tail). See ScoreBounds_Scalar.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline uint64_t ScoreBounds_AVX512BW(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, uint64_t limit) noexcept {
+
+        const __m512i v_zero = _mm512_setzero_si512();
+        uint64_t score = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            __m512i v_sum = v_zero;
+            int x = 0;
+            for (; x + 15 < span.length; x += 16) {
+                __m512i v_screen = _mm512_loadu_si512(screen_row + x);
+                __m512i v_lo = _mm512_loadu_si512(lo_row + x);
+                __m512i v_hi = _mm512_loadu_si512(hi_row + x);
+
+                __m512i v_distance = _mm512_or_si512(_mm512_subs_epu8(v_screen, v_hi), _mm512_subs_epu8(v_lo, v_screen));
+                v_sum = _mm512_add_epi64(v_sum, _mm512_sad_epu8(v_distance, v_zero));
+            }
+            if (x < span.length) {
+                const __mmask16 tail_mask = static_cast<__mmask16>((1u << (span.length - x)) - 1);
+                __m512i v_screen = _mm512_maskz_loadu_epi32(tail_mask, screen_row + x);
+                __m512i v_lo = _mm512_maskz_loadu_epi32(tail_mask, lo_row + x);
+                __m512i v_hi = _mm512_maskz_loadu_epi32(tail_mask, hi_row + x);
+
+                __m512i v_distance = _mm512_or_si512(_mm512_subs_epu8(v_screen, v_hi), _mm512_subs_epu8(v_lo, v_screen));
+                v_sum = _mm512_add_epi64(v_sum, _mm512_sad_epu8(v_distance, v_zero));
+            }
+
+            score += static_cast<uint64_t>(_mm512_reduce_add_epi64(v_sum));
+            if (score > limit) return score;
+        }
+        return score;
+    }
+
+    /**
+     * @brief Counts the opaque pixels of a candidate that lie outside their bounds (standard C++ version).
+     * @param budget The count stops as soon as it exceeds this value.
+     * @return The exact count if it is <= budget, otherwise budget + 1.
+     */
+    inline int CountMismatches_Scalar(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, int budget) noexcept {
+
+        int mismatches = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; ++x) {
+                if (!PixelWithinBounds(screen_row[x], lo_row[x], hi_row[x]) && ++mismatches > budget) return mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    /**
+     * @brief Counts out-of-bounds pixels (SSE2 version, 4 pixels). See CountMismatches_Scalar.
+     * A pixel is in range if clamping leaves all four bytes unchanged; the failing lanes of each
+     * compare mask are counted with a popcount.
+     */
+    ISA_TARGET("sse2")
+    inline int CountMismatches_SSE2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, int budget) noexcept {
+
+        int mismatches = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 3 < span.length; x += 4) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                uint32_t pass = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v_clamped, v_screen))));
+                if (pass != 0xF && (mismatches += std::popcount(pass ^ 0xFu)) > budget) return budget + 1;
+            }
+
+            for (; x < span.length; ++x) {
+                if (!PixelWithinBounds(screen_row[x], lo_row[x], hi_row[x]) && ++mismatches > budget) return mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    /**
+     * @brief Counts out-of-bounds pixels (AVX2 version, 8 pixels with a masked tail). See CountMismatches_SSE2.
+     */
+    ISA_TARGET("avx2")
+    inline int CountMismatches_AVX2(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, int budget) noexcept {
+
+        int mismatches = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; x += 8) {
+                __m256i v_screen, v_lo, v_hi;
+                if (x + 7 < span.length) {
+                    v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+                    v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo_row + x));
+                    v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi_row + x));
+                }
+                else {
+                    // Masked-off lanes are zero in all three inputs and always pass.
+                    const __m256i tail_mask = LaneMask_AVX2(span.length - x);
+                    v_screen = _mm256_maskload_epi32(reinterpret_cast<const int*>(screen_row + x), tail_mask);
+                    v_lo = _mm256_maskload_epi32(reinterpret_cast<const int*>(lo_row + x), tail_mask);
+                    v_hi = _mm256_maskload_epi32(reinterpret_cast<const int*>(hi_row + x), tail_mask);
+                }
+
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                uint32_t pass = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v_clamped, v_screen))));
+                if (pass != 0xFF && (mismatches += std::popcount(pass ^ 0xFFu)) > budget) return budget + 1;
+            }
+        }
+        return mismatches;
+    }
+
+    /**
+     * @brief Counts out-of-bounds pixels (AVX-512BW version, 16 pixels with a masked tail). See CountMismatches_SSE2.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline int CountMismatches_AVX512BW(
+        const PixelBuffer& screen, const ToleranceBounds& bounds, int start_x, int start_y, int budget) noexcept {
+
+        int mismatches = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const COLORREF* lo_row = &bounds.lo[offset];
+            const COLORREF* hi_row = &bounds.hi[offset];
+            const COLORREF* screen_row = &screen.pixels[(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; x += 16) {
+                const __mmask16 lane_mask = span.length - x >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (span.length - x)) - 1);
+                __m512i v_screen = _mm512_maskz_loadu_epi32(lane_mask, screen_row + x);
+                __m512i v_lo = _mm512_maskz_loadu_epi32(lane_mask, lo_row + x);
+                __m512i v_hi = _mm512_maskz_loadu_epi32(lane_mask, hi_row + x);
+
+                __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+                uint32_t fail = _mm512_cmpneq_epi32_mask(v_clamped, v_screen);
+                if (fail != 0 && (mismatches += std::popcount(fail)) > budget) return budget + 1;
+            }
+        }
+        return mismatches;
+    }
+
+    /**
+     * @brief Budgeted variant of ProbeCandidates_SSE2: a lane survives while at most `budget` of the
+     * probe pixels have failed for it. Per-lane failure counts are kept in a vector register.
+     */
+    ISA_TARGET("sse2")
+    inline uint32_t ProbeCandidatesBudget_SSE2(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int budget) noexcept {
+
+        const __m128i v_one = _mm_set1_epi32(1);
+        const __m128i v_budget = _mm_set1_epi32(budget);
+        __m128i v_failures = _mm_setzero_si128();
+        uint32_t survivors = 0xF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_ptr));
+            __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, _mm_set1_epi32(static_cast<int>(probe.hi))),
+                _mm_set1_epi32(static_cast<int>(probe.lo)));
+
+            // A passing lane compares to -1, so adding one counts only the failures.
+            v_failures = _mm_add_epi32(v_failures, _mm_add_epi32(_mm_cmpeq_epi32(v_clamped, v_screen), v_one));
+            __m128i v_over = _mm_cmpgt_epi32(v_failures, v_budget);
+            survivors = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(v_over))) & 0xF;
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Budgeted variant of ProbeCandidates_AVX2. See ProbeCandidatesBudget_SSE2.
+     */
+    ISA_TARGET("avx2")
+    inline uint32_t ProbeCandidatesBudget_AVX2(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int budget) noexcept {
+
+        const __m256i v_one = _mm256_set1_epi32(1);
+        const __m256i v_budget = _mm256_set1_epi32(budget);
+        __m256i v_failures = _mm256_setzero_si256();
+        uint32_t survivors = 0xFF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_ptr));
+            __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, _mm256_set1_epi32(static_cast<int>(probe.hi))),
+                _mm256_set1_epi32(static_cast<int>(probe.lo)));
+
+            v_failures = _mm256_add_epi32(v_failures, _mm256_add_epi32(_mm256_cmpeq_epi32(v_clamped, v_screen), v_one));
+            __m256i v_over = _mm256_cmpgt_epi32(v_failures, v_budget);
+            survivors = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(v_over))) & 0xFF;
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Budgeted variant of ProbeCandidates_AVX512BW. See ProbeCandidatesBudget_SSE2.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline uint32_t ProbeCandidatesBudget_AVX512BW(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int budget) noexcept {
+
+        const __m512i v_one = _mm512_set1_epi32(1);
+        const __m512i v_budget = _mm512_set1_epi32(budget);
+        __m512i v_failures = _mm512_setzero_si512();
+        __mmask16 survivors = 0xFFFF;
+
+        for (const AnchorPixel& probe : probes) {
+            const COLORREF* screen_ptr = &screen.pixels[(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m512i v_screen = _mm512_loadu_si512(screen_ptr);
+            __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, _mm512_set1_epi32(static_cast<int>(probe.hi))),
+                _mm512_set1_epi32(static_cast<int>(probe.lo)));
+
+            __mmask16 fail = _mm512_cmpneq_epi32_mask(v_clamped, v_screen);
+            v_failures = _mm512_mask_add_epi32(v_failures, fail, v_failures, v_one);
+            survivors = _mm512_cmple_epi32_mask(v_failures, v_budget);
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Luma of one pixel: (19 R + 38 G + 7 B + 32) / 64, an integer approximation of the
+     * BT.601 weights (0.299, 0.587, 0.114). PixelBuffer holds DIB pixels, so the low byte is blue.
+     * Every ConvertToLuma kernel computes exactly this value.
+     */
+    inline uint8_t LumaOf(COLORREF pixel) noexcept {
+        return static_cast<uint8_t>((7u * (pixel & 0xFF) + 38u * ((pixel >> 8) & 0xFF) + 19u * ((pixel >> 16) & 0xFF) + 32u) >> 6);
+    }
+
+    /**
+     * @brief Converts `count` pixels to luma (standard C++ version).
+     */
+    inline void ConvertToLuma_Scalar(const COLORREF* pixels, uint8_t* luma, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) luma[i] = LumaOf(pixels[i]);
+    }
+
+    /**
+     * @brief Luma of 4 pixels as 32-bit lanes. The blue/red and green/alpha bytes are split into
+     * 16-bit pairs so that one multiply-add per pair applies two weights at once.
+     */
+    ISA_TARGET("sse2") inline __m128i LumaLanes_SSE2(__m128i v_pixels) noexcept {
+        const __m128i v_byte_mask = _mm_set1_epi32(0x00FF00FF);
+        __m128i v_blue_red = _mm_and_si128(v_pixels, v_byte_mask);
+        __m128i v_green = _mm_and_si128(_mm_srli_epi32(v_pixels, 8), v_byte_mask);
+        __m128i v_sum = _mm_add_epi32(_mm_madd_epi16(v_blue_red, _mm_set1_epi32((19 << 16) | 7)),
+            _mm_madd_epi16(v_green, _mm_set1_epi32(38)));
+        return _mm_srli_epi32(_mm_add_epi32(v_sum, _mm_set1_epi32(32)), 6);
+    }
+
+    /**
+     * @brief Converts pixels to luma (SSE2 version, 16 pixels per iteration).
+     */
+    ISA_TARGET("sse2")
+    inline void ConvertToLuma_SSE2(const COLORREF* pixels, uint8_t* luma, size_t count) noexcept {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m128i* source = reinterpret_cast<const __m128i*>(pixels + i);
+            __m128i v_low = _mm_packs_epi32(LumaLanes_SSE2(_mm_loadu_si128(source)), LumaLanes_SSE2(_mm_loadu_si128(source + 1)));
+            __m128i v_high = _mm_packs_epi32(LumaLanes_SSE2(_mm_loadu_si128(source + 2)), LumaLanes_SSE2(_mm_loadu_si128(source + 3)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(luma + i), _mm_packus_epi16(v_low, v_high));
+        }
+        ConvertToLuma_Scalar(pixels + i, luma + i, count - i);
+    }
+
+    /**
+     * @brief Luma of 8 pixels as 32-bit lanes. See LumaLanes_SSE2.
+     */
+    ISA_TARGET("avx2") inline __m256i LumaLanes_AVX2(__m256i v_pixels) noexcept {
+        const __m256i v_byte_mask = _mm256_set1_epi32(0x00FF00FF);
+        __m256i v_blue_red = _mm256_and_si256(v_pixels, v_byte_mask);
+        __m256i v_green = _mm256_and_si256(_mm256_srli_epi32(v_pixels, 8), v_byte_mask);
+        __m256i v_sum = _mm256_add_epi32(_mm256_madd_epi16(v_blue_red, _mm256_set1_epi32((19 << 16) | 7)),
+            _mm256_madd_epi16(v_green, _mm256_set1_epi32(38)));
+        return _mm256_srli_epi32(_mm256_add_epi32(v_sum, _mm256_set1_epi32(32)), 6);
+    }
+
+    /**
+     * @brief Converts pixels to luma (AVX2 version, 32 pixels per iteration).
+     * The packs work within 128-bit lanes, so the packed dwords come out as a0 b0 c0 d0 a1 b1 c1 d1
+     * and one cross-lane permute restores pixel order.
+     */
+    ISA_TARGET("avx2")
+    inline void ConvertToLuma_AVX2(const COLORREF* pixels, uint8_t* luma, size_t count) noexcept {
+        const __m256i v_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const __m256i* source = reinterpret_cast<const __m256i*>(pixels + i);
+            __m256i v_low = _mm256_packs_epi32(LumaLanes_AVX2(_mm256_loadu_si256(source)), LumaLanes_AVX2(_mm256_loadu_si256(source + 1)));
+            __m256i v_high = _mm256_packs_epi32(LumaLanes_AVX2(_mm256_loadu_si256(source + 2)), LumaLanes_AVX2(_mm256_loadu_si256(source + 3)));
+            __m256i v_bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(v_low, v_high), v_order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(luma + i), v_bytes);
+        }
+        ConvertToLuma_Scalar(pixels + i, luma + i, count - i);
+    }
+
+    /**
+     * @brief Converts pixels to luma (AVX-512BW version, 16 pixels with a masked tail).
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline void ConvertToLuma_AVX512BW(const COLORREF* pixels, uint8_t* luma, size_t count) noexcept {
+        const __m512i v_byte_mask = _mm512_set1_epi32(0x00FF00FF);
+        const __m512i v_blue_red_weights = _mm512_set1_epi32((19 << 16) | 7);
+        const __m512i v_green_weight = _mm512_set1_epi32(38);
+        const __m512i v_round = _mm512_set1_epi32(32);
+        for (size_t i = 0; i < count; i += 16) {
+            const __mmask16 lane_mask = count - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m512i v_pixels = _mm512_maskz_loadu_epi32(lane_mask, pixels + i);
+            __m512i v_blue_red = _mm512_and_si512(v_pixels, v_byte_mask);
+            __m512i v_green = _mm512_and_si512(_mm512_srli_epi32(v_pixels, 8), v_byte_mask);
+            __m512i v_sum = _mm512_add_epi32(_mm512_madd_epi16(v_blue_red, v_blue_red_weights),
+                _mm512_madd_epi16(v_green, v_green_weight));
+            _mm512_mask_cvtepi32_storeu_epi8(luma + i, lane_mask, _mm512_srli_epi32(_mm512_add_epi32(v_sum, v_round), 6));
+        }
+    }
+
+    /**
+     * @brief Sobel gradient magnitude of the pixel at `x` of `row`: min(255, (|Gx| + |Gy|) / 4).
+     * The scale makes a sharp step between two flat areas of luma a and b come out as |a - b|.
+     * Every SobelRow kernel computes exactly this value.
+     */
+    inline uint8_t SobelMagnitude(const uint8_t* above, const uint8_t* row, const uint8_t* below, int x) noexcept {
+        const int gx = (above[x + 1] + 2 * row[x + 1] + below[x + 1]) - (above[x - 1] + 2 * row[x - 1] + below[x - 1]);
+        const int gy = (below[x - 1] + 2 * below[x] + below[x + 1]) - (above[x - 1] + 2 * above[x] + above[x + 1]);
+        return static_cast<uint8_t>(std::min(255, (abs(gx) + abs(gy)) >> 2));
+    }
+
+    /**
+     * @brief Gradient magnitudes of one row of a luma plane (standard C++ version). The first and
+     * last pixels lack a neighbour and are set to 0.
+     */
+    inline void SobelRow_Scalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int width) noexcept {
+        for (int x = 1; x < width - 1; ++x) out[x] = SobelMagnitude(above, row, below, x);
+        out[0] = 0;
+        if (width > 1) out[width - 1] = 0;
+    }
+
+    /**
+     * @brief (|Gx| + |Gy|) / 4 of 8 pixels from their 16-bit neighbours: above-left, above, above-right,
+     * left, right, below-left, below, below-right. |Gx| + |Gy| <= 2040 cannot overflow.
+     */
+    ISA_TARGET("sse2") inline __m128i SobelLanes_SSE2(
+        __m128i a0, __m128i a1, __m128i a2, __m128i b0, __m128i b2, __m128i c0, __m128i c1, __m128i c2) noexcept {
+        __m128i v_gx = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(a2, c2), _mm_add_epi16(b2, b2)),
+            _mm_add_epi16(_mm_add_epi16(a0, c0), _mm_add_epi16(b0, b0)));
+        __m128i v_gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(c0, c2), _mm_add_epi16(c1, c1)),
+            _mm_add_epi16(_mm_add_epi16(a0, a2), _mm_add_epi16(a1, a1)));
+        const __m128i v_zero = _mm_setzero_si128();
+        __m128i v_abs_gx = _mm_max_epi16(v_gx, _mm_sub_epi16(v_zero, v_gx));
+        __m128i v_abs_gy = _mm_max_epi16(v_gy, _mm_sub_epi16(v_zero, v_gy));
+        return _mm_srli_epi16(_mm_add_epi16(v_abs_gx, v_abs_gy), 2);
+    }
+
+    /**
+     * @brief Gradient magnitudes of one row (SSE2 version, 16 pixels per iteration). See SobelRow_Scalar.
+     * The bytes are widened to 16 bits and the final unsigned saturating pack clamps to 255.
+     */
+    ISA_TARGET("sse2")
+    inline void SobelRow_SSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int width) noexcept {
+        const __m128i v_zero = _mm_setzero_si128();
+        int x = 1;
+        for (; x + 17 <= width; x += 16) {
+            __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - 1));
+            __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+            __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1));
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 1));
+            __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x + 1));
+            __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - 1));
+            __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+            __m128i c2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + 1));
+
+            __m128i v_low = SobelLanes_SSE2(
+                _mm_unpacklo_epi8(a0, v_zero), _mm_unpacklo_epi8(a1, v_zero), _mm_unpacklo_epi8(a2, v_zero),
+                _mm_unpacklo_epi8(b0, v_zero), _mm_unpacklo_epi8(b2, v_zero),
+                _mm_unpacklo_epi8(c0, v_zero), _mm_unpacklo_epi8(c1, v_zero), _mm_unpacklo_epi8(c2, v_zero));
+            __m128i v_high = SobelLanes_SSE2(
+                _mm_unpackhi_epi8(a0, v_zero), _mm_unpackhi_epi8(a1, v_zero), _mm_unpackhi_epi8(a2, v_zero),
+                _mm_unpackhi_epi8(b0, v_zero), _mm_unpackhi_epi8(b2, v_zero),
+                _mm_unpackhi_epi8(c0, v_zero), _mm_unpackhi_epi8(c1, v_zero), _mm_unpackhi_epi8(c2, v_zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(v_low, v_high));
+        }
+        for (; x < width - 1; ++x) out[x] = SobelMagnitude(above, row, below, x);
+        out[0] = 0;
+        if (width > 1) out[width - 1] = 0;
+    }
+
+    /**
+     * @brief (|Gx| + |Gy|) / 4 of 16 pixels. See SobelLanes_SSE2.
+     */
+    ISA_TARGET("avx2") inline __m256i SobelLanes_AVX2(
+        __m256i a0, __m256i a1, __m256i a2, __m256i b0, __m256i b2, __m256i c0, __m256i c1, __m256i c2) noexcept {
+        __m256i v_gx = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(a2, c2), _mm256_add_epi16(b2, b2)),
+            _mm256_add_epi16(_mm256_add_epi16(a0, c0), _mm256_add_epi16(b0, b0)));
+        __m256i v_gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(c0, c2), _mm256_add_epi16(c1, c1)),
+            _mm256_add_epi16(_mm256_add_epi16(a0, a2), _mm256_add_epi16(a1, a1)));
+        return _mm256_srli_epi16(_mm256_add_epi16(_mm256_abs_epi16(v_gx), _mm256_abs_epi16(v_gy)), 2);
+    }
+
+    /**
+     * @brief Gradient magnitudes of one row (AVX2 version, 32 pixels per iteration). See SobelRow_SSE2.
+     * The unpacks and the pack both work within 128-bit lanes, so the output needs no permute.
+     */
+    ISA_TARGET("avx2")
+    inline void SobelRow_AVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int width) noexcept {
+        const __m256i v_zero = _mm256_setzero_si256();
+        int x = 1;
+        for (; x + 33 <= width; x += 32) {
+            __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x - 1));
+            __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x));
+            __m256i a2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x + 1));
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x - 1));
+            __m256i b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x + 1));
+            __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x - 1));
+            __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x));
+            __m256i c2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x + 1));
+
+            __m256i v_low = SobelLanes_AVX2(
+                _mm256_unpacklo_epi8(a0, v_zero), _mm256_unpacklo_epi8(a1, v_zero), _mm256_unpacklo_epi8(a2, v_zero),
+                _mm256_unpacklo_epi8(b0, v_zero), _mm256_unpacklo_epi8(b2, v_zero),
+                _mm256_unpacklo_epi8(c0, v_zero), _mm256_unpacklo_epi8(c1, v_zero), _mm256_unpacklo_epi8(c2, v_zero));
+            __m256i v_high = SobelLanes_AVX2(
+                _mm256_unpackhi_epi8(a0, v_zero), _mm256_unpackhi_epi8(a1, v_zero), _mm256_unpackhi_epi8(a2, v_zero),
+                _mm256_unpackhi_epi8(b0, v_zero), _mm256_unpackhi_epi8(b2, v_zero),
+                _mm256_unpackhi_epi8(c0, v_zero), _mm256_unpackhi_epi8(c1, v_zero), _mm256_unpackhi_epi8(c2, v_zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_packus_epi16(v_low, v_high));
+        }
+        for (; x < width - 1; ++x) out[x] = SobelMagnitude(above, row, below, x);
+        out[0] = 0;
+        if (width > 1) out[width - 1] = 0;
+    }
+
+    /**
+     * @brief Range check of a candidate on a byte plane (standard C++ version).
+     * All CheckByteMatch kernels visit only the constrained spans of the template (ByteBounds::spans).
+     * @return True if every screen value lies within the bounds of its template pixel.
+     */
+    inline bool CheckByteMatch_Scalar(const BytePlane& screen, const ByteBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const uint8_t* lo_row = &bounds.lo[offset];
+            const uint8_t* hi_row = &bounds.hi[offset];
+            const uint8_t* screen_row = &screen.pixels[static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; ++x) {
+                if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on a byte plane (SSE2 version, 16 pixels).
+     */
+    ISA_TARGET("sse2")
+    inline bool CheckByteMatch_SSE2(const BytePlane& screen, const ByteBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const uint8_t* lo_row = &bounds.lo[offset];
+            const uint8_t* hi_row = &bounds.hi[offset];
+            const uint8_t* screen_row = &screen.pixels[static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 15 < span.length; x += 16) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)) != 0xFFFF) return false;
+            }
+            for (; x < span.length; ++x) {
+                if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on a byte plane (AVX2 version, 32 pixels, then 16).
+     */
+    ISA_TARGET("avx2")
+    inline bool CheckByteMatch_AVX2(const BytePlane& screen, const ByteBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const uint8_t* lo_row = &bounds.lo[offset];
+            const uint8_t* hi_row = &bounds.hi[offset];
+            const uint8_t* screen_row = &screen.pixels[static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x];
+
+            int x = 0;
+            for (; x + 31 < span.length; x += 32) {
+                __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+                __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo_row + x));
+                __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi_row + x));
+
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v_clamped, v_screen)) != -1) return false;
+            }
+            if (x + 15 < span.length) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)) != 0xFFFF) return false;
+                x += 16;
+            }
+            for (; x < span.length; ++x) {
+                if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on a byte plane (AVX-512BW version, 64 pixels with a masked tail).
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline bool CheckByteMatch_AVX512BW(const BytePlane& screen, const ByteBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const uint8_t* lo_row = &bounds.lo[offset];
+            const uint8_t* hi_row = &bounds.hi[offset];
+            const uint8_t* screen_row = &screen.pixels[static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x];
+
+            for (int x = 0; x < span.length; x += 64) {
+                // Masked-off lanes are zero in all three inputs and always pass.
+                const __mmask64 lane_mask = span.length - x >= 64 ? ~0ull : (1ull << (span.length - x)) - 1;
+                __m512i v_screen = _mm512_maskz_loadu_epi8(lane_mask, screen_row + x);
+                __m512i v_lo = _mm512_maskz_loadu_epi8(lane_mask, lo_row + x);
+                __m512i v_hi = _mm512_maskz_loadu_epi8(lane_mask, hi_row + x);
+
+                __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+                if (_mm512_cmpneq_epi8_mask(v_clamped, v_screen) != 0) return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Byte-plane counterpart of ProbeCandidates_SSE2: tests the probe pixels of 16 consecutive
+     * candidates at once. Probe bounds are gray, so their low byte is the plane bound.
+     * @return A bit mask of the candidates that passed every probe (bit i = start_x + i).
+     */
+    ISA_TARGET("sse2")
+    inline uint32_t ProbeBytes_SSE2(const BytePlane& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+        uint32_t survivors = 0xFFFF;
+        for (const AnchorPixel& probe : probes) {
+            const uint8_t* screen_ptr = &screen.pixels[static_cast<size_t>(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_ptr));
+            __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, _mm_set1_epi8(static_cast<char>(GetRValue(probe.hi)))),
+                _mm_set1_epi8(static_cast<char>(GetRValue(probe.lo))));
+            survivors &= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)));
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Byte-plane probe test of 32 consecutive candidates. See ProbeBytes_SSE2.
+     */
+    ISA_TARGET("avx2")
+    inline uint32_t ProbeBytes_AVX2(const BytePlane& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+        uint32_t survivors = 0xFFFFFFFF;
+        for (const AnchorPixel& probe : probes) {
+            const uint8_t* screen_ptr = &screen.pixels[static_cast<size_t>(start_y + probe.y) * screen.width + start_x + probe.x];
+            __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_ptr));
+            __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, _mm256_set1_epi8(static_cast<char>(GetRValue(probe.hi)))),
+                _mm256_set1_epi8(static_cast<char>(GetRValue(probe.lo))));
+            survivors &= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v_clamped, v_screen)));
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Splits `count` pixels into B, G and R byte planes (standard C++ version).
+     */
+    inline void Deinterleave_Scalar(const COLORREF* pixels, std::array<uint8_t*, 3> planes, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            planes[0][i] = static_cast<uint8_t>(pixels[i]);
+            planes[1][i] = static_cast<uint8_t>(pixels[i] >> 8);
+            planes[2][i] = static_cast<uint8_t>(pixels[i] >> 16);
+        }
+    }
+
+    /**
+     * @brief Splits pixels into byte planes (SSE2 version, 16 pixels per iteration).
+     * Each channel is isolated in 32-bit lanes and narrowed with two saturating packs.
+     */
+    ISA_TARGET("sse2")
+    inline void Deinterleave_SSE2(const COLORREF* pixels, std::array<uint8_t*, 3> planes, size_t count) noexcept {
+        const __m128i v_byte_mask = _mm_set1_epi32(0xFF);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m128i* source = reinterpret_cast<const __m128i*>(pixels + i);
+            const __m128i v_pixels[4] = { _mm_loadu_si128(source), _mm_loadu_si128(source + 1),
+                                          _mm_loadu_si128(source + 2), _mm_loadu_si128(source + 3) };
+            for (int c = 0; c < 3; ++c) {
+                __m128i v_channel[4];
+                for (int r = 0; r < 4; ++r) v_channel[r] = _mm_and_si128(_mm_srl_epi32(v_pixels[r], _mm_cvtsi32_si128(8 * c)), v_byte_mask);
+                __m128i v_bytes = _mm_packus_epi16(_mm_packs_epi32(v_channel[0], v_channel[1]), _mm_packs_epi32(v_channel[2], v_channel[3]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + i), v_bytes);
+            }
+        }
+        Deinterleave_Scalar(pixels + i, { planes[0] + i, planes[1] + i, planes[2] + i }, count - i);
+    }
+
+    /**
+     * @brief Splits pixels into byte planes (AVX2 version, 32 pixels per iteration).
+     * A byte shuffle groups each 128-bit lane as BBBB GGGG RRRR AAAA and a dword permute joins the
+     * two lanes, leaving one 64-bit group of 8 values per channel; 64-bit unpacks and 128-bit
+     * permutes then gather the groups of four registers into one register per channel.
+     */
+    ISA_TARGET("avx2")
+    inline void Deinterleave_AVX2(const COLORREF* pixels, std::array<uint8_t*, 3> planes, size_t count) noexcept {
+        const __m256i v_group = _mm256_setr_epi8(
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        const __m256i v_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const __m256i* source = reinterpret_cast<const __m256i*>(pixels + i);
+            __m256i v_grouped[4];
+            for (int r = 0; r < 4; ++r) {
+                // Qwords: B0-7 G0-7 R0-7 A0-7 of this register's 8 pixels.
+                v_grouped[r] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(_mm256_loadu_si256(source + r), v_group), v_order);
+            }
+            __m256i v_blue_red_01 = _mm256_unpacklo_epi64(v_grouped[0], v_grouped[1]);
+            __m256i v_blue_red_23 = _mm256_unpacklo_epi64(v_grouped[2], v_grouped[3]);
+            __m256i v_green_01 = _mm256_unpackhi_epi64(v_grouped[0], v_grouped[1]);
+            __m256i v_green_23 = _mm256_unpackhi_epi64(v_grouped[2], v_grouped[3]);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(planes[0] + i), _mm256_permute2x128_si256(v_blue_red_01, v_blue_red_23, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(planes[1] + i), _mm256_permute2x128_si256(v_green_01, v_green_23, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(planes[2] + i), _mm256_permute2x128_si256(v_blue_red_01, v_blue_red_23, 0x31));
+        }
+        Deinterleave_Scalar(pixels + i, { planes[0] + i, planes[1] + i, planes[2] + i }, count - i);
+    }
+
+    /**
+     * @brief Splits pixels into byte planes (AVX-512BW version, 16 pixels with a masked tail).
+     * The truncating down-convert keeps the low byte of each lane, so a shift selects the channel.
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline void Deinterleave_AVX512BW(const COLORREF* pixels, std::array<uint8_t*, 3> planes, size_t count) noexcept {
+        for (size_t i = 0; i < count; i += 16) {
+            const __mmask16 lane_mask = count - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m512i v_pixels = _mm512_maskz_loadu_epi32(lane_mask, pixels + i);
+            _mm512_mask_cvtepi32_storeu_epi8(planes[0] + i, lane_mask, v_pixels);
+            _mm512_mask_cvtepi32_storeu_epi8(planes[1] + i, lane_mask, _mm512_srli_epi32(v_pixels, 8));
+            _mm512_mask_cvtepi32_storeu_epi8(planes[2] + i, lane_mask, _mm512_srli_epi32(v_pixels, 16));
+        }
+    }
+
+    /**
+     * @brief Range check of a candidate on planar data (standard C++ version).
+     * All CheckPlanarMatch kernels visit only the constrained spans of the template (PlanarBounds::spans).
+     * @return True if every channel of every screen pixel lies within the bounds of its template pixel.
+     */
+    inline bool CheckPlanarMatch_Scalar(const PlanarBuffer& screen, const PlanarBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const size_t screen_offset = static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x;
+            for (int c = 0; c < 3; ++c) {
+                const uint8_t* lo_row = &bounds.lo[c][offset];
+                const uint8_t* hi_row = &bounds.hi[c][offset];
+                const uint8_t* screen_row = &screen.planes[c][screen_offset];
+                for (int x = 0; x < span.length; ++x) {
+                    if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on planar data (SSE2 version, 16 channel values).
+     */
+    ISA_TARGET("sse2")
+    inline bool CheckPlanarMatch_SSE2(const PlanarBuffer& screen, const PlanarBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const size_t screen_offset = static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x;
+            for (int c = 0; c < 3; ++c) {
+                const uint8_t* lo_row = &bounds.lo[c][offset];
+                const uint8_t* hi_row = &bounds.hi[c][offset];
+                const uint8_t* screen_row = &screen.planes[c][screen_offset];
+
+                int x = 0;
+                for (; x + 15 < span.length; x += 16) {
+                    __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                    __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                    __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                    __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)) != 0xFFFF) return false;
+                }
+                for (; x < span.length; ++x) {
+                    if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on planar data (AVX2 version, 32 channel values, then 16).
+     */
+    ISA_TARGET("avx2")
+    inline bool CheckPlanarMatch_AVX2(const PlanarBuffer& screen, const PlanarBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const size_t screen_offset = static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x;
+            for (int c = 0; c < 3; ++c) {
+                const uint8_t* lo_row = &bounds.lo[c][offset];
+                const uint8_t* hi_row = &bounds.hi[c][offset];
+                const uint8_t* screen_row = &screen.planes[c][screen_offset];
+
+                int x = 0;
+                for (; x + 31 < span.length; x += 32) {
+                    __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+                    __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo_row + x));
+                    __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi_row + x));
+
+                    __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v_clamped, v_screen)) != -1) return false;
+                }
+                if (x + 15 < span.length) {
+                    __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(screen_row + x));
+                    __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo_row + x));
+                    __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi_row + x));
+
+                    __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)) != 0xFFFF) return false;
+                    x += 16;
+                }
+                for (; x < span.length; ++x) {
+                    if (static_cast<unsigned>(screen_row[x] - lo_row[x]) > static_cast<unsigned>(hi_row[x] - lo_row[x])) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Range check of a candidate on planar data (AVX-512BW version, 64 channel values with a masked tail).
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline bool CheckPlanarMatch_AVX512BW(const PlanarBuffer& screen, const PlanarBounds& bounds, int start_x, int start_y) noexcept {
+        for (const OpaqueSpan& span : bounds.spans) {
+            const size_t offset = static_cast<size_t>(span.y) * bounds.width + span.x;
+            const size_t screen_offset = static_cast<size_t>(start_y + span.y) * screen.width + start_x + span.x;
+            for (int c = 0; c < 3; ++c) {
+                const uint8_t* lo_row = &bounds.lo[c][offset];
+                const uint8_t* hi_row = &bounds.hi[c][offset];
+                const uint8_t* screen_row = &screen.planes[c][screen_offset];
+
+                for (int x = 0; x < span.length; x += 64) {
+                    // Masked-off lanes are zero in all three inputs and always pass.
+                    const __mmask64 lane_mask = span.length - x >= 64 ? ~0ull : (1ull << (span.length - x)) - 1;
+                    __m512i v_screen = _mm512_maskz_loadu_epi8(lane_mask, screen_row + x);
+                    __m512i v_lo = _mm512_maskz_loadu_epi8(lane_mask, lo_row + x);
+                    __m512i v_hi = _mm512_maskz_loadu_epi8(lane_mask, hi_row + x);
+
+                    __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+                    if (_mm512_cmpneq_epi8_mask(v_clamped, v_screen) != 0) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Planar counterpart of ProbeCandidates_SSE2: tests the probe pixels of 16 consecutive
+     * candidates, one channel plane at a time.
+     * @return A bit mask of the candidates that passed every probe (bit i = start_x + i).
+     */
+    ISA_TARGET("sse2")
+    inline uint32_t ProbePlanar_SSE2(const PlanarBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+        uint32_t survivors = 0xFFFF;
+        for (const AnchorPixel& probe : probes) {
+            const size_t offset = static_cast<size_t>(start_y + probe.y) * screen.width + start_x + probe.x;
+            for (int c = 0; c < 3; ++c) {
+                __m128i v_screen = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&screen.planes[c][offset]));
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, _mm_set1_epi8(static_cast<char>(probe.hi >> (8 * c)))),
+                    _mm_set1_epi8(static_cast<char>(probe.lo >> (8 * c))));
+                survivors &= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v_clamped, v_screen)));
+            }
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Planar probe test of 32 consecutive candidates. See ProbePlanar_SSE2.
+     */
+    ISA_TARGET("avx2")
+    inline uint32_t ProbePlanar_AVX2(const PlanarBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y) noexcept {
+        uint32_t survivors = 0xFFFFFFFF;
+        for (const AnchorPixel& probe : probes) {
+            const size_t offset = static_cast<size_t>(start_y + probe.y) * screen.width + start_x + probe.x;
+            for (int c = 0; c < 3; ++c) {
+                __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&screen.planes[c][offset]));
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, _mm256_set1_epi8(static_cast<char>(probe.hi >> (8 * c)))),
+                    _mm256_set1_epi8(static_cast<char>(probe.lo >> (8 * c))));
+                survivors &= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v_clamped, v_screen)));
+            }
+            if (survivors == 0) break;
+        }
+        return survivors;
+    }
+
+    /**
+     * @brief Marks which of `count` pixels lie within one pair of bounds (standard C++ version).
+     * All MarkInBounds kernels write 1 to out[i] if every byte of pixels[i] lies in [lo, hi], else 0.
+     */
+    inline void MarkInBounds_Scalar(const COLORREF* pixels, COLORREF lo, COLORREF hi, uint8_t* out, size_t count) noexcept {
+        for (size_t i = 0; i < count; ++i) {
+            bool inside = true;
+            for (int shift = 0; shift < 32; shift += 8) {
+                const unsigned value = (pixels[i] >> shift) & 0xFF, low = (lo >> shift) & 0xFF, high = (hi >> shift) & 0xFF;
+                inside &= value - low <= high - low;
+            }
+            out[i] = inside;
+        }
+    }
+
+    /**
+     * @brief Marks in-bounds pixels (SSE2 version, 16 pixels per iteration).
+     * The per-pixel results are narrowed from 32-bit lanes to bytes with two saturating packs.
+     */
+    ISA_TARGET("sse2")
+    inline void MarkInBounds_SSE2(const COLORREF* pixels, COLORREF lo, COLORREF hi, uint8_t* out, size_t count) noexcept {
+        const __m128i v_lo = _mm_set1_epi32(static_cast<int>(lo));
+        const __m128i v_hi = _mm_set1_epi32(static_cast<int>(hi));
+        const __m128i v_all = _mm_set1_epi32(-1);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m128i* source = reinterpret_cast<const __m128i*>(pixels + i);
+            __m128i v_inside[4];
+            for (int r = 0; r < 4; ++r) {
+                __m128i v_screen = _mm_loadu_si128(source + r);
+                __m128i v_clamped = _mm_max_epu8(_mm_min_epu8(v_screen, v_hi), v_lo);
+                v_inside[r] = _mm_cmpeq_epi32(_mm_cmpeq_epi8(v_clamped, v_screen), v_all);
+            }
+            __m128i v_bytes = _mm_packs_epi16(_mm_packs_epi32(v_inside[0], v_inside[1]), _mm_packs_epi32(v_inside[2], v_inside[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_and_si128(v_bytes, _mm_set1_epi8(1)));
+        }
+        MarkInBounds_Scalar(pixels + i, lo, hi, out + i, count - i);
+    }
+
+    /**
+     * @brief Marks in-bounds pixels (AVX2 version, 32 pixels per iteration).
+     * The packs work within 128-bit lanes, so a dword permute restores the pixel order.
+     */
+    ISA_TARGET("avx2")
+    inline void MarkInBounds_AVX2(const COLORREF* pixels, COLORREF lo, COLORREF hi, uint8_t* out, size_t count) noexcept {
+        const __m256i v_lo = _mm256_set1_epi32(static_cast<int>(lo));
+        const __m256i v_hi = _mm256_set1_epi32(static_cast<int>(hi));
+        const __m256i v_all = _mm256_set1_epi32(-1);
+        const __m256i v_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            const __m256i* source = reinterpret_cast<const __m256i*>(pixels + i);
+            __m256i v_inside[4];
+            for (int r = 0; r < 4; ++r) {
+                __m256i v_screen = _mm256_loadu_si256(source + r);
+                __m256i v_clamped = _mm256_max_epu8(_mm256_min_epu8(v_screen, v_hi), v_lo);
+                v_inside[r] = _mm256_cmpeq_epi32(_mm256_cmpeq_epi8(v_clamped, v_screen), v_all);
+            }
+            __m256i v_bytes = _mm256_packs_epi16(_mm256_packs_epi32(v_inside[0], v_inside[1]), _mm256_packs_epi32(v_inside[2], v_inside[3]));
+            v_bytes = _mm256_permutevar8x32_epi32(v_bytes, v_order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_and_si256(v_bytes, _mm256_set1_epi8(1)));
+        }
+        MarkInBounds_Scalar(pixels + i, lo, hi, out + i, count - i);
+    }
+
+    /**
+     * @brief Marks in-bounds pixels (AVX-512BW version, 16 pixels with a masked tail).
+     */
+    ISA_TARGET("avx512f,avx512bw")
+    inline void MarkInBounds_AVX512BW(const COLORREF* pixels, COLORREF lo, COLORREF hi, uint8_t* out, size_t count) noexcept {
+        const __m512i v_lo = _mm512_set1_epi32(static_cast<int>(lo));
+        const __m512i v_hi = _mm512_set1_epi32(static_cast<int>(hi));
+        const __m512i v_one = _mm512_set1_epi32(1);
+        for (size_t i = 0; i < count; i += 16) {
+            const __mmask16 lane_mask = count - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (count - i)) - 1);
+            __m512i v_screen = _mm512_maskz_loadu_epi32(lane_mask, pixels + i);
+            __m512i v_clamped = _mm512_max_epu8(_mm512_min_epu8(v_screen, v_hi), v_lo);
+            __m512i v_inside = _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(v_clamped, v_screen), v_one);
+            _mm512_mask_cvtepi32_storeu_epi8(out + i, lane_mask, v_inside);
+        }
+    }
+}
+
+// =================================================================================================
+// #BLOCK# KERNEL DISPATCH
+// Per-instruction-set kernel tables, resolved once and bound outside the candidate loops.
+// =================================================================================================
+
+/**
+ * @struct KernelTable
+ * @brief The comparison kernels of one instruction set level.
+ */
+struct KernelTable {
+    SimdLevel level;
+    // Full range check of one candidate against the template bounds.
+    bool (*check_bounds)(const PixelBuffer&, const ToleranceBounds&, int, int) noexcept;
+    // Probe test of `probe_lanes` consecutive candidates; nullptr if the level has none.
+    uint32_t (*probe_candidates)(const PixelBuffer&, const std::vector<AnchorPixel>&, int, int) noexcept;
+    int probe_lanes;
+    // Early-abandoning distance score of one candidate, for the best-match search.
+    uint64_t (*score_bounds)(const PixelBuffer&, const ToleranceBounds&, int, int, uint64_t) noexcept;
+    // Mismatch-budget variants of check_bounds and probe_candidates.
+    int (*count_mismatches)(const PixelBuffer&, const ToleranceBounds&, int, int, int) noexcept;
+    uint32_t (*probe_candidates_budget)(const PixelBuffer&, const std::vector<AnchorPixel>&, int, int, int) noexcept;
+    // Luma and gradient modes: screen conversion, Sobel pass over one row of the luma plane, and
+    // full range check and probe test of `plane_lanes` candidates on a byte plane.
+    void (*convert_luma)(const COLORREF*, uint8_t*, size_t) noexcept;
+    void (*sobel_row)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int) noexcept;
+    bool (*check_bytes)(const BytePlane&, const ByteBounds&, int, int) noexcept;
+    uint32_t (*probe_bytes)(const BytePlane&, const std::vector<AnchorPixel>&, int, int) noexcept;
+    // Planar layout: screen deinterleave, full range check and probe test of `plane_lanes` candidates.
+    void (*deinterleave)(const COLORREF*, std::array<uint8_t*, 3>, size_t) noexcept;
+    bool (*check_planar)(const PlanarBuffer&, const PlanarBounds&, int, int) noexcept;
+    uint32_t (*probe_planar)(const PlanarBuffer&, const std::vector<AnchorPixel>&, int, int) noexcept;
+    // Candidates per probe of the byte-plane kernels; 0 if the level has none.
+    int plane_lanes;
+    // Solid-color templates: in-bounds flags of a screen row, see SolidMatch::Scan.
+    void (*mark_in_bounds)(const COLORREF*, COLORREF, COLORREF, uint8_t*, size_t) noexcept;
+    // Template scaling: horizontal and vertical passes of the fixed-point resampler, see Resample::Scale.
+    Resample::RowKernel resample_row;
+    Resample::BlendKernel blend_rows;
+};
+
+/**
+ * @brief Returns the kernel table of a level, whether or not the CPU supports it.
+ * ImageSearchDLL.cpp goes through GetKernelTable, which caps the level at the detected one.
+ */
+inline const KernelTable& KernelTableFor(SimdLevel level) noexcept {
+    static const KernelTable tables[] = {
+        { SimdLevel::Scalar, PixelComparison::CheckBoundsMatch_Scalar, nullptr, 0,
+          PixelComparison::ScoreBounds_Scalar, PixelComparison::CountMismatches_Scalar, nullptr,
+          PixelComparison::ConvertToLuma_Scalar, PixelComparison::SobelRow_Scalar, PixelComparison::CheckByteMatch_Scalar, nullptr,
+          PixelComparison::Deinterleave_Scalar, PixelComparison::CheckPlanarMatch_Scalar, nullptr, 0,
+          PixelComparison::MarkInBounds_Scalar, Resample::ResampleRow_Scalar, Resample::BlendRows_Scalar },
+        { SimdLevel::SSE2, PixelComparison::CheckBoundsMatch_SSE2, PixelComparison::ProbeCandidates_SSE2, 4,
+          PixelComparison::ScoreBounds_SSE2, PixelComparison::CountMismatches_SSE2, PixelComparison::ProbeCandidatesBudget_SSE2,
+          PixelComparison::ConvertToLuma_SSE2, PixelComparison::SobelRow_SSE2, PixelComparison::CheckByteMatch_SSE2, PixelComparison::ProbeBytes_SSE2,
+          PixelComparison::Deinterleave_SSE2, PixelComparison::CheckPlanarMatch_SSE2, PixelComparison::ProbePlanar_SSE2, 16,
+          PixelComparison::MarkInBounds_SSE2, Resample::ResampleRow_SSE2, Resample::BlendRows_SSE2 },
+        { SimdLevel::SSE41, PixelComparison::CheckBoundsMatch_SSE41, PixelComparison::ProbeCandidates_SSE2, 4,
+          PixelComparison::ScoreBounds_SSE2, PixelComparison::CountMismatches_SSE2, PixelComparison::ProbeCandidatesBudget_SSE2,
+          PixelComparison::ConvertToLuma_SSE2, PixelComparison::SobelRow_SSE2, PixelComparison::CheckByteMatch_SSE2, PixelComparison::ProbeBytes_SSE2,
+          PixelComparison::Deinterleave_SSE2, PixelComparison::CheckPlanarMatch_SSE2, PixelComparison::ProbePlanar_SSE2, 16,
+          PixelComparison::MarkInBounds_SSE2, Resample::ResampleRow_SSE2, Resample::BlendRows_SSE2 },
+        { SimdLevel::AVX2, PixelComparison::CheckBoundsMatchAny_AVX2, PixelComparison::ProbeCandidates_AVX2, 8,
+          PixelComparison::ScoreBounds_AVX2, PixelComparison::CountMismatches_AVX2, PixelComparison::ProbeCandidatesBudget_AVX2,
+          PixelComparison::ConvertToLuma_AVX2, PixelComparison::SobelRow_AVX2, PixelComparison::CheckByteMatch_AVX2, PixelComparison::ProbeBytes_AVX2,
+          PixelComparison::Deinterleave_AVX2, PixelComparison::CheckPlanarMatch_AVX2, PixelComparison::ProbePlanar_AVX2, 32,
+          PixelComparison::MarkInBounds_AVX2, Resample::ResampleRow_AVX2, Resample::BlendRows_AVX2 },
+        { SimdLevel::AVX512BW, PixelComparison::CheckBoundsMatch_AVX512BW, PixelComparison::ProbeCandidates_AVX512BW, 16,
+          PixelComparison::ScoreBounds_AVX512BW, PixelComparison::CountMismatches_AVX512BW, PixelComparison::ProbeCandidatesBudget_AVX512BW,
+          // 32 candidates fit the uint32_t survivor mask, so the AVX2 byte-plane probes serve here too,
+          // as does the AVX2 Sobel pass, which is bound by its loads rather than its width.
+          PixelComparison::ConvertToLuma_AVX512BW, PixelComparison::SobelRow_AVX2, PixelComparison::CheckByteMatch_AVX512BW, PixelComparison::ProbeBytes_AVX2,
+          PixelComparison::Deinterleave_AVX512BW, PixelComparison::CheckPlanarMatch_AVX512BW, PixelComparison::ProbePlanar_AVX2, 32,
+          PixelComparison::MarkInBounds_AVX512BW, Resample::ResampleRow_AVX2, Resample::BlendRows_AVX2 },
+    };
+
+    return tables[static_cast<int>(level)];
+}
+
+// Highest instruction set supported by both the CPU and the OS.
+inline std::atomic<SimdLevel> g_detected_simd_level{ SimdLevel::Scalar };
+// Process-wide default, normally the detected level. Can be lowered with the IMAGESEARCH_ISA
+// environment variable to benchmark or cross-check the other kernel sets on one machine.
+inline std::atomic<SimdLevel> g_default_simd_level{ SimdLevel::Scalar };
+// std::once_flag ensures that the CPU feature detection runs exactly once.
+inline std::once_flag g_cpu_check_flag;
+
+/**
+ * @brief Detects the CPU's instruction set level and reads the IMAGESEARCH_ISA override.
+ * This function is called only once using std::call_once.
+ */
+inline void InitializeCpuFeatures() {
+    const SimdLevel detected = DetectSimdLevel();
+    g_detected_simd_level.store(detected);
+
+    SimdLevel default_level = detected;
+    wchar_t env_value[32] = { 0 };
+#if defined(_WIN32)
+    const size_t env_length = GetEnvironmentVariableW(L"IMAGESEARCH_ISA", env_value, static_cast<DWORD>(std::size(env_value)));
+#else
+    size_t env_length = 0;
+    if (const char* value = std::getenv("IMAGESEARCH_ISA")) {
+        for (; value[env_length] != '\0' && env_length < std::size(env_value); ++env_length) {
+            env_value[env_length] = static_cast<unsigned char>(value[env_length]);
+        }
+    }
+#endif
+    if (env_length > 0 && env_length < std::size(env_value)) {
+        for (wchar_t& c : env_value) c = static_cast<wchar_t>(towlower(c));
+        if (auto forced = ParseSimdLevel(env_value)) default_level = std::min(*forced, detected);
+    }
+    g_default_simd_level.store(default_level);
+}
+
+/**
+ * @brief Returns the kernel table for a requested level, capped at what the CPU supports.
+ * @param requested The level to use, or std::nullopt for the process-wide default.
+ */
+inline const KernelTable& GetKernelTable(std::optional<SimdLevel> requested = std::nullopt) {
+    std::call_once(g_cpu_check_flag, InitializeCpuFeatures);
+    SimdLevel level = requested ? std::min(*requested, g_detected_simd_level.load()) : g_default_simd_level.load();
+    return KernelTableFor(level);
+}
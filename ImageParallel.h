@@ -0,0 +1,145 @@
+// =================================================================================================
+//
+// Name ............: ImageParallel.h
+// Description .....: Process-wide worker pool and band scheduler of the search engine.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Standard C++ only, so the parallel parts of the engine build and run under the tests in tests/.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <queue>
+#include <functional>
+#include <condition_variable>
+#include <climits>
+
+// =================================================================================================
+// #BLOCK# PARALLEL EXECUTION
+// A process-wide worker pool and a band scheduler for splitting one search across cores.
+// =================================================================================================
+
+/**
+ * @class ThreadPool
+ * @brief A simple, fixed-size pool of worker threads executing queued tasks.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers_.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queue_mutex_);
+                        condition_.wait(lock, [this] { return !tasks_.empty(); });
+                        task = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    size_t Size() const noexcept { return workers_.size(); }
+
+    void Enqueue(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            tasks_.push(std::move(task));
+        }
+        condition_.notify_one();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex queue_mutex_;
+    std::condition_variable condition_;
+};
+
+/**
+ * @brief Returns the process-wide worker pool, created on first use.
+ * The pool is intentionally never destroyed: joining threads from DllMain during
+ * DLL_PROCESS_DETACH would deadlock on the loader lock, and the OS reclaims them at exit.
+ */
+inline ThreadPool& GetWorkerPool() {
+    static ThreadPool* pool = new ThreadPool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return *pool;
+}
+
+/**
+ * @brief Resolves a requested worker count (0 = one per hardware thread).
+ */
+inline int ResolveThreadCount(int requested) noexcept {
+    const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    return requested <= 0 ? hardware : std::min(requested, hardware);
+}
+
+/**
+ * @brief Runs body(band) for every band in [0, band_count) on the calling thread plus up to
+ * `threads - 1` pool workers. Bands are claimed in increasing order.
+ * The caller returns once every band has finished. Helpers that only start after all bands are
+ * claimed exit without touching `body`, so calling this from a pool thread cannot deadlock.
+ */
+inline void RunBands(int band_count, int threads, const std::function<void(int)>& body) {
+    struct State {
+        std::atomic<int> next_band{ 0 };
+        std::atomic<int> finished_bands{ 0 };
+        std::mutex mutex;
+        std::condition_variable all_done;
+        int band_count = 0;
+        const std::function<void(int)>* body = nullptr;
+    };
+    auto state = std::make_shared<State>();
+    state->band_count = band_count;
+    state->body = &body;
+
+    auto work = [](const std::shared_ptr<State>& st) {
+        for (int band; (band = st->next_band.fetch_add(1)) < st->band_count;) {
+            (*st->body)(band);
+            if (st->finished_bands.fetch_add(1) + 1 == st->band_count) {
+                std::lock_guard<std::mutex> lock(st->mutex);
+                st->all_done.notify_all();
+            }
+        }
+    };
+
+    const int helpers = std::min({ threads - 1, band_count - 1, static_cast<int>(GetWorkerPool().Size()) });
+    for (int i = 0; i < helpers; ++i) {
+        GetWorkerPool().Enqueue([state, work] { work(state); });
+    }
+    work(state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->all_done.wait(lock, [&] { return state->finished_bands.load() == band_count; });
+}
+
+/**
+ * @class FirstHitToken
+ * @brief Cancellation token for tasks ranked by a preference order, such as RunBands bands.
+ * Records the lowest position that succeeded; every task ranked after it can no longer affect the
+ * result and skips or abandons its work.
+ */
+class FirstHitToken {
+public:
+    bool Cancelled(int position) const noexcept { return position > first_hit_.load(std::memory_order_relaxed); }
+
+    void Report(int position) noexcept {
+        int current = first_hit_.load();
+        while (position < current && !first_hit_.compare_exchange_weak(current, position)) {}
+    }
+
+private:
+    std::atomic<int> first_hit_{ INT_MAX };
+};
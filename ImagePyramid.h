@@ -0,0 +1,136 @@
+// =================================================================================================
+//
+// Name ............: ImagePyramid.h
+// Description .....: Box-filtered coarse levels of the screen and template.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// The phases of the coarse-to-fine search and the bounds that keep a true match from being
+// rejected at the coarse level. Free of OS dependencies like ImageKernels.h.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <bit>
+
+#include "ImageKernels.h"
+#include "ImageTemplate.h"
+
+// =================================================================================================
+// #BLOCK# IMAGE PYRAMID
+// Box-filtered coarse levels of the screen and template for coarse-to-fine candidate search.
+// =================================================================================================
+
+namespace Pyramid {
+
+    // Deepest supported level. Level L averages 2^L x 2^L blocks (2x and 4x downsampling).
+    constexpr int kMaxLevels = 2;
+    // A coarse template smaller than this in either dimension rejects too little to be worth it.
+    constexpr int kMinCoarseTemplateSize = 2;
+
+    /**
+     * @brief Box-filters an image at every sampling phase of a factor x factor grid.
+     * Phase p = phase_y * factor + phase_x holds the means of the blocks whose top-left pixel is at
+     * (phase_x + k * factor, phase_y + m * factor), so every full-resolution position maps onto
+     * exactly one coarse pixel of one phase. Each channel is rounded down, and only blocks that lie
+     * completely inside the image are emitted.
+     * Block sums are computed with a sliding window (columns first, then rows), so the cost stays
+     * proportional to the image size regardless of the factor.
+     */
+    inline std::vector<PixelBuffer> BuildPhases(const PixelBuffer& src, int factor) {
+        std::vector<PixelBuffer> phases(static_cast<size_t>(factor) * factor);
+        for (int phase_y = 0; phase_y < factor; ++phase_y) {
+            for (int phase_x = 0; phase_x < factor; ++phase_x) {
+                PixelBuffer& phase = phases[phase_y * factor + phase_x];
+                phase.width = std::max(0, (src.width - phase_x) / factor);
+                phase.height = std::max(0, (src.height - phase_y) / factor);
+                phase.pixels.resize(static_cast<size_t>(phase.width) * phase.height);
+            }
+        }
+        if (src.width < factor || src.height < factor) return phases;
+
+        const int level_shift = std::countr_zero(static_cast<unsigned>(factor));
+        // Per-channel sums of `factor` vertically adjacent pixels, for every column.
+        std::vector<int> col_r(src.width, 0), col_g(src.width, 0), col_b(src.width, 0);
+        auto add_row = [&](int y) {
+            const COLORREF* row = &src.pixels[static_cast<size_t>(y) * src.width];
+            for (int x = 0; x < src.width; ++x) {
+                col_r[x] += GetRValue(row[x]); col_g[x] += GetGValue(row[x]); col_b[x] += GetBValue(row[x]);
+            }
+        };
+        auto remove_row = [&](int y) {
+            const COLORREF* row = &src.pixels[static_cast<size_t>(y) * src.width];
+            for (int x = 0; x < src.width; ++x) {
+                col_r[x] -= GetRValue(row[x]); col_g[x] -= GetGValue(row[x]); col_b[x] -= GetBValue(row[x]);
+            }
+        };
+        for (int y = 0; y < factor - 1; ++y) add_row(y);
+
+        for (int y = 0; y + factor <= src.height; ++y) {
+            add_row(y + factor - 1);
+
+            PixelBuffer* row_phases = &phases[(y % factor) * factor];
+            const int cy = y / factor;
+            int sum_r = 0, sum_g = 0, sum_b = 0;
+            for (int x = 0; x < factor - 1; ++x) {
+                sum_r += col_r[x]; sum_g += col_g[x]; sum_b += col_b[x];
+            }
+            // Output pointers for each phase of this row; x advances them round-robin.
+            COLORREF* out[1 << kMaxLevels];
+            for (int p = 0; p < factor; ++p) {
+                out[p] = row_phases[p].pixels.data() + static_cast<size_t>(cy) * row_phases[p].width;
+            }
+            for (int x = 0, p = 0; x + factor <= src.width; ++x) {
+                const int right = x + factor - 1;
+                sum_r += col_r[right]; sum_g += col_g[right]; sum_b += col_b[right];
+
+                // area is a power of two, so the shift is an exact floor division.
+                *out[p]++ = RGB(sum_r >> (2 * level_shift), sum_g >> (2 * level_shift), sum_b >> (2 * level_shift));
+                if (++p == factor) p = 0;
+
+                sum_r -= col_r[x]; sum_g -= col_g[x]; sum_b -= col_b[x];
+            }
+
+            remove_row(y);
+        }
+        return phases;
+    }
+
+    /**
+     * @brief Downsamples template bounds so they stay valid for box-filtered screen levels.
+     * If every screen pixel of a block lies in [lo, hi], the block mean lies in [mean(lo), mean(hi)].
+     * The lower bound is rounded down and the upper bound up, which also covers the rounded-down
+     * screen means produced by BuildPhases. A true match can therefore never be rejected at the
+     * coarse level. Transparent pixels contribute their full 0..255 range and loosen their block.
+     */
+    inline ToleranceBounds DownsampleBounds(const ToleranceBounds& bounds, int factor) {
+        ToleranceBounds coarse;
+        coarse.width = bounds.width / factor;
+        coarse.height = bounds.height / factor;
+        coarse.lo.resize(static_cast<size_t>(coarse.width) * coarse.height);
+        coarse.hi.resize(coarse.lo.size());
+
+        const int area = factor * factor;
+        for (int cy = 0; cy < coarse.height; ++cy) {
+            for (int cx = 0; cx < coarse.width; ++cx) {
+                int lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+                for (int dy = 0; dy < factor; ++dy) {
+                    for (int dx = 0; dx < factor; ++dx) {
+                        size_t i = static_cast<size_t>(cy * factor + dy) * bounds.width + cx * factor + dx;
+                        lo[0] += GetRValue(bounds.lo[i]); lo[1] += GetGValue(bounds.lo[i]); lo[2] += GetBValue(bounds.lo[i]);
+                        hi[0] += GetRValue(bounds.hi[i]); hi[1] += GetGValue(bounds.hi[i]); hi[2] += GetBValue(bounds.hi[i]);
+                    }
+                }
+                size_t o = static_cast<size_t>(cy) * coarse.width + cx;
+                coarse.lo[o] = RGB(lo[0] / area, lo[1] / area, lo[2] / area);
+                coarse.hi[o] = RGB((hi[0] + area - 1) / area, (hi[1] + area - 1) / area, (hi[2] + area - 1) / area) | 0xFF000000;
+            }
+        }
+        TemplateAnalysis::FinalizeBounds(coarse);
+        return coarse;
+    }
+}
@@ -0,0 +1,320 @@
+// =================================================================================================
+//
+// Name ............: ImageResample.h
+// Description .....: Separable fixed-point image scaling with scalar, SSE2 and AVX2 kernels.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Scales 32-bit pixels laid out like a Win32 COLORREF (0x00BBGGRR, all four bytes are resampled)
+// with an area or bilinear filter. It has no OS dependencies, so it is shared by ImageSearchDLL.cpp
+// and the tests in tests/, which build on any platform.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// SIMD Headers for CPU extensions
+#include <immintrin.h>
+
+// GCC and Clang only emit instructions of an extension inside functions that enable it; MSVC
+// accepts every intrinsic anywhere, so the attribute is only needed for the former.
+#ifndef ISA_TARGET
+#if defined(__GNUC__) || defined(__clang__)
+#define ISA_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ISA_TARGET(isa)
+#endif
+#endif
+
+/**
+ * @enum ResampleFilter
+ * @brief How a scaled pixel is derived from the source pixels it covers.
+ */
+enum class ResampleFilter {
+    // Mean of the source area the pixel covers, weighted by coverage. Does not alias when shrinking.
+    Area,
+    // Linear interpolation between the 2x2 source pixels nearest to the pixel center.
+    Bilinear
+};
+
+namespace Resample {
+
+    // One pixel; the same type as COLORREF (a DWORD) on Windows, without including windows.h.
+#if defined(_WIN32)
+    using Pixel = unsigned long;
+#else
+    using Pixel = uint32_t;
+#endif
+    static_assert(sizeof(Pixel) == 4, "the kernels address a pixel as 4 channel bytes");
+
+    // Fixed-point resampling (see Scale). Filter weights are Q14 and always sum to exactly
+    // 1 << kResampleWeightBits. The horizontal pass keeps kResampleExtraBits of fraction in its 16-bit
+    // output; the vertical pass removes the rest with rounding.
+    constexpr int kResampleWeightBits = 14;
+    constexpr int kResampleExtraBits = 7;
+    constexpr int kResampleHorizontalShift = kResampleWeightBits - kResampleExtraBits;
+    constexpr int kResampleVerticalShift = kResampleWeightBits + kResampleExtraBits;
+
+    // Signatures shared by the kernels of every instruction set, see ResampleRow_Scalar and BlendRows_Scalar.
+    using RowKernel = void (*)(const Pixel*, const int*, const int16_t*, int, int16_t*, int) noexcept;
+    using BlendKernel = void (*)(const int16_t* const*, const int16_t*, int, Pixel*, int) noexcept;
+
+    // Two adjacent Q14 weights as the multiplier pair of a 16-bit multiply-add.
+    inline int WeightPair(const int16_t* weights) noexcept {
+        return static_cast<int>(static_cast<uint16_t>(weights[0]) | static_cast<uint32_t>(static_cast<uint16_t>(weights[1])) << 16);
+    }
+
+    inline void ResamplePixel(const Pixel* source, const int16_t* weights, int taps, int16_t* out) noexcept {
+        for (int c = 0; c < 4; ++c) {
+            int sum = 1 << (kResampleHorizontalShift - 1);
+            for (int k = 0; k < taps; ++k) sum += static_cast<int>((source[k] >> (8 * c)) & 0xFF) * weights[k];
+            out[c] = static_cast<int16_t>(sum >> kResampleHorizontalShift);
+        }
+    }
+
+    inline uint8_t BlendValue(const int16_t* const* rows, const int16_t* weights, int taps, int i) noexcept {
+        int sum = 1 << (kResampleVerticalShift - 1);
+        for (int k = 0; k < taps; ++k) sum += rows[k][i] * weights[k];
+        return static_cast<uint8_t>(sum >> kResampleVerticalShift);
+    }
+
+    /**
+     * @brief Horizontal resampling pass over one row (standard C++ version).
+     * All ResampleRow kernels compute `count` output pixels; output i is the weighted sum of the
+     * `taps` source pixels from row[starts[i]], with weights[i * taps ..]. `taps` is even and the row
+     * is readable up to the last tap. Channels are written as 4 int16 values per pixel with
+     * kResampleExtraBits of fraction.
+     */
+    inline void ResampleRow_Scalar(const Pixel* row, const int* starts, const int16_t* weights, int taps, int16_t* out, int count) noexcept {
+        for (int i = 0; i < count; ++i) ResamplePixel(row + starts[i], weights + static_cast<size_t>(i) * taps, taps, out + 4 * i);
+    }
+
+    /**
+     * @brief Horizontal resampling pass (SSE2 version, one output pixel and two taps per multiply-add).
+     * The two source pixels of a tap pair are widened to 16 bits and interleaved by channel, so one
+     * _mm_madd_epi16 with the weight pair yields the partial sums of all four channels.
+     */
+    ISA_TARGET("sse2")
+    inline void ResampleRow_SSE2(const Pixel* row, const int* starts, const int16_t* weights, int taps, int16_t* out, int count) noexcept {
+        const __m128i v_zero = _mm_setzero_si128();
+        const __m128i v_round = _mm_set1_epi32(1 << (kResampleHorizontalShift - 1));
+        for (int i = 0; i < count; ++i) {
+            const Pixel* source = row + starts[i];
+            const int16_t* w = weights + static_cast<size_t>(i) * taps;
+            __m128i v_sum = v_round;
+            for (int k = 0; k < taps; k += 2) {
+                __m128i v_pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + k)), v_zero);
+                v_pixels = _mm_unpacklo_epi16(v_pixels, _mm_srli_si128(v_pixels, 8));
+                v_sum = _mm_add_epi32(v_sum, _mm_madd_epi16(v_pixels, _mm_set1_epi32(WeightPair(w + k))));
+            }
+            v_sum = _mm_srai_epi32(v_sum, kResampleHorizontalShift);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * i), _mm_packs_epi32(v_sum, v_sum));
+        }
+    }
+
+    /**
+     * @brief Horizontal resampling pass (AVX2 version, two output pixels per iteration, one per 128-bit lane).
+     */
+    ISA_TARGET("avx2")
+    inline void ResampleRow_AVX2(const Pixel* row, const int* starts, const int16_t* weights, int taps, int16_t* out, int count) noexcept {
+        // Interleaves the 16-bit channels of the two pixels in each lane: b0 b1 g0 g1 r0 r1 a0 a1.
+        const __m256i v_by_channel = _mm256_setr_epi8(
+            0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+            0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+        const __m256i v_round = _mm256_set1_epi32(1 << (kResampleHorizontalShift - 1));
+        int i = 0;
+        for (; i + 2 <= count; i += 2) {
+            const Pixel* source_0 = row + starts[i];
+            const Pixel* source_1 = row + starts[i + 1];
+            const int16_t* w_0 = weights + static_cast<size_t>(i) * taps;
+            const int16_t* w_1 = w_0 + taps;
+            __m256i v_sum = v_round;
+            for (int k = 0; k < taps; k += 2) {
+                __m128i v_bytes = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source_0 + k)),
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source_1 + k)));
+                __m256i v_pixels = _mm256_shuffle_epi8(_mm256_cvtepu8_epi16(v_bytes), v_by_channel);
+                __m256i v_weights = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(WeightPair(w_0 + k))),
+                    _mm_set1_epi32(WeightPair(w_1 + k)), 1);
+                v_sum = _mm256_add_epi32(v_sum, _mm256_madd_epi16(v_pixels, v_weights));
+            }
+            v_sum = _mm256_srai_epi32(v_sum, kResampleHorizontalShift);
+            __m256i v_packed = _mm256_packs_epi32(v_sum, v_sum);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * i), _mm256_castsi256_si128(v_packed));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4 * i + 4), _mm256_extracti128_si256(v_packed, 1));
+        }
+        for (; i < count; ++i) ResamplePixel(row + starts[i], weights + static_cast<size_t>(i) * taps, taps, out + 4 * i);
+    }
+
+    /**
+     * @brief Vertical resampling pass producing one output row (standard C++ version).
+     * All BlendRows kernels combine `taps` rows of the horizontal pass, value by value, with one
+     * weight per row, and write `count` pixels. `taps` is even.
+     */
+    inline void BlendRows_Scalar(const int16_t* const* rows, const int16_t* weights, int taps, Pixel* out, int count) noexcept {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(out);
+        for (int i = 0; i < count * 4; ++i) bytes[i] = BlendValue(rows, weights, taps, i);
+    }
+
+    /**
+     * @brief Vertical resampling pass (SSE2 version, 8 values per iteration).
+     * Values of two rows are interleaved so that each _mm_madd_epi16 applies two row weights at once.
+     */
+    ISA_TARGET("sse2")
+    inline void BlendRows_SSE2(const int16_t* const* rows, const int16_t* weights, int taps, Pixel* out, int count) noexcept {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(out);
+        const __m128i v_round = _mm_set1_epi32(1 << (kResampleVerticalShift - 1));
+        const int values = count * 4;
+        int i = 0;
+        for (; i + 8 <= values; i += 8) {
+            __m128i v_low = v_round, v_high = v_round;
+            for (int k = 0; k < taps; k += 2) {
+                __m128i v_a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+                __m128i v_b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i));
+                const __m128i v_weights = _mm_set1_epi32(WeightPair(weights + k));
+                v_low = _mm_add_epi32(v_low, _mm_madd_epi16(_mm_unpacklo_epi16(v_a, v_b), v_weights));
+                v_high = _mm_add_epi32(v_high, _mm_madd_epi16(_mm_unpackhi_epi16(v_a, v_b), v_weights));
+            }
+            __m128i v_words = _mm_packs_epi32(_mm_srai_epi32(v_low, kResampleVerticalShift), _mm_srai_epi32(v_high, kResampleVerticalShift));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(bytes + i), _mm_packus_epi16(v_words, v_words));
+        }
+        for (; i < values; ++i) bytes[i] = BlendValue(rows, weights, taps, i);
+    }
+
+    /**
+     * @brief Vertical resampling pass (AVX2 version, 16 values per iteration).
+     * The unpacks and packs stay within 128-bit lanes, so the values come out in order per lane and
+     * one qword permute joins the two halves.
+     */
+    ISA_TARGET("avx2")
+    inline void BlendRows_AVX2(const int16_t* const* rows, const int16_t* weights, int taps, Pixel* out, int count) noexcept {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(out);
+        const __m256i v_round = _mm256_set1_epi32(1 << (kResampleVerticalShift - 1));
+        const int values = count * 4;
+        int i = 0;
+        for (; i + 16 <= values; i += 16) {
+            __m256i v_low = v_round, v_high = v_round;
+            for (int k = 0; k < taps; k += 2) {
+                __m256i v_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + i));
+                __m256i v_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + i));
+                const __m256i v_weights = _mm256_set1_epi32(WeightPair(weights + k));
+                v_low = _mm256_add_epi32(v_low, _mm256_madd_epi16(_mm256_unpacklo_epi16(v_a, v_b), v_weights));
+                v_high = _mm256_add_epi32(v_high, _mm256_madd_epi16(_mm256_unpackhi_epi16(v_a, v_b), v_weights));
+            }
+            __m256i v_words = _mm256_packs_epi32(_mm256_srai_epi32(v_low, kResampleVerticalShift), _mm256_srai_epi32(v_high, kResampleVerticalShift));
+            __m256i v_bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(v_words, v_words), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), _mm256_castsi256_si128(v_bytes));
+        }
+        for (; i < values; ++i) bytes[i] = BlendValue(rows, weights, taps, i);
+    }
+
+    /**
+     * @struct Taps
+     * @brief The filter of one axis: output i reads `count` consecutive source pixels from starts[i].
+     */
+    struct Taps {
+        int count = 0;
+        std::vector<int> starts;
+        // Q14 weights, `count` per output, each group summing to exactly 1 << kResampleWeightBits.
+        std::vector<int16_t> weights;
+    };
+
+    /**
+     * @brief Computes the filter taps for scaling `source_size` pixels to `target_size` along one axis.
+     * The tap count is rounded up to even for the paired multiply-adds of the kernels; unused taps
+     * have weight 0. Starts are kept within [0, source_size - count] when the source is long enough.
+     */
+    inline Taps BuildTaps(int source_size, int target_size, ResampleFilter filter) {
+        const double ratio = static_cast<double>(source_size) / target_size;
+        Taps taps;
+        taps.count = filter == ResampleFilter::Area ? static_cast<int>(std::ceil(ratio)) + 1 : 2;
+        taps.count += taps.count & 1;
+        taps.starts.resize(target_size);
+        taps.weights.assign(static_cast<size_t>(target_size) * taps.count, 0);
+
+        std::vector<double> contribution(taps.count);
+        for (int i = 0; i < target_size; ++i) {
+            std::fill(contribution.begin(), contribution.end(), 0.0);
+            int first;
+            if (filter == ResampleFilter::Area) {
+                const double begin = i * ratio, end = std::min((i + 1) * ratio, static_cast<double>(source_size));
+                first = std::min(static_cast<int>(begin), source_size - 1);
+                for (int k = 0; k < taps.count && first + k < source_size; ++k) {
+                    contribution[k] = std::max(0.0, std::min(end, first + k + 1.0) - std::max(begin, static_cast<double>(first + k)));
+                }
+            }
+            else {
+                const double center = std::clamp((i + 0.5) * ratio - 0.5, 0.0, static_cast<double>(source_size - 1));
+                first = static_cast<int>(center);
+                const double fraction = center - first;
+                contribution[0] = 1.0 - fraction;
+                if (first + 1 < source_size) contribution[1] = fraction;
+            }
+
+            // Slide the window left so every tap reads inside the source; contributions move along.
+            const int shift = std::clamp(first + taps.count - source_size, 0, first);
+            if (shift > 0) {
+                std::copy_backward(contribution.begin(), contribution.end() - shift, contribution.end());
+                std::fill(contribution.begin(), contribution.begin() + shift, 0.0);
+                first -= shift;
+            }
+
+            // Quantize, then give the rounding residual to the largest weight so the sum is exact.
+            double total = 0.0;
+            for (double value : contribution) total += value;
+            int16_t* weights = &taps.weights[static_cast<size_t>(i) * taps.count];
+            int sum = 0, largest = 0;
+            for (int k = 0; k < taps.count; ++k) {
+                weights[k] = static_cast<int16_t>(std::lround(contribution[k] / total * (1 << kResampleWeightBits)));
+                sum += weights[k];
+                if (weights[k] > weights[largest]) largest = k;
+            }
+            weights[largest] = static_cast<int16_t>(weights[largest] + (1 << kResampleWeightBits) - sum);
+            taps.starts[i] = first;
+        }
+        return taps;
+    }
+
+    /**
+     * @brief Scales a source_width x source_height image to width x height with the given filter.
+     * A horizontal pass turns every source row into 16-bit channel values of the target width, and
+     * a vertical pass blends those rows into each target row. Both run on the given kernels; every
+     * instruction set produces bit-identical output. `target` holds width * height pixels.
+     */
+    inline void Scale(const Pixel* source, int source_width, int source_height, Pixel* target, int width, int height,
+        ResampleFilter filter, RowKernel resample_row, BlendKernel blend_rows) {
+        if (source_width == width && source_height == height) {
+            std::copy_n(source, static_cast<size_t>(width) * height, target);
+            return;
+        }
+
+        const Taps columns = BuildTaps(source_width, width, filter);
+        const Taps rows = BuildTaps(source_height, height, filter);
+
+        // Source rows are copied into a zero-padded row so the last taps may read past a short row.
+        std::vector<Pixel> padded(static_cast<size_t>(source_width) + columns.count, 0);
+        const size_t values = static_cast<size_t>(width) * 4;
+        std::vector<int16_t> horizontal(static_cast<size_t>(source_height) * values);
+        for (int y = 0; y < source_height; ++y) {
+            std::copy_n(&source[static_cast<size_t>(y) * source_width], source_width, padded.begin());
+            resample_row(padded.data(), columns.starts.data(), columns.weights.data(), columns.count,
+                &horizontal[y * values], width);
+        }
+
+        // Taps past the last row have weight 0 and read the last row instead.
+        std::vector<const int16_t*> inputs(rows.count);
+        for (int y = 0; y < height; ++y) {
+            for (int k = 0; k < rows.count; ++k) {
+                inputs[k] = &horizontal[std::min(rows.starts[y] + k, source_height - 1) * values];
+            }
+            blend_rows(inputs.data(), &rows.weights[static_cast<size_t>(y) * rows.count], rows.count,
+                &target[static_cast<size_t>(y) * width], width);
+        }
+    }
+}
@@ -0,0 +1,1045 @@
+// =================================================================================================
+//
+// Name ............: ImageSearchCore.h
+// Description .....: The search engine: per-call screen data and the scanners behind SearchForBitmap.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Everything between a captured screen and a list of matches. The DLL adds capture, file
+// loading, scaling and the exported API; the tests in tests/ call the engine directly.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <climits>
+#include <vector>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <bit>
+
+#include "ImageKernels.h"
+#include "ImageTemplate.h"
+#include "ImageWindowStats.h"
+#include "ImageParallel.h"
+#include "ImageCorrelation.h"
+#include "ImagePyramid.h"
+#include "ImageExactMatch.h"
+#include "ImageSolidMatch.h"
+
+// =================================================================================================
+// #BLOCK# SCREEN CACHE
+// Per-call data derived from the capture, shared by every template and scale of the call.
+// =================================================================================================
+
+/**
+ * @class ScreenCache
+ * @brief Data derived from one screen capture, built lazily on first use and shared across all
+ * templates and scales of a single ImageSearch call.
+ */
+class ScreenCache {
+public:
+    explicit ScreenCache(const PixelBuffer& screen) : screen_(screen) {}
+
+    const PixelBuffer& Screen() const noexcept { return screen_; }
+
+    /**
+     * @brief Returns the box-filtered screen at pyramid level `level` for every sampling phase.
+     * See Pyramid::BuildPhases for the layout.
+     */
+    const std::vector<PixelBuffer>& PyramidPhases(int level) {
+        std::call_once(pyramid_once_[level - 1], [this, level] {
+            pyramid_phases_[level - 1] = Pyramid::BuildPhases(screen_, 1 << level);
+        });
+        return pyramid_phases_[level - 1];
+    }
+
+    /**
+     * @brief Returns the per-channel summed-area tables of the screen, or of its squared values.
+     */
+    const WindowStats::IntegralImage& ChannelSums(bool squared) {
+        std::call_once(integral_once_[squared], [this, squared] {
+            integral_[squared] = WindowStats::BuildIntegralImage(screen_, squared);
+        });
+        return integral_[squared];
+    }
+
+    /**
+     * @brief Returns the screen spectra and moment tables of the correlation search.
+     * @param threads Cores used to build them on first use.
+     */
+    const Correlation::ScreenData& CorrelationData(int threads) {
+        std::call_once(correlation_once_, [this, threads] {
+            correlation_ = Correlation::BuildScreenData(screen_, threads);
+        });
+        return correlation_;
+    }
+
+    /**
+     * @brief Returns the luma plane of the screen (see PixelComparison::LumaOf).
+     * @param kernels Supplies the conversion kernel used on first use.
+     */
+    const BytePlane& Luma(const KernelTable& kernels) {
+        std::call_once(luma_once_, [this, &kernels] {
+            luma_.width = screen_.width;
+            luma_.height = screen_.height;
+            luma_.pixels.resize(screen_.pixels.size());
+            kernels.convert_luma(screen_.pixels.data(), luma_.pixels.data(), screen_.pixels.size());
+        });
+        return luma_;
+    }
+
+    /**
+     * @brief Returns the Sobel gradient magnitudes of the luma plane (see PixelComparison::SobelMagnitude).
+     * The outermost rows and columns are 0.
+     * @param kernels Supplies the conversion and Sobel kernels used on first use.
+     */
+    const BytePlane& Gradient(const KernelTable& kernels) {
+        std::call_once(gradient_once_, [this, &kernels] {
+            const BytePlane& luma = Luma(kernels);
+            const int width = luma.width;
+            gradient_.width = width;
+            gradient_.height = luma.height;
+            gradient_.pixels.assign(luma.pixels.size(), 0);
+            for (int y = 1; y < luma.height - 1; ++y) {
+                const uint8_t* row = &luma.pixels[static_cast<size_t>(y) * width];
+                kernels.sobel_row(row - width, row, row + width, &gradient_.pixels[static_cast<size_t>(y) * width], width);
+            }
+        });
+        return gradient_;
+    }
+
+    /**
+     * @brief Returns the screen split into B, G and R byte planes.
+     * @param kernels Supplies the deinterleave kernel used on first use.
+     */
+    const PlanarBuffer& Planar(const KernelTable& kernels) {
+        std::call_once(planar_once_, [this, &kernels] {
+            planar_.width = screen_.width;
+            planar_.height = screen_.height;
+            for (auto& plane : planar_.planes) plane.resize(screen_.pixels.size());
+            kernels.deinterleave(screen_.pixels.data(),
+                { planar_.planes[0].data(), planar_.planes[1].data(), planar_.planes[2].data() }, screen_.pixels.size());
+        });
+        return planar_;
+    }
+
+private:
+    const PixelBuffer& screen_;
+    std::once_flag integral_once_[2];
+    WindowStats::IntegralImage integral_[2];
+    std::once_flag pyramid_once_[Pyramid::kMaxLevels];
+    std::vector<PixelBuffer> pyramid_phases_[Pyramid::kMaxLevels];
+    std::once_flag correlation_once_;
+    Correlation::ScreenData correlation_;
+    std::once_flag luma_once_;
+    BytePlane luma_;
+    std::once_flag gradient_once_;
+    BytePlane gradient_;
+    std::once_flag planar_once_;
+    PlanarBuffer planar_;
+};
+
+// =================================================================================================
+// #BLOCK# CORE SEARCH ENGINE
+// The main logic that orchestrates the search process.
+// =================================================================================================
+
+/**
+ * @enum SearchStrategy
+ * @brief Selects how SearchForBitmap walks the candidate positions.
+ */
+enum class SearchStrategy {
+    Auto,               // Pick per template, see ChooseSearchStrategy().
+    PerCandidate,       // Anchor prefilter, then the full comparison kernel for one candidate at a time.
+    CandidateVectorized, // Probe pixels broadcast across 8 neighbouring candidates per AVX2 op.
+    ExactHash,           // Rolling-hash engine; only applies when the template demands exact colors.
+    SolidRun             // Run-length engine; only applies when the template is a single color.
+};
+
+/**
+ * @enum MatchMode
+ * @brief What a search returns.
+ */
+enum class MatchMode {
+    // Every position where all opaque pixels lie within the tolerance.
+    Tolerance,
+    // The positions with the lowest distance score, see SearchBestScores.
+    BestScore,
+    // Peaks of the normalized cross-correlation, see SearchCorrelation.
+    Correlation
+};
+
+/**
+ * @enum ColorSpace
+ * @brief What the tolerance of a Tolerance-mode search is applied to.
+ */
+enum class ColorSpace {
+    // Each of R, G and B must lie within the tolerance of the template.
+    Rgb,
+    // Only the luma of each pixel must lie within the tolerance, see BuildLumaToleranceBounds.
+    Luma,
+    // Only the luma gradient magnitude of each pixel must lie within the tolerance, see
+    // BuildGradientToleranceBounds. Matches shapes regardless of their colors.
+    Gradient
+};
+
+/**
+ * @enum PixelLayout
+ * @brief The screen representation the RGB comparison kernels of a full-resolution scan read.
+ */
+enum class PixelLayout {
+    // COLORREF pixels as captured.
+    Interleaved,
+    // Separate B, G and R byte planes (PlanarBuffer), deinterleaved once per call.
+    Planar
+};
+
+/**
+ * @enum WindowStatsMode
+ * @brief Which window statistics the integral-image prefilter compares (see WindowStats::Filter).
+ */
+enum class WindowStatsMode {
+    Off,
+    Mean,
+    MeanVariance
+};
+
+/**
+ * @enum OverlapPolicy
+ * @brief How find-all searches treat matches whose rectangles overlap.
+ */
+enum class OverlapPolicy {
+    // Report every matching position.
+    All,
+    // Drop rectangles identical to one already reported (e.g. from another file or scale).
+    Distinct,
+    // Non-maximum suppression: drop rectangles whose intersection-over-union with an earlier (or,
+    // in the ranked modes, better) one exceeds SearchOptions::overlap_iou.
+    Suppress,
+    // Drop every rectangle that overlaps an earlier one. The scanner skips the positions covered
+    // by an accepted match instead of testing them.
+    NoOverlap
+};
+
+/**
+ * @enum ScaleStrategy
+ * @brief How the steps between fMinScale and fMaxScale are searched.
+ */
+enum class ScaleStrategy {
+    // Screen when a call searches at least kScreenScaleMinTemplates files, Template otherwise.
+    Auto,
+    // Resize each template to each scale and search the capture.
+    Template,
+    // Resize the capture by the inverse of each scale once per call, shared by every template, and
+    // search the templates at their native size. Matches are mapped back to capture coordinates.
+    Screen
+};
+
+// Files per call from which ScaleStrategy::Auto resizes the capture instead of the templates.
+constexpr size_t kScreenScaleMinTemplates = 4;
+
+/**
+ * @enum ScaleSearch
+ * @brief Which of the steps between fMinScale and fMaxScale are searched in full.
+ */
+enum class ScaleSearch {
+    // Every step, from fMinScale up.
+    Linear,
+    // Estimate the best step with a cheap score on a coarse subset, refine it by bisection, and
+    // search only the best estimates in full (see ScaleEstimate::Refine).
+    Refine
+};
+
+/**
+ * @enum ScaleOrder
+ * @brief Preference order of the scale steps of a linear search. A first-match search reports the
+ * first step in this order that matches, however many of them run in parallel.
+ */
+enum class ScaleOrder {
+    // Smallest scale first.
+    Ascending,
+    // Closest to scale 1 first; of two equally close steps, the smaller one.
+    Nearest
+};
+
+/**
+ * @struct SearchOptions
+ * @brief Optional engine settings, parsed from the options string of ImageSearchEx.
+ */
+struct SearchOptions {
+    SearchStrategy strategy = SearchStrategy::Auto;
+    // 0 = off; 1 or 2 = locate candidates on the 2x or 4x box-filtered level first.
+    int pyramid_levels = 0;
+    // Cores used by a single template search, spread over its scale steps first; 0 = one per
+    // hardware thread, 1 = serial.
+    int threads = 0;
+    // Kernel instruction set; std::nullopt = process default. Capped at what the CPU supports.
+    std::optional<SimdLevel> simd_level;
+    // Integral-image prefilter ahead of the comparison kernels.
+    WindowStatsMode window_stats = WindowStatsMode::Off;
+    MatchMode match_mode = MatchMode::Tolerance;
+    // Tolerance mode: compare R, G and B, the luma, or the luma gradient of each pixel.
+    ColorSpace color_space = ColorSpace::Rgb;
+    // Tolerance mode: screen layout of the full-resolution scan. Results are identical for both.
+    PixelLayout layout = PixelLayout::Interleaved;
+    // BestScore mode: positions scoring above this are never reported.
+    uint64_t max_score = UINT64_MAX;
+    // Tolerance mode: a candidate still matches with up to max(mismatch_count, mismatch_fraction *
+    // constrained pixels) of its opaque pixels out of tolerance. Both 0 = every pixel must match.
+    int mismatch_count = 0;
+    double mismatch_fraction = 0.0;
+    // Correlation mode: lowest correlation coefficient still reported.
+    double correlation_threshold = 0.9;
+    OverlapPolicy overlap = OverlapPolicy::All;
+    // OverlapPolicy::Suppress: largest intersection-over-union two reported rectangles may have.
+    double overlap_iou = 0.5;
+    // Rotated template variants searched, in degrees counter-clockwise (see Rotation::EnumerateAngles).
+    // A step of 0 searches the upright template only.
+    double rotation_min = 0.0;
+    double rotation_max = 0.0;
+    double rotation_step = 0.0;
+    // Filter used to scale the template (and its tolerance map) for each scale step.
+    ResampleFilter resample = ResampleFilter::Area;
+    // New memory cap of the process-wide TemplateCache, applied at the start of the call and kept
+    // for later calls; 0 = off. std::nullopt leaves the current cap unchanged.
+    std::optional<size_t> template_cache_bytes;
+    ScaleStrategy scale_strategy = ScaleStrategy::Auto;
+    ScaleSearch scale_search = ScaleSearch::Linear;
+    ScaleOrder scale_order = ScaleOrder::Ascending;
+};
+
+/**
+ * @struct SearchStats
+ * @brief Counters accumulated across SearchForBitmap calls, reported in the debug output.
+ */
+struct SearchStats {
+    // Candidates that reached the full-resolution comparison kernel.
+    size_t verified_candidates = 0;
+    // Decoded or scaled templates served by TemplateCache.
+    size_t cached_templates = 0;
+
+    SearchStats& operator+=(const SearchStats& other) noexcept {
+        verified_candidates += other.verified_candidates;
+        cached_templates += other.cached_templates;
+        return *this;
+    }
+};
+
+/**
+ * @brief Resolves SearchStrategy::Auto for a given template and screen.
+ * The candidate-vectorized engine is preferred when the per-candidate SIMD kernel would do little
+ * useful work: templates narrower than one vector, or a first probe pixel that rejects nearly all
+ * candidates on its own.
+ */
+inline SearchStrategy ChooseSearchStrategy(
+    const PixelBuffer& screen_buffer, const ToleranceBounds& bounds, const KernelTable& kernels,
+    const std::vector<AnchorPixel>& probes, int max_x, int max_y) {
+
+    if (!kernels.probe_candidates || probes.empty() || max_x < kernels.probe_lanes - 1) return SearchStrategy::PerCandidate;
+    if (bounds.width < kernels.probe_lanes) return SearchStrategy::CandidateVectorized;
+
+    constexpr double kSelectivePassRate = 0.125;
+    double pass_rate = TemplateAnalysis::EstimateProbePassRate(screen_buffer, probes.front(), max_x, max_y);
+    return pass_rate <= kSelectivePassRate ? SearchStrategy::CandidateVectorized : SearchStrategy::PerCandidate;
+}
+
+/**
+ * @class OverlapGuard
+ * @brief Remembers the rectangles accepted so far in scan order and rejects positions whose
+ * rectangle would overlap one of them. As positions arrive top to bottom, left to right, a single
+ * "free from row" entry per column is enough to answer this in O(1).
+ */
+class OverlapGuard {
+public:
+    OverlapGuard(int columns, int width, int height) : free_from_(columns, 0), width_(width), height_(height) {}
+
+    bool Blocked(int x, int y) const noexcept { return y < free_from_[x]; }
+
+    void Accept(int x, int y) noexcept {
+        const int first = std::max(0, x - width_ + 1);
+        const int last = std::min(static_cast<int>(free_from_.size()) - 1, x + width_ - 1);
+        for (int column = first; column <= last; ++column) {
+            free_from_[column] = std::max(free_from_[column], y + height_);
+        }
+    }
+
+private:
+    std::vector<int> free_from_;
+    int width_, height_;
+};
+
+/**
+ * @class ResultLimit
+ * @brief A result quota shared by every search of one call: all files, scales and bands. Each
+ * reported match claims a slot, and every search stops once none are left.
+ * An optional `cancelled` predicate stops the searches as well, e.g. a scale step ranked after
+ * one that already matched. The scanners poll Stopped() once per row.
+ */
+class ResultLimit {
+public:
+    explicit ResultLimit(size_t limit, std::function<bool()> cancelled = nullptr) noexcept
+        : remaining_(limit), cancelled_(std::move(cancelled)) {}
+
+    size_t Remaining() const noexcept { return remaining_.load(std::memory_order_relaxed); }
+    bool Reached() const noexcept { return Remaining() == 0; }
+    bool Stopped() const { return Reached() || (cancelled_ && cancelled_()); }
+
+    /**
+     * @return False if every slot has already been claimed.
+     */
+    bool Claim() noexcept {
+        size_t current = remaining_.load();
+        while (current > 0 && !remaining_.compare_exchange_weak(current, current - 1)) {}
+        return current > 0;
+    }
+
+private:
+    std::atomic<size_t> remaining_;
+    std::function<bool()> cancelled_;
+};
+
+/**
+ * @brief Runs a row scanner over the candidate rows [0, max_y] and reports its matches in order.
+ * Large scans are split into bands of rows processed across `threads` cores. Matches are always
+ * reported in top-to-bottom, left-to-right order, so the result is identical to a serial scan.
+ * @param max_matches Only the first max_matches matches in scan order are reported (1 = first
+ *        match only, SIZE_MAX = all). Once the bands above a band have found that many between
+ *        them, the band is abandoned; bands above still finish so the top-most matches win.
+ * @param exclusion_width, exclusion_height If non-zero (max_matches > 1), matches are reported only
+ *        if their exclusion_width x exclusion_height rectangle does not overlap an earlier match,
+ *        and the positions such a match covers are skipped without testing them.
+ * @param scan_row Called as scan_row(y, calls, guard, emit). Tests the candidates of row y in
+ *        increasing x, skipping those for which guard->Blocked(x, y) (guard is nullptr without
+ *        an exclusion rectangle), and calls emit(x) for each match. Returns false as soon as emit
+ *        does. `calls` counts the candidates that reached the full comparison kernel.
+ * @param result_limit Optional; every band stops at the next row once it is Stopped().
+ * @param on_match Called with (x, y) for each reported match, always on the calling thread;
+ *        returns false to stop the scan.
+ */
+template <class ScanRow, class OnMatch>
+inline void ScanBands(
+    int max_x, int max_y, size_t max_matches, int threads, int exclusion_width, int exclusion_height,
+    const ResultLimit* result_limit, size_t& kernel_calls, ScanRow&& scan_row, OnMatch&& on_match) {
+
+    if (max_matches == 0) return;
+
+    const bool exclusive = max_matches > 1 && exclusion_width > 0 && exclusion_height > 0;
+    auto make_guard = [&] { return OverlapGuard(exclusive ? max_x + 1 : 0, exclusion_width, exclusion_height); };
+    auto stopped = [result_limit] { return result_limit && result_limit->Stopped(); };
+
+    // Scans rows [y_begin, y_end). `emit` returns false to stop; `cancelled` is polled once per row.
+    // With an exclusion rectangle, `guard` holds the matches accepted so far and is updated here.
+    auto scan_rows = [&](int y_begin, int y_end, size_t& calls, OverlapGuard& guard, auto&& emit, auto&& cancelled) {
+        for (int y = y_begin; y < y_end; ++y) {
+            if (cancelled()) return;
+            const bool more = scan_row(y, calls, exclusive ? &guard : nullptr, [&](int x) {
+                if (exclusive) guard.Accept(x, y);
+                return emit(x, y);
+            });
+            if (!more) return;
+        }
+    };
+
+    // Below this many candidate positions the band setup costs more than it saves.
+    constexpr int64_t kMinParallelCandidates = 256 * 1024;
+    const int rows = max_y + 1;
+    if (threads <= 1 || rows < 2 || static_cast<int64_t>(rows) * (max_x + 1) < kMinParallelCandidates) {
+        OverlapGuard guard = make_guard();
+        size_t reported = 0;
+        scan_rows(0, rows, kernel_calls, guard,
+            [&](int x, int y) { return on_match(x, y) && ++reported < max_matches; },
+            stopped);
+        return;
+    }
+
+    // Several bands per thread keep the cores busy when the prefilter rejects unevenly, and keep
+    // the work wasted above an early first match small.
+    const int band_count = std::min(rows, threads * 8);
+    const int band_height = (rows + band_count - 1) / band_count;
+    const int bands = (rows + band_height - 1) / band_height;
+
+    std::vector<std::vector<std::pair<int, int>>> band_matches(bands);
+    std::vector<size_t> band_calls(bands, 0);
+    std::vector<std::atomic<size_t>> band_found(bands);
+
+    // Under an exclusion rectangle a band's matches may still be dropped in the merge, so they
+    // cannot count towards the limit yet.
+    const size_t band_limit = exclusive ? SIZE_MAX : max_matches;
+    auto enough_above = [&](int band) {
+        if (band_limit == SIZE_MAX) return false;
+        size_t found = 0;
+        for (int above = 0; above < band && found < band_limit; ++above) {
+            found += band_found[above].load(std::memory_order_relaxed);
+        }
+        return found >= band_limit;
+    };
+
+    RunBands(bands, threads, [&](int band) {
+        if (enough_above(band) || stopped()) return;
+        const int y_begin = band * band_height;
+        const int y_end = std::min(rows, y_begin + band_height);
+        auto& found = band_matches[band];
+        // Each band only knows its own matches here; see the merge below.
+        OverlapGuard guard = make_guard();
+
+        scan_rows(y_begin, y_end, band_calls[band], guard,
+            [&](int x, int y) {
+                found.emplace_back(x, y);
+                band_found[band].store(found.size(), std::memory_order_relaxed);
+                return found.size() < band_limit;
+            },
+            [&] { return enough_above(band) || stopped(); });
+    });
+    // Every band's work counts, including that of bands whose matches are never reported.
+    for (size_t calls : band_calls) kernel_calls += calls;
+    if (stopped()) return;
+
+    // A band's exclusions are exact unless one of its matches overlaps a match of an earlier band:
+    // that match is then dropped, and the positions it excluded must be tested after all. Such
+    // bands (rare, as matches must straddle the boundary) are rescanned against the merged guard.
+    OverlapGuard merged = make_guard();
+    size_t reported = 0;
+    for (int band = 0; band < bands; ++band) {
+        auto& found = band_matches[band];
+        if (exclusive) {
+            const bool conflict = std::any_of(found.begin(), found.end(),
+                [&](const std::pair<int, int>& match) { return merged.Blocked(match.first, match.second); });
+            if (conflict) {
+                found.clear();
+                const int y_begin = band * band_height;
+                scan_rows(y_begin, std::min(rows, y_begin + band_height), kernel_calls, merged,
+                    [&](int x, int y) { found.emplace_back(x, y); return true; },
+                    [] { return false; });
+            }
+            else {
+                for (const auto& [x, y] : found) merged.Accept(x, y);
+            }
+        }
+        for (const auto& [x, y] : found) {
+            if (!on_match(x, y) || ++reported >= max_matches) return;
+        }
+    }
+}
+
+/**
+ * @brief Visits every candidate in [0, max_x] x [0, max_y] whose pixels all lie within `bounds`.
+ * See ScanBands for the threading, ordering, max_matches, exclusion and result_limit parameters.
+ * @param window_filter Optional O(1) statistics test run ahead of the full comparison kernel.
+ * @param mismatch_budget Number of constrained pixels allowed to be out of bounds. A non-zero
+ *        budget switches to the counting kernels, which abandon a candidate once it is exceeded.
+ * @param kernel_calls Incremented for every candidate that reaches the full comparison kernel.
+ */
+template <class OnMatch>
+inline void ScanCandidates(
+    const PixelBuffer& screen_buffer, const ToleranceBounds& bounds, const KernelTable& kernels, SearchStrategy strategy,
+    const WindowStats::Filter* window_filter, int max_x, int max_y, size_t max_matches, int threads, int mismatch_budget,
+    int exclusion_width, int exclusion_height, const ResultLimit* result_limit, size_t& kernel_calls, OnMatch&& on_match) {
+
+    // Distinctive pixels are tested first so that most wrong candidates are rejected after a few reads.
+    std::vector<AnchorPixel> anchors = TemplateAnalysis::SelectAnchorPixels(bounds);
+    std::vector<AnchorPixel> probes = TemplateAnalysis::SelectProbePixels(bounds, anchors);
+    // A prefilter that may fail all its pixels without exceeding the budget can never reject anything.
+    if (static_cast<size_t>(mismatch_budget) >= anchors.size()) anchors.clear();
+    if (static_cast<size_t>(mismatch_budget) >= probes.size()) probes.clear();
+
+    // ExactHash and SolidRun are resolved by SearchForBitmap; templates that reach this point pick a scan strategy.
+    if (strategy == SearchStrategy::Auto || strategy == SearchStrategy::ExactHash || strategy == SearchStrategy::SolidRun) {
+        strategy = ChooseSearchStrategy(screen_buffer, bounds, kernels, probes, max_x, max_y);
+    }
+    // The vectorized engine needs a SIMD probe kernel and at least one constrained probe pixel.
+    const bool vectorized = strategy == SearchStrategy::CandidateVectorized && kernels.probe_candidates && !probes.empty();
+
+    // Bound once here so the candidate loops make a plain indirect call, with no per-candidate dispatch.
+    const auto check_bounds = kernels.check_bounds;
+    const auto count_mismatches = kernels.count_mismatches;
+    const auto probe_candidates = kernels.probe_candidates;
+    const auto probe_candidates_budget = kernels.probe_candidates_budget;
+    const int lanes = kernels.probe_lanes;
+    auto full_match = [&](int x, int y) noexcept {
+        if (mismatch_budget == 0) return check_bounds(screen_buffer, bounds, x, y);
+        return count_mismatches(screen_buffer, bounds, x, y, mismatch_budget) <= mismatch_budget;
+    };
+    auto probe = [&](int x, int y) noexcept {
+        if (mismatch_budget == 0) return probe_candidates(screen_buffer, probes, x, y);
+        return probe_candidates_budget(screen_buffer, probes, x, y, mismatch_budget);
+    };
+
+    auto scan_row = [&](int y, size_t& calls, const OverlapGuard* guard, auto&& emit) {
+        int x = 0;
+
+        if (vectorized) {
+            // Blocks of `lanes` candidates whose probe loads stay inside the row; the rest is handled below.
+            for (; x + lanes - 1 <= max_x; x += lanes) {
+                uint32_t survivors = probe(x, y);
+                while (survivors != 0) {
+                    int lane = std::countr_zero(survivors);
+                    survivors &= survivors - 1;
+                    if (guard && guard->Blocked(x + lane, y)) continue;
+                    if (window_filter && !window_filter->Accepts(x + lane, y)) continue;
+                    ++calls;
+                    if (full_match(x + lane, y) && !emit(x + lane)) return false;
+                }
+            }
+        }
+
+        for (; x <= max_x; ++x) {
+            if (guard && guard->Blocked(x, y)) continue;
+            if (!TemplateAnalysis::AnchorsMatch(screen_buffer, anchors, x, y, mismatch_budget)) continue;
+            if (window_filter && !window_filter->Accepts(x, y)) continue;
+            ++calls;
+            if (full_match(x, y) && !emit(x)) return false;
+        }
+        return true;
+    };
+
+    ScanBands(max_x, max_y, max_matches, threads, exclusion_width, exclusion_height, result_limit, kernel_calls, scan_row, on_match);
+}
+
+/**
+ * @brief ScanCandidates for the byte-plane representations of the screen (BytePlane, PlanarBuffer):
+ * visits every candidate whose pixels all lie within `bounds`. See ScanBands for the threading,
+ * ordering, max_matches, exclusion and result_limit parameters.
+ * @param anchor_bounds The ToleranceBounds that `bounds` was extracted from; anchors and probes
+ *        are selected on it.
+ * @param check, probe, lanes The plane kernels of the screen type, see KernelTable.
+ * @param window_filter Optional O(1) statistics test run ahead of the full comparison kernel.
+ */
+template <class Screen, class Bounds, class OnMatch>
+inline void ScanPlaneCandidates(
+    const Screen& screen, const Bounds& bounds, const ToleranceBounds& anchor_bounds,
+    bool (*check)(const Screen&, const Bounds&, int, int) noexcept,
+    uint32_t (*probe)(const Screen&, const std::vector<AnchorPixel>&, int, int) noexcept, int lanes,
+    const WindowStats::Filter* window_filter, int max_x, int max_y, size_t max_matches, int threads,
+    int exclusion_width, int exclusion_height, const ResultLimit* result_limit, size_t& kernel_calls, OnMatch&& on_match) {
+
+    const std::vector<AnchorPixel> anchors = TemplateAnalysis::SelectAnchorPixels(anchor_bounds);
+    const std::vector<AnchorPixel> probes = TemplateAnalysis::SelectProbePixels(anchor_bounds, anchors);
+
+    // One byte-plane probe covers 16-32 candidates, so unlike on COLORREF pixels the probe pass
+    // always pays off.
+    const bool vectorized = probe && !probes.empty();
+
+    auto scan_row = [&](int y, size_t& calls, const OverlapGuard* guard, auto&& emit) {
+        int x = 0;
+
+        if (vectorized) {
+            for (; x + lanes - 1 <= max_x; x += lanes) {
+                uint32_t survivors = probe(screen, probes, x, y);
+                while (survivors != 0) {
+                    int lane = std::countr_zero(survivors);
+                    survivors &= survivors - 1;
+                    if (guard && guard->Blocked(x + lane, y)) continue;
+                    if (window_filter && !window_filter->Accepts(x + lane, y)) continue;
+                    ++calls;
+                    if (check(screen, bounds, x + lane, y) && !emit(x + lane)) return false;
+                }
+            }
+        }
+
+        for (; x <= max_x; ++x) {
+            if (guard && guard->Blocked(x, y)) continue;
+            if (!TemplateAnalysis::AnchorsMatch(screen, anchors, x, y)) continue;
+            if (window_filter && !window_filter->Accepts(x, y)) continue;
+            ++calls;
+            if (check(screen, bounds, x, y) && !emit(x)) return false;
+        }
+        return true;
+    };
+
+    ScanBands(max_x, max_y, max_matches, threads, exclusion_width, exclusion_height, result_limit, kernel_calls, scan_row, on_match);
+}
+
+/**
+ * @brief Coarse-to-fine search: candidates are located on a box-filtered pyramid level with
+ * bound-based tolerance and only the survivors are verified at full resolution.
+ * @param result_limit Optional; the coarse scan and the verification stop once it is Stopped().
+ * @param on_match Called with (x, y) for each match in the same top-to-bottom, left-to-right order
+ *        as the full-resolution scan; returns false to stop.
+ */
+template <class OnMatch>
+inline void SearchPyramid(
+    ScreenCache& screen_cache, const ToleranceBounds& bounds, const KernelTable& kernels, int level, SearchStrategy strategy,
+    const WindowStats::Filter* window_filter, int threads, const ResultLimit* result_limit, SearchStats& stats, OnMatch&& on_match) {
+
+    const PixelBuffer& screen_buffer = screen_cache.Screen();
+    const int factor = 1 << level;
+    const int max_x = screen_buffer.width - bounds.width;
+    const int max_y = screen_buffer.height - bounds.height;
+
+    const ToleranceBounds coarse_bounds = Pyramid::DownsampleBounds(bounds, factor);
+    const std::vector<PixelBuffer>& phases = screen_cache.PyramidPhases(level);
+
+    // Collect coarse survivors from every phase, mapped back to full-resolution coordinates.
+    std::vector<std::pair<int, int>> candidates; // (y, x) so that sorting gives scan order.
+    size_t coarse_calls = 0;
+    for (int phase_y = 0; phase_y < factor && phase_y <= max_y; ++phase_y) {
+        for (int phase_x = 0; phase_x < factor && phase_x <= max_x; ++phase_x) {
+            ScanCandidates(phases[phase_y * factor + phase_x], coarse_bounds, kernels, strategy, nullptr,
+                (max_x - phase_x) / factor, (max_y - phase_y) / factor, SIZE_MAX, threads, 0, 0, 0, result_limit, coarse_calls,
+                [&](int cx, int cy) { candidates.emplace_back(phase_y + cy * factor, phase_x + cx * factor); return true; });
+        }
+    }
+    if (result_limit && result_limit->Stopped()) return;
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto& [y, x] : candidates) {
+        if (window_filter && !window_filter->Accepts(x, y)) continue;
+        ++stats.verified_candidates;
+        if (kernels.check_bounds(screen_buffer, bounds, x, y) && !on_match(x, y)) break;
+    }
+}
+
+/**
+ * @brief Scans a screen buffer for a source image buffer.
+ * @param options Engine settings. Every strategy and pyramid level reports identical matches in the
+ *        same top-to-bottom, left-to-right order.
+ * Fully transparent template borders may extend past the screen buffer; the reported rectangle is
+ * always that of the whole source image.
+ * @param tolerance_map Optional per-pixel tolerance image, see TemplateAnalysis::BuildToleranceBounds.
+ * @param screen_cache Per-call data derived from screen_buffer; a temporary one is used if nullptr.
+ * @param stats Optional counters to accumulate into.
+ * @param result_limit Optional quota shared with other searches; the scan stops as soon as it is
+ *        used up or cancelled, and only the matches that claimed a slot are returned.
+ * @return A vector of MatchResult structs for all found occurrences.
+ */
+inline std::vector<MatchResult> SearchForBitmap(
+    const PixelBuffer& screen_buffer, const PixelBuffer& source_buffer,
+    int search_left, int search_top, int tolerance, COLORREF transparent_color,
+    bool find_all, const SearchOptions& options = {},
+    const PixelBuffer* tolerance_map = nullptr, ScreenCache* screen_cache = nullptr, SearchStats* stats = nullptr,
+    ResultLimit* result_limit = nullptr) {
+
+    std::vector<MatchResult> matches;
+    if (result_limit && result_limit->Stopped()) return matches;
+    SearchStats local_stats;
+    if (!stats) stats = &local_stats;
+
+    // Tolerance (and transparency) are folded into per-pixel bounds once, outside the candidate loop.
+    // Transparent borders are trimmed; the search runs on the opaque core, which may then sit closer
+    // to the screen edge than the full template would fit.
+    auto build_bounds = [&] {
+        switch (options.color_space) {
+        case ColorSpace::Luma:
+            return TemplateAnalysis::BuildLumaToleranceBounds(source_buffer, transparent_color, tolerance, tolerance_map);
+        case ColorSpace::Gradient:
+            return TemplateAnalysis::BuildGradientToleranceBounds(source_buffer, transparent_color, tolerance, tolerance_map);
+        default:
+            return TemplateAnalysis::BuildToleranceBounds(source_buffer, transparent_color, tolerance, tolerance_map);
+        }
+    };
+    int trim_x = 0, trim_y = 0;
+    const ToleranceBounds bounds = TemplateAnalysis::TrimTransparentBorder(build_bounds(), trim_x, trim_y);
+    if (bounds.width > screen_buffer.width || bounds.height > screen_buffer.height) {
+        return matches;
+    }
+
+    const int max_x = screen_buffer.width - bounds.width;
+    const int max_y = screen_buffer.height - bounds.height;
+
+    // Under OverlapPolicy::NoOverlap every engine's matches pass through one guard. ScanCandidates
+    // already skips covered positions itself, so there it never rejects anything.
+    const bool no_overlap = find_all && options.overlap == OverlapPolicy::NoOverlap;
+    std::optional<OverlapGuard> overlap_guard;
+    if (no_overlap) overlap_guard.emplace(max_x + 1, source_buffer.width, source_buffer.height);
+
+    // Reported rectangles always describe the original, untrimmed template.
+    auto on_match = [&](int x, int y) {
+        if (overlap_guard) {
+            if (overlap_guard->Blocked(x, y)) return true;
+            overlap_guard->Accept(x, y);
+        }
+        if (result_limit && !result_limit->Claim()) return false;
+        matches.push_back({ search_left + x - trim_x, search_top + y - trim_y, source_buffer.width, source_buffer.height });
+        // Optimization: if only one is needed, stop immediately.
+        return find_all && !(result_limit && result_limit->Reached());
+    };
+    const int threads = ResolveThreadCount(options.threads);
+    const KernelTable& kernels = GetKernelTable(options.simd_level);
+
+    std::optional<ScreenCache> local_cache;
+    auto cache = [&]() -> ScreenCache& {
+        if (!screen_cache) screen_cache = &local_cache.emplace(screen_buffer);
+        return *screen_cache;
+    };
+    const size_t max_matches = !find_all ? 1 : result_limit ? result_limit->Remaining() : SIZE_MAX;
+    // The serial engines poll the limit themselves; ScanBands does so for the others.
+    auto stopped = [result_limit] { return result_limit && result_limit->Stopped(); };
+
+    // Luma and gradient modes compare 8-bit planes of the screen; the exact, window statistics,
+    // pyramid and mismatch budget paths all work on RGB bounds and do not apply.
+    if (options.color_space != ColorSpace::Rgb) {
+        const BytePlane& plane = options.color_space == ColorSpace::Luma ? cache().Luma(kernels) : cache().Gradient(kernels);
+        ScanPlaneCandidates(plane, TemplateAnalysis::ToByteBounds(bounds), bounds,
+            kernels.check_bytes, kernels.probe_bytes, kernels.plane_lanes, nullptr, max_x, max_y, max_matches, threads,
+            no_overlap ? source_buffer.width : 0, no_overlap ? source_buffer.height : 0, result_limit, stats->verified_candidates, on_match);
+        return matches;
+    }
+
+    int mismatch_budget = std::max(options.mismatch_count, 0);
+    if (options.mismatch_fraction > 0.0) {
+        const double allowed = std::floor(std::min(options.mismatch_fraction, 1.0) *
+            static_cast<double>(TemplateAnalysis::CountConstrainedPixels(bounds)));
+        mismatch_budget = std::max(mismatch_budget, static_cast<int>(allowed));
+    }
+
+    // Single-color templates: run lengths make any scan linear in the screen size, whatever the
+    // template size or tolerance.
+    const bool solid_requested = options.strategy == SearchStrategy::SolidRun ||
+        (options.strategy == SearchStrategy::Auto && options.pyramid_levels == 0);
+    if (mismatch_budget == 0 && solid_requested) {
+        if (const std::optional<SolidMatch::Fill> fill = SolidMatch::Analyze(bounds)) {
+            auto verify = [&](int x, int y) noexcept {
+                ++stats->verified_candidates;
+                return kernels.check_bounds(screen_buffer, bounds, x, y);
+            };
+            SolidMatch::Scan(screen_buffer, *fill, bounds.width, bounds.height, max_x, max_y, kernels.mark_in_bounds, verify, on_match, stopped);
+            return matches;
+        }
+    }
+
+    // Exact-color templates: hashing makes a find-all scan linear in the screen size.
+    const bool exact_requested = options.strategy == SearchStrategy::ExactHash ||
+        (options.strategy == SearchStrategy::Auto && find_all && options.pyramid_levels == 0);
+    if (mismatch_budget == 0 && exact_requested && ExactMatch::IsExact(bounds)) {
+        const OpaqueSpan span = ExactMatch::LongestSpan(bounds);
+        if (span.length > 0) {
+            auto verify = [&](int x, int y) noexcept {
+                ++stats->verified_candidates;
+                return kernels.check_bounds(screen_buffer, bounds, x, y);
+            };
+            if (ExactMatch::IsFullyConstrained(bounds)) {
+                ExactMatch::Scan2D(screen_buffer, bounds, max_x, max_y, verify, on_match, stopped);
+            }
+            else {
+                ExactMatch::ScanSpan(screen_buffer, bounds, span, max_x, max_y, verify, on_match, stopped);
+            }
+            return matches;
+        }
+    }
+
+    // The summed-area tables are built once per screen and shared by every template and scale.
+    // Window statistics and the coarse pyramid level assume every pixel matches, so a mismatch
+    // budget bypasses both.
+    std::optional<WindowStats::Filter> window_filter;
+    if (mismatch_budget == 0 && options.window_stats != WindowStatsMode::Off && WindowStats::Filter::Supports(bounds)) {
+        const bool variance = options.window_stats == WindowStatsMode::MeanVariance;
+        window_filter.emplace(bounds, cache().ChannelSums(false), variance ? &cache().ChannelSums(true) : nullptr);
+    }
+    const WindowStats::Filter* filter = window_filter ? &*window_filter : nullptr;
+
+    // The planar kernels have no mismatch-budget variant and replace the pyramid's coarse pass.
+    if (options.layout == PixelLayout::Planar && mismatch_budget == 0) {
+        ScanPlaneCandidates(cache().Planar(kernels), TemplateAnalysis::ToPlanarBounds(bounds), bounds,
+            kernels.check_planar, kernels.probe_planar, kernels.plane_lanes, filter, max_x, max_y, max_matches, threads,
+            no_overlap ? source_buffer.width : 0, no_overlap ? source_buffer.height : 0, result_limit, stats->verified_candidates, on_match);
+        return matches;
+    }
+
+    // Use the deepest requested pyramid level at which the coarse template is still useful.
+    int level = mismatch_budget == 0 ? std::clamp(options.pyramid_levels, 0, Pyramid::kMaxLevels) : 0;
+    while (level > 0 && std::min(bounds.width, bounds.height) >> level < Pyramid::kMinCoarseTemplateSize) --level;
+    if (level > 0) {
+        SearchPyramid(cache(), bounds, kernels, level, options.strategy, filter, threads, result_limit, *stats, on_match);
+        return matches;
+    }
+
+    ScanCandidates(screen_buffer, bounds, kernels, options.strategy, filter, max_x, max_y, max_matches, threads, mismatch_budget,
+        no_overlap ? source_buffer.width : 0, no_overlap ? source_buffer.height : 0, result_limit, stats->verified_candidates, on_match);
+    return matches;
+}
+
+/**
+ * @brief Finds the positions with the lowest distance score instead of a yes/no match.
+ * The score of a position is the sum, over all opaque template pixels and the R, G and B channels,
+ * of how far the screen value lies outside [template - tolerance, template + tolerance]. With
+ * tolerance 0 it is the plain sum of absolute differences (SAD). Each candidate is abandoned as
+ * soon as its partial score exceeds the worst of the `count` best scores found so far.
+ * @param count Number of positions to return.
+ * @return Up to `count` matches with MatchResult::score set, best first; ties keep scan order.
+ */
+inline std::vector<MatchResult> SearchBestScores(
+    const PixelBuffer& screen_buffer, const PixelBuffer& source_buffer,
+    int search_left, int search_top, int tolerance, COLORREF transparent_color, size_t count,
+    const SearchOptions& options = {},
+    const PixelBuffer* tolerance_map = nullptr, ScreenCache* screen_cache = nullptr, SearchStats* stats = nullptr) {
+
+    std::vector<MatchResult> matches;
+    SearchStats local_stats;
+    if (!stats) stats = &local_stats;
+
+    int trim_x = 0, trim_y = 0;
+    const ToleranceBounds bounds = TemplateAnalysis::TrimTransparentBorder(
+        TemplateAnalysis::BuildToleranceBounds(source_buffer, transparent_color, tolerance, tolerance_map), trim_x, trim_y);
+    if (count == 0 || bounds.width > screen_buffer.width || bounds.height > screen_buffer.height) {
+        return matches;
+    }
+
+    const int max_x = screen_buffer.width - bounds.width;
+    const int max_y = screen_buffer.height - bounds.height;
+    const int threads = ResolveThreadCount(options.threads);
+    const auto score_bounds = GetKernelTable(options.simd_level).score_bounds;
+
+    // With the window statistics enabled, their O(1) lower bound skips hopeless windows.
+    std::optional<ScreenCache> local_cache;
+    std::optional<WindowStats::Filter> window_filter;
+    if (options.window_stats != WindowStatsMode::Off && WindowStats::Filter::Supports(bounds)) {
+        if (!screen_cache) screen_cache = &local_cache.emplace(screen_buffer);
+        window_filter.emplace(bounds, screen_cache->ChannelSums(false), nullptr);
+    }
+
+    struct Scored {
+        uint64_t score;
+        int y, x;
+        bool operator<(const Scored& other) const noexcept {
+            return std::tie(score, y, x) < std::tie(other.score, other.y, other.x);
+        }
+    };
+
+    // Each band keeps its own max-heap of its `count` best candidates. The lowest full-heap bound of
+    // any band is shared, since a candidate worse than `count` others anywhere cannot make the cut.
+    const int rows = max_y + 1;
+    constexpr int64_t kMinParallelCandidates = 64 * 1024;
+    const bool parallel = threads > 1 && rows > 1 && static_cast<int64_t>(rows) * (max_x + 1) >= kMinParallelCandidates;
+    const int band_count = parallel ? std::min(rows, threads * 8) : 1;
+    const int band_height = (rows + band_count - 1) / band_count;
+    const int bands = (rows + band_height - 1) / band_height;
+
+    std::vector<std::vector<Scored>> band_best(bands);
+    std::vector<size_t> band_calls(bands, 0);
+    std::atomic<uint64_t> shared_limit{ options.max_score };
+
+    RunBands(bands, parallel ? threads : 1, [&](int band) {
+        auto& heap = band_best[band];
+        const int y_end = std::min(rows, (band + 1) * band_height);
+        for (int y = band * band_height; y < y_end; ++y) {
+            for (int x = 0; x <= max_x; ++x) {
+                uint64_t limit = shared_limit.load(std::memory_order_relaxed);
+                if (heap.size() == count) limit = std::min(limit, heap.front().score);
+                if (window_filter && window_filter->ScoreLowerBound(x, y) > limit) continue;
+
+                ++band_calls[band];
+                const uint64_t score = score_bounds(screen_buffer, bounds, x, y, limit);
+                if (score > limit) continue;
+
+                const Scored candidate{ score, y, x };
+                if (heap.size() == count) {
+                    if (!(candidate < heap.front())) continue;
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = candidate;
+                }
+                else {
+                    heap.push_back(candidate);
+                }
+                std::push_heap(heap.begin(), heap.end());
+
+                if (heap.size() == count) {
+                    uint64_t current = shared_limit.load();
+                    while (heap.front().score < current && !shared_limit.compare_exchange_weak(current, heap.front().score)) {}
+                }
+            }
+        }
+    });
+
+    std::vector<Scored> best;
+    for (int band = 0; band < bands; ++band) {
+        stats->verified_candidates += band_calls[band];
+        best.insert(best.end(), band_best[band].begin(), band_best[band].end());
+    }
+    std::sort(best.begin(), best.end());
+    if (best.size() > count) best.resize(count);
+
+    for (const Scored& candidate : best) {
+        matches.push_back({ search_left + candidate.x - trim_x, search_top + candidate.y - trim_y,
+            source_buffer.width, source_buffer.height, candidate.score });
+    }
+    return matches;
+}
+
+/**
+ * @brief Finds the template by normalized cross-correlation, which tolerates brightness and
+ * contrast changes that defeat a per-channel tolerance (dimmed dialogs, hover states).
+ * Tolerance and tolerance maps do not apply; transparent pixels are left out of the correlation.
+ * @param find_all If true, every local maximum of the correlation surface that reaches
+ *        options.correlation_threshold is returned in scan order; otherwise only the highest one.
+ * @return Matches with MatchResult::correlation set.
+ */
+inline std::vector<MatchResult> SearchCorrelation(
+    const PixelBuffer& screen_buffer, const PixelBuffer& source_buffer,
+    int search_left, int search_top, COLORREF transparent_color, bool find_all,
+    const SearchOptions& options = {}, ScreenCache* screen_cache = nullptr) {
+
+    std::vector<MatchResult> matches;
+    if (source_buffer.width > screen_buffer.width || source_buffer.height > screen_buffer.height) {
+        return matches;
+    }
+
+    const int threads = ResolveThreadCount(options.threads);
+    std::optional<ScreenCache> local_cache;
+    if (!screen_cache) screen_cache = &local_cache.emplace(screen_buffer);
+
+    const Correlation::Surface surface = Correlation::ComputeSurface(
+        screen_cache->CorrelationData(threads), screen_buffer, source_buffer, transparent_color, threads);
+    std::vector<std::pair<int, int>> peaks = Correlation::FindPeaks(surface, static_cast<float>(options.correlation_threshold));
+
+    auto value = [&](const std::pair<int, int>& peak) {
+        return surface.values[static_cast<size_t>(peak.second) * surface.width + peak.first];
+    };
+    if (!find_all && !peaks.empty()) {
+        // max_element keeps the first of equal values, i.e. the top-most, left-most one.
+        auto best = std::max_element(peaks.begin(), peaks.end(),
+            [&](const auto& a, const auto& b) { return value(a) < value(b); });
+        peaks = { *best };
+    }
+
+    for (const auto& peak : peaks) {
+        MatchResult match{ search_left + peak.first, search_top + peak.second, source_buffer.width, source_buffer.height };
+        match.correlation = value(peak);
+        matches.push_back(match);
+    }
+    return matches;
+}
+
+/**
+ * @brief Filters a list of matches by an overlap policy, keeping the earlier of two conflicting
+ * matches. Used on the combined results of every file and scale, after any ranking.
+ */
+inline void ApplyOverlapPolicy(std::vector<MatchResult>& matches, OverlapPolicy policy, double max_iou) {
+    if (policy == OverlapPolicy::All || matches.size() < 2) return;
+
+    auto intersection = [](const MatchResult& a, const MatchResult& b) -> int64_t {
+        const int64_t w = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+        const int64_t h = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+        return w > 0 && h > 0 ? w * h : 0;
+    };
+    auto conflicts = [&](const MatchResult& a, const MatchResult& b) {
+        switch (policy) {
+        case OverlapPolicy::Distinct:
+            return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+        case OverlapPolicy::NoOverlap:
+            return intersection(a, b) > 0;
+        default: {
+            const double shared = static_cast<double>(intersection(a, b));
+            const double combined = static_cast<double>(a.w) * a.h + static_cast<double>(b.w) * b.h - shared;
+            return shared > 0.0 && shared > max_iou * combined;
+        }
+        }
+    };
+
+    std::vector<MatchResult> kept;
+    for (const MatchResult& match : matches) {
+        if (std::none_of(kept.begin(), kept.end(), [&](const MatchResult& other) { return conflicts(match, other); })) {
+            kept.push_back(match);
+        }
+    }
+    matches = std::move(kept);
+}
@@ -18,8 +18,8 @@
 // 4. For each image, it iterates through specified scaling factors.
 // 5. At each scale, it gets the pixel data of the source image.
 // 6. It calls the core `SearchForBitmap` engine, which scans the screen buffer for the source buffer.
-// 7. The search engine automatically dispatches to a highly optimized AVX2 routine if the CPU
-//    supports it, otherwise it uses a standard scalar routine. The logic is 100% consistent.
+// 7. The search engine dispatches to the widest kernel set the CPU supports (AVX-512BW, AVX2,
+//    SSE4.1, SSE2 or scalar). The logic is 100% consistent across all of them.
 // 8. All found matches are collected.
 // 9. The results are formatted into a single wide-character string: "{count}[x|y|w|h,x|y|w|h,...]".
 // 10. This string is copied into a large, thread-safe static buffer, and a pointer to it is returned.
@@ -32,6 +32,91 @@
 // - Consistent AVX2 Logic: The AVX2 pixel comparison now mirrors the scalar logic (per-channel
 //   tolerance check), ensuring identical results on all CPUs.
 //
+// - Anchor Pixel Prefilter: Each template is analysed once for a few rare, high-contrast opaque
+//   pixels. These are tested first at every candidate position, so the full row-by-row comparison
+//   only runs for the small fraction of positions that survive.
+//
+// - Candidate-Vectorized Engine: For narrow templates or selective probe pixels, the search
+//   broadcasts one template pixel and tests it against 8 neighbouring candidate positions per AVX2
+//   operation, refining a bitmask of survivors before any full comparison runs.
+//
+// - Exact Match Engine: Tolerance-0 find-all searches use a 2D rolling hash (or a row hash of the
+//   longest opaque span for templates with transparency), so their cost is linear in the screen size.
+//   Every hash hit is verified; tests/ImageExactMatchTest.cpp checks the engine against a brute-force
+//   scan, including on screens full of hash collisions.
+//
+// - Solid Color Engine: Single-color templates are found from per-row runs of in-tolerance pixels
+//   (flagged with SIMD) stacked vertically, so the cost is linear in the screen size at any tolerance.
+//   tests/ImageSolidMatchTest.cpp checks it against a brute-force scan.
+//
+// - Multi-ISA Kernel Dispatch: CPUID and XGETBV select one kernel table per call, bound outside the
+//   candidate loops. The IMAGESEARCH_ISA environment variable or the `isa` option lowers the level
+//   for benchmarking and cross-checking. The kernels live in ImageKernels.h, which has no OS
+//   dependencies; tests/ImageKernelsTest.cpp checks every level against scalar on random data.
+//
+// - Narrow Template Kernels: Templates up to 4 pixels wide pack 2 or 4 rows into one AVX2 vector,
+//   and row tails use masked loads, so no template width falls back to a scalar loop on AVX2.
+//
+// - Opaque Span Lists: Templates are trimmed to their non-transparent core and each row is stored
+//   as a list of opaque spans, so kernels never visit transparent borders, rows or wide gaps.
+//
+// - Window Statistics Prefilter: Optional per-channel summed-area tables of the capture bound each
+//   candidate window's mean (and variance) in O(1), ahead of any pixel comparison.
+//
+// - Best-Match Score Mode: Instead of a yes/no tolerance test, candidates can be ranked by their
+//   sum of absolute differences (beyond the tolerance), abandoning each one as soon as it cannot
+//   beat the best scores found so far.
+//
+// - Mismatch Budget: Tolerance matches may allow a fixed count or percentage of opaque pixels to
+//   be out of tolerance. The kernels count failing lanes with a popcount and abandon a candidate
+//   as soon as the budget is exceeded.
+//
+// - Normalized Cross-Correlation: A brightness- and contrast-invariant mode that computes the
+//   correlation surface with a built-in real FFT and window statistics from summed-area tables.
+//   It lives in ImageCorrelation.h; tests/ImageCorrelationTest.cpp checks it against a naive DFT
+//   and a brute-force correlation, and tests/ImageCorrelationBenchmark.cpp times it against SAD.
+//
+// - Luma Mode: An opt-in grayscale tolerance test. The capture is converted once per call to an
+//   8-bit luma plane, so every kernel compares 4x as many pixels per register.
+//
+// - Gradient Mode: Matches Sobel edge-magnitude maps of the capture and template with the same
+//   8-bit kernels, so shapes are found regardless of theme colors or background.
+//
+// - Planar Layout: An optional structure-of-arrays copy of the capture with one byte plane per
+//   channel, produced by a single SIMD deinterleave pass, compared without alpha masking.
+//   tests/ImagePlanarTest.cpp checks that it finds exactly what the interleaved scan finds, and
+//   tests/ImagePlanarBenchmark.cpp times both on full HD and 4K captures.
+//
+// - Rotation Search: Rotated template variants are generated in-library over a range of angles,
+//   kept in the template cache, and scanned against the same per-call screen data.
+//
+// - Template Cache: Decoded templates, their scaled copies and rotated variants are kept
+//   process-wide, keyed by file version, quantized scale and angles, with LRU eviction under one
+//   memory cap, so repeated multi-scale calls skip straight to the search.
+//
+// - Screen Scale Space: For calls with many templates, each scale step resizes the capture once,
+//   shared by every template, instead of resizing every template; matches are mapped back.
+//
+// - Coarse-to-Fine Scale Search: An opt-in mode estimates each scale step with a cheap half-
+//   resolution best-SAD score at a few coarse steps, bisects towards the best one, and searches
+//   only the best estimates in full.
+//
+// - In-Library Resampler: Scale steps resize the template with a separable fixed-point area or
+//   bilinear filter (SSE2/AVX2 multiply-add kernels) instead of GDI StretchBlt round trips. It lives
+//   in ImageResample.h, which has no OS dependencies and is checked by tests/ImageResampleTest.cpp.
+//
+// - Overlap Policies: Find-all results can be de-duplicated, thinned by IoU-based non-maximum
+//   suppression, or kept free of overlaps, in which case covered positions are skipped in-scan.
+//
+// - Banded Multithreading: Large scans are split into bands of rows that run across all cores on
+//   a process-wide worker pool. First-match searches abandon every band below the first hit, and
+//   results stay identical to a serial top-to-bottom, left-to-right scan; tests/ImageScanBandsTest.cpp
+//   checks this for 1 to 16 threads.
+//
+// - Parallel Scale Sweep: The scale steps of an image run as tasks on the same pool, in a fixed
+//   preference order. An atomic first-hit token cancels the steps ranked after a match, and
+//   results are merged in order, so they match a serial sweep.
+//
 // - Centralized GDI+ Management: GDI+ is initialized once via DllMain for better performance and
 //   to adhere to best practices.
 //
@@ -69,35 +154,44 @@
 #include <string_view>
 #include <sstream>
 #include <iomanip>
+#include <climits>
+#include <queue>
+#include <functional>
+#include <condition_variable>
+#include <bit>
+#include <cwctype>
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <complex>
+#include <deque>
+#include <list>
+#include <map>
+#include <limits>
 
 // SIMD Headers for CPU extensions
 #include <immintrin.h>
 #include <intrin.h>
 
+// Template resampler; free of OS dependencies so the tests build it anywhere. Defines ISA_TARGET.
+#include "ImageResample.h"
+// Data structures, CPU detection, comparison kernels and kernel tables, and the template analysis
+// built on them; like the resampler, shared with the tests.
+#include "ImageKernels.h"
+#include "ImageTemplate.h"
+// The search engine (window statistics, worker pool, correlation, pyramid, exact and solid color
+// engines, screen cache and scanners); everything below adds Windows capture and file I/O to it.
+#include "ImageSearchCore.h"
+
 #pragma comment(lib, "gdiplus.lib")
 
 // =================================================================================================
-// #BLOCK# GLOBAL GDI+ MANAGER & CPU FEATURE DETECTION
+// #BLOCK# GLOBAL GDI+ MANAGER
 // Manages global resources and settings for the DLL.
 // =================================================================================================
 
 // GDI+ token, managed by DllMain for process-wide initialization and shutdown.
 ULONG_PTR g_gdiplusToken;
-// Atomic boolean to safely store the result of the AVX2 support check.
-std::atomic<bool> g_is_avx2_supported{ false };
-// std::once_flag ensures that the CPU feature detection runs exactly once.
-std::once_flag g_cpu_check_flag;
-
-/**
- * @brief Detects if the host CPU supports the AVX2 instruction set.
- * This function is called only once using std::call_once.
- */
-void InitializeCpuFeatures() {
-    int cpuInfo[4];
-    __cpuidex(cpuInfo, 7, 0);
-    // Check the 5th bit of the EBX register for AVX2 support.
-    g_is_avx2_supported.store((cpuInfo[1] & (1 << 5)) != 0);
-}
 
 // =================================================================================================
 // #BLOCK# ERROR HANDLING & RESULT TYPES
@@ -143,29 +237,6 @@ const wchar_t* GetErrorMessage(ErrorCode code) {
     }
 }
 
-// =================================================================================================
-// #BLOCK# DATA STRUCTURES
-// Core data structures used for representing images and results.
-// =================================================================================================
-
-/**
- * @struct PixelBuffer
- * @brief A container for raw 32-bit pixel data (COLORREF) along with image dimensions.
- */
-struct PixelBuffer {
-    std::vector<COLORREF> pixels;
-    int width = 0;
-    int height = 0;
-};
-
-/**
- * @struct MatchResult
- * @brief Represents a single found match, containing its location and dimensions.
- */
-struct MatchResult {
-    int x, y, w, h;
-};
-
 // =================================================================================================
 // #BLOCK# HELPER & UTILITY FUNCTIONS
 // A collection of functions for image loading, manipulation, and screen capture.
@@ -181,7 +252,6 @@ inline COLORREF RgbToBgr(DWORD rgb) noexcept {
 }
 
 // Forward declarations for functions defined later in the file.
-HBITMAP ScaleBitmap(HBITMAP hBitmap, int newW, int newH);
 std::optional<PixelBuffer> GetBitmapPixels(HBITMAP hBitmap);
 HBITMAP CaptureScreenRegion(int iLeft, int iTop, int iRight, int iBottom);
 
@@ -204,6 +274,35 @@ HBITMAP LoadImageFromFile(std::wstring_view file_path) {
     return nullptr;
 }
 
+/**
+ * @brief Returns the path of the optional tolerance map of a template file: ".tol" inserted
+ * before the extension, e.g. "C:\img\button.png" -> "C:\img\button.tol.png".
+ */
+std::wstring ToleranceMapPath(std::wstring_view file_path) {
+    size_t name_start = file_path.find_last_of(L"\\/");
+    size_t dot = file_path.find_last_of(L'.');
+    if (dot == std::wstring_view::npos || (name_start != std::wstring_view::npos && dot < name_start)) {
+        dot = file_path.size();
+    }
+
+    std::wstring map_path(file_path.substr(0, dot));
+    map_path += L".tol";
+    map_path += file_path.substr(dot);
+    return map_path;
+}
+
+/**
+ * @brief Loads the optional per-pixel tolerance map that accompanies a template file.
+ * The map is looked up next to the template (see ToleranceMapPath). Its R, G and B values are
+ * per-channel tolerances for the template pixel at the same position.
+ * @return An HBITMAP handle if the map exists and loads, or nullptr otherwise.
+ */
+HBITMAP LoadToleranceMap(std::wstring_view file_path) {
+    const std::wstring map_path = ToleranceMapPath(file_path);
+    if (GetFileAttributesW(map_path.c_str()) == INVALID_FILE_ATTRIBUTES) return nullptr;
+    return LoadImageFromFile(map_path);
+}
+
 /**
  * @brief Extracts the raw 32-bit pixel data from an HBITMAP into a PixelBuffer.
  * @param hBitmap The handle to the source bitmap.
@@ -239,50 +338,6 @@ std::optional<PixelBuffer> GetBitmapPixels(HBITMAP hBitmap) {
     return buffer;
 }
 
-/**
- * @brief Scales an HBITMAP to a new width and height.
- * @param hBitmap The source bitmap handle.
- * @param newW The new width.
- * @param newH The new height.
- * @return A handle to the NEW scaled bitmap on success, or nullptr on failure. The caller is responsible for deleting this bitmap.
- */
-HBITMAP ScaleBitmap(HBITMAP hBitmap, int newW, int newH) {
-    if (!hBitmap || newW <= 0 || newH <= 0) return nullptr;
-
-    HDC hdcScreen = GetDC(nullptr);
-    if (!hdcScreen) return nullptr;
-
-    HDC hdcSrc = CreateCompatibleDC(hdcScreen);
-    HDC hdcDest = CreateCompatibleDC(hdcScreen);
-    HBITMAP hBitmapDest = CreateCompatibleBitmap(hdcScreen, newW, newH);
-
-    // Cleanup resources if any creation failed.
-    if (!hdcSrc || !hdcDest || !hBitmapDest) {
-        if (hdcSrc) DeleteDC(hdcSrc);
-        if (hdcDest) DeleteDC(hdcDest);
-        if (hBitmapDest) DeleteObject(hBitmapDest);
-        ReleaseDC(nullptr, hdcScreen);
-        return nullptr;
-    }
-
-    HBITMAP hOldSrc = (HBITMAP)SelectObject(hdcSrc, hBitmap);
-    HBITMAP hOldDest = (HBITMAP)SelectObject(hdcDest, hBitmapDest);
-
-    BITMAP bm;
-    GetObject(hBitmap, sizeof(bm), &bm);
-    SetStretchBltMode(hdcDest, HALFTONE); // Use a high-quality scaling algorithm.
-    StretchBlt(hdcDest, 0, 0, newW, newH, hdcSrc, 0, 0, bm.bmWidth, bm.bmHeight, SRCCOPY);
-
-    // Clean up GDI objects.
-    SelectObject(hdcSrc, hOldSrc);
-    SelectObject(hdcDest, hOldDest);
-    DeleteDC(hdcSrc);
-    DeleteDC(hdcDest);
-    ReleaseDC(nullptr, hdcScreen);
-
-    return hBitmapDest;
-}
-
 /**
  * @brief Captures a specified rectangular region of the screen into a new HBITMAP.
  * @param iLeft The left coordinate of the region.
@@ -320,159 +375,493 @@ HBITMAP CaptureScreenRegion(int iLeft, int iTop, int iRight, int iBottom) {
 
 
 // =================================================================================================
-// #BLOCK# OPTIMIZED SIMD PIXEL COMPARISON (CONSISTENT LOGIC)
-// Contains the core pixel-matching algorithms, including the scalar and AVX2 versions.
+// #BLOCK# IMAGE RESAMPLING
+// Separable fixed-point scaling of pixel buffers, for templates and tolerance maps at each scale step.
 // =================================================================================================
 
-namespace PixelComparison {
+namespace Resample {
+
+    static_assert(std::is_same_v<Pixel, COLORREF>, "Resample::Pixel must match COLORREF");
 
     /**
-     * @brief Performs a pixel-by-pixel comparison with tolerance (standard C++ version).
-     * @return True if all non-transparent pixels are within tolerance, false otherwise.
+     * @brief Scales an image to width x height with the given filter, entirely in memory.
+     * A horizontal pass turns every source row into 16-bit channel values of the target width, and
+     * a vertical pass blends those rows into each target row. Both run on the SIMD kernels of
+     * `kernels`; every level produces bit-identical output.
      */
-    bool CheckApproxMatch_Scalar(
-        const PixelBuffer& screen, const PixelBuffer& source,
-        int start_x, int start_y, COLORREF transparent_color, int tolerance) noexcept {
+    PixelBuffer Scale(const PixelBuffer& source, int width, int height, ResampleFilter filter, const KernelTable& kernels) {
+        PixelBuffer target;
+        target.width = width;
+        target.height = height;
+        target.pixels.resize(static_cast<size_t>(width) * height);
+        Scale(source.pixels.data(), source.width, source.height, target.pixels.data(), width, height, filter,
+            kernels.resample_row, kernels.blend_rows);
+        return target;
+    }
+}
+
+// =================================================================================================
+// #BLOCK# TEMPLATE ROTATION
+// Rotated variants of a template; TemplateCache keeps them across calls.
+// =================================================================================================
 
-        for (int y = 0; y < source.height; ++y) {
-            const COLORREF* source_row = &source.pixels[y * source.width];
-            const COLORREF* screen_row = &screen.pixels[(start_y + y) * screen.width + start_x];
+namespace Rotation {
 
-            for (int x = 0; x < source.width; ++x) {
-                COLORREF source_pixel = source_row[x];
-                if (source_pixel == transparent_color) continue;
+    // Upper bound on the variants of one template, so a tiny step cannot exhaust memory.
+    constexpr size_t kMaxVariants = 720;
 
-                COLORREF screen_pixel = screen_row[x];
+    /**
+     * @brief Enumerates the angles of a rotation range from an integer index, so that no float
+     * error accumulates. Ordered by distance from 0 degrees (ties: negative first), so searches
+     * that stop at the first match try the upright template first.
+     * @return The angles in degrees; {0} if the range is empty or the step is not positive.
+     */
+    std::vector<double> EnumerateAngles(double min_degrees, double max_degrees, double step_degrees) {
+        if (!(step_degrees > 0.0) || !(max_degrees >= min_degrees)) return { 0.0 };
+        const size_t count = std::min(kMaxVariants,
+            static_cast<size_t>(std::floor((max_degrees - min_degrees) / step_degrees + 1e-9)) + 1);
+
+        std::vector<double> angles;
+        angles.reserve(count);
+        for (size_t i = 0; i < count; ++i) angles.push_back(min_degrees + static_cast<double>(i) * step_degrees);
+        std::stable_sort(angles.begin(), angles.end(), [](double a, double b) { return std::abs(a) < std::abs(b); });
+        return angles;
+    }
 
-                // Compare each color channel (R, G, B) individually.
-                if (abs((int)GetRValue(source_pixel) - (int)GetRValue(screen_pixel)) > tolerance ||
-                    abs((int)GetGValue(source_pixel) - (int)GetGValue(screen_pixel)) > tolerance ||
-                    abs((int)GetBValue(source_pixel) - (int)GetBValue(screen_pixel)) > tolerance) {
-                    return false;
-                }
+    /**
+     * @brief Rotates an image counter-clockwise about its centre by nearest-neighbour sampling, which
+     * keeps every color exact for the tolerance test. The result is sized to the bounding box of
+     * the rotated image; pixels that fall outside the source are set to `fill`.
+     */
+    PixelBuffer Rotate(const PixelBuffer& source, double degrees, COLORREF fill) {
+        const double radians = degrees * (3.14159265358979323846 / 180.0);
+        const double c = std::cos(radians), s = std::sin(radians);
+
+        PixelBuffer rotated;
+        rotated.width = std::max(1, static_cast<int>(std::lround(std::abs(source.width * c) + std::abs(source.height * s))));
+        rotated.height = std::max(1, static_cast<int>(std::lround(std::abs(source.width * s) + std::abs(source.height * c))));
+        rotated.pixels.assign(static_cast<size_t>(rotated.width) * rotated.height, fill);
+
+        // Each destination pixel centre is rotated back into the source (y points down).
+        for (int y = 0; y < rotated.height; ++y) {
+            const double dy = y + 0.5 - rotated.height / 2.0;
+            for (int x = 0; x < rotated.width; ++x) {
+                const double dx = x + 0.5 - rotated.width / 2.0;
+                const int sx = static_cast<int>(std::floor(c * dx - s * dy + source.width / 2.0));
+                const int sy = static_cast<int>(std::floor(s * dx + c * dy + source.height / 2.0));
+                if (sx < 0 || sy < 0 || sx >= source.width || sy >= source.height) continue;
+                rotated.pixels[static_cast<size_t>(y) * rotated.width + x] = source.pixels[static_cast<size_t>(sy) * source.width + sx];
             }
         }
-        return true;
+        return rotated;
     }
 
     /**
-     * @brief Performs a pixel-by-pixel comparison with tolerance (AVX2 optimized version).
-     * This function's logic is designed to be mathematically equivalent to the scalar version.
-     * @return True if all non-transparent pixels are within tolerance, false otherwise.
+     * @struct Variant
+     * @brief One rotated copy of a template and of its tolerance map.
      */
-    bool CheckApproxMatch_AVX2(
-        const PixelBuffer& screen, const PixelBuffer& source,
-        int start_x, int start_y, COLORREF transparent_color, int tolerance) noexcept {
-
-        const __m256i v_transparent = _mm256_set1_epi32(static_cast<int>(transparent_color));
-        const __m256i v_rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+    struct Variant {
+        double angle;
+        PixelBuffer image;
+        std::optional<PixelBuffer> tolerance_map;
+    };
 
-        for (int y = 0; y < source.height; ++y) {
-            const COLORREF* source_row = &source.pixels[y * source.width];
-            const COLORREF* screen_row = &screen.pixels[(start_y + y) * screen.width + start_x];
+    using VariantSet = std::vector<Variant>;
 
-            int x = 0;
-            // Process 8 pixels (256 bits) at a time.
-            for (; x + 7 < source.width; x += 8) {
-                __m256i v_source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source_row + x));
+    /**
+     * @brief Rotates a template and its tolerance map to every angle, in the order of `angles`.
+     * Pixels uncovered by a rotation become `transparent_color`, and 0 in the tolerance map.
+     */
+    VariantSet BuildVariants(
+        const PixelBuffer& source, const PixelBuffer* tolerance_map, COLORREF transparent_color, const std::vector<double>& angles) {
+        VariantSet variants;
+        variants.reserve(angles.size());
+        for (double angle : angles) {
+            Variant variant{ angle, Rotate(source, angle, transparent_color), std::nullopt };
+            if (tolerance_map) variant.tolerance_map = Rotate(*tolerance_map, angle, 0);
+            variants.push_back(std::move(variant));
+        }
+        return variants;
+    }
+}
 
-                // Create a mask to identify which of the 8 pixels are transparent.
-                __m256i v_transparent_mask = _mm256_cmpeq_epi32(v_source, v_transparent);
+// =================================================================================================
+// #BLOCK# TEMPLATE CACHE
+// Decoded, scaled and rotated template buffers, kept across calls with LRU eviction under a memory cap.
+// =================================================================================================
 
-                // Optimization: If all 8 pixels are transparent, skip this chunk entirely.
-                if (_mm256_testc_si256(v_transparent_mask, _mm256_set1_epi32(-1))) {
-                    continue;
-                }
+namespace TemplateCache {
 
-                __m256i v_screen = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(screen_row + x));
+    // Default cap on the pixel memory held by the cache (see Store::SetCapacity).
+    constexpr size_t kDefaultCapacityBytes = 64ull << 20;
+    // Scales are keyed in thousandths, so float steps that differ only by rounding share an entry.
+    constexpr int kScaleUnits = 1000;
 
-                // Isolate only the RGB channels, ignoring the alpha channel.
-                __m256i v_source_rgb = _mm256_and_si256(v_source, v_rgb_mask);
-                __m256i v_screen_rgb = _mm256_and_si256(v_screen, v_rgb_mask);
+    /**
+     * @struct FileStamp
+     * @brief Identifies one version of a file: a rewritten file gets a new stamp and a new entry.
+     */
+    struct FileStamp {
+        uint64_t write_time = 0;
+        uint64_t size = 0;
+        auto operator<=>(const FileStamp&) const = default;
+    };
 
-                // Calculate the absolute difference for each byte (each R, G, B channel) between source and screen.
-                // _mm256_subs_epu8(a, b) calculates saturation subtraction for unsigned bytes: max(0, a - b)
-                // We calculate diff in both directions and OR them to get the absolute difference.
-                __m256i v_diff1 = _mm256_subs_epu8(v_source_rgb, v_screen_rgb);
-                __m256i v_diff2 = _mm256_subs_epu8(v_screen_rgb, v_source_rgb);
-                __m256i v_abs_diff = _mm256_or_si256(v_diff1, v_diff2);
+    /**
+     * @struct Key
+     * @brief A template file (and its tolerance map) at one quantized scale and filter, and for a
+     * set of rotated variants, the angles and the fill of the uncovered pixels.
+     */
+    struct Key {
+        std::wstring path;
+        FileStamp file;
+        FileStamp map;
+        int scale_units = kScaleUnits;
+        ResampleFilter filter = ResampleFilter::Area;
+        // Empty unless the entry holds rotated variants.
+        std::vector<double> angles;
+        COLORREF rotation_fill = 0;
+        auto operator<=>(const Key&) const = default;
+    };
 
-                // Create a tolerance vector where each byte is the tolerance value.
-                const __m256i v_tolerance8 = _mm256_set1_epi8(static_cast<char>(tolerance));
+    /**
+     * @struct Prepared
+     * @brief The pixels a search reads for one key: a template and its tolerance map, or the
+     * rotated variants of one (see Rotated).
+     */
+    struct Prepared {
+        Key key;
+        PixelBuffer image;
+        std::optional<PixelBuffer> tolerance_map;
+        Rotation::VariantSet variants;
+
+        size_t Bytes() const noexcept {
+            size_t pixels = image.pixels.size() + (tolerance_map ? tolerance_map->pixels.size() : 0);
+            for (const Rotation::Variant& variant : variants) {
+                pixels += variant.image.pixels.size() + (variant.tolerance_map ? variant.tolerance_map->pixels.size() : 0);
+            }
+            return pixels * sizeof(COLORREF);
+        }
+    };
 
-                // Compare if any channel's absolute difference is greater than the tolerance.
-                // _mm256_cmpgt_epi8 is a signed comparison, so we must handle this carefully.
-                // A simpler way is to subtract tolerance from the difference. If the result is > 0, it failed.
-                // Or, subtract difference from tolerance. If it underflows (becomes non-zero), it failed.
-                __m256i v_check = _mm256_subs_epu8(v_abs_diff, v_tolerance8);
+    /**
+     * @class Store
+     * @brief Thread-safe LRU map from Key to Prepared, bounded by the total size of the pixel data.
+     * Entries are shared, so evicting one never invalidates a buffer a search is still reading.
+     */
+    class Store {
+    public:
+        std::shared_ptr<const Prepared> Find(const Key& key) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(key);
+            if (it == index_.end()) return nullptr;
+            order_.splice(order_.begin(), order_, it->second);
+            return *it->second;
+        }
 
-                // v_check will have non-zero bytes where diff > tolerance. We need to see if any of these
-                // non-zero bytes correspond to non-transparent pixels.
-                __m256i v_mismatch = _mm256_andnot_si256(v_transparent_mask, v_check);
+        /**
+         * @brief Adds an entry as the most recently used one. Entries larger than the whole cap are
+         * not kept; a concurrent insert of the same key keeps the first one.
+         */
+        void Insert(std::shared_ptr<const Prepared> entry) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (entry->Bytes() > capacity_ || index_.count(entry->key)) return;
+            bytes_ += entry->Bytes();
+            order_.push_front(std::move(entry));
+            index_.emplace(order_.front()->key, order_.begin());
+            EvictTo(capacity_);
+        }
 
-                // If there is any mismatch in any of the non-transparent pixels, the test fails.
-                if (!_mm256_testz_si256(v_mismatch, v_mismatch)) {
-                    return false;
+        /**
+         * @brief Returns the entry for `key`, calling make() to create and insert it on a miss.
+         * Concurrent misses for one key wait for the first caller's make() instead of repeating it.
+         * @param hits Incremented when the entry was cached or created by another caller.
+         */
+        template <class Make>
+        std::shared_ptr<const Prepared> FindOrCreate(const Key& key, Make&& make, size_t& hits) {
+            std::promise<std::shared_ptr<const Prepared>> promise;
+            std::shared_future<std::shared_ptr<const Prepared>> pending;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (auto it = index_.find(key); it != index_.end()) {
+                    order_.splice(order_.begin(), order_, it->second);
+                    ++hits;
+                    return *it->second;
                 }
+                if (auto it = pending_.find(key); it != pending_.end()) pending = it->second;
+                else pending_.emplace(key, promise.get_future().share());
+            }
+            if (pending.valid()) {
+                std::shared_ptr<const Prepared> entry = pending.get();
+                if (entry) ++hits;
+                return entry;
             }
 
-            // Handle any remaining pixels (less than 8) with the scalar code.
-            for (; x < source.width; ++x) {
-                COLORREF source_pixel = source_row[x];
-                if (source_pixel == transparent_color) continue;
-                COLORREF screen_pixel = screen_row[x];
-                if (abs((int)GetRValue(source_pixel) - (int)GetRValue(screen_pixel)) > tolerance ||
-                    abs((int)GetGValue(source_pixel) - (int)GetGValue(screen_pixel)) > tolerance ||
-                    abs((int)GetBValue(source_pixel) - (int)GetBValue(screen_pixel)) > tolerance) {
-                    return false;
-                }
+            std::shared_ptr<const Prepared> entry;
+            try {
+                entry = make();
+            }
+            catch (...) {
+                promise.set_exception(std::current_exception());
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_.erase(key);
+                throw;
+            }
+            if (entry) Insert(entry);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_.erase(key);
+            }
+            promise.set_value(entry);
+            return entry;
+        }
+
+        /**
+         * @brief Sets the memory cap, evicting least recently used entries to meet it. 0 disables caching.
+         */
+        void SetCapacity(size_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            capacity_ = bytes;
+            EvictTo(capacity_);
+        }
+
+    private:
+        void EvictTo(size_t bytes) {
+            while (bytes_ > bytes && !order_.empty()) {
+                bytes_ -= order_.back()->Bytes();
+                index_.erase(order_.back()->key);
+                order_.pop_back();
             }
         }
-        return true;
+
+        std::mutex mutex_;
+        // Most recently used first.
+        std::list<std::shared_ptr<const Prepared>> order_;
+        std::map<Key, std::list<std::shared_ptr<const Prepared>>::iterator> index_;
+        // Entries being created by FindOrCreate.
+        std::map<Key, std::shared_future<std::shared_ptr<const Prepared>>> pending_;
+        size_t bytes_ = 0;
+        size_t capacity_ = kDefaultCapacityBytes;
+    };
+
+    /**
+     * @brief The process-wide cache.
+     */
+    Store& Instance() {
+        static Store store;
+        return store;
+    }
+
+    /**
+     * @return The stamp of a file, or std::nullopt if it does not exist.
+     */
+    std::optional<FileStamp> StampOf(const std::wstring& path) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) return std::nullopt;
+        return FileStamp{ (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime,
+            (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow };
+    }
+
+    /**
+     * @brief Returns the decoded template file and its tolerance map at scale 1, from the cache if
+     * neither file changed since it was stored.
+     * @param hits Incremented when the entry comes from the cache.
+     * @return nullptr if the file does not exist or cannot be decoded.
+     */
+    std::shared_ptr<const Prepared> Load(std::wstring_view file_path, size_t& hits) {
+        Key key;
+        key.path = file_path;
+        const std::optional<FileStamp> file = StampOf(key.path);
+        if (!file) return nullptr;
+        key.file = *file;
+        key.map = StampOf(ToleranceMapPath(file_path)).value_or(FileStamp{});
+
+        if (auto cached = Instance().Find(key)) {
+            ++hits;
+            return cached;
+        }
+
+        HBITMAP hBitmap = LoadImageFromFile(file_path);
+        if (!hBitmap) return nullptr;
+        HBITMAP hToleranceMap = LoadToleranceMap(file_path);
+        auto image = GetBitmapPixels(hBitmap);
+        auto tolerance_map = GetBitmapPixels(hToleranceMap);
+        DeleteObject(hBitmap);
+        if (hToleranceMap) DeleteObject(hToleranceMap);
+        if (!image) return nullptr;
+
+        auto entry = std::make_shared<const Prepared>(Prepared{ std::move(key), std::move(*image), std::move(tolerance_map) });
+        Instance().Insert(entry);
+        return entry;
+    }
+
+    /**
+     * @brief Returns a template from Load resized to `scale` (quantized to 1/kScaleUnits), from the
+     * cache if it was prepared before.
+     * @param hits Incremented when the entry comes from the cache.
+     * @return nullptr if the scaled size would be empty.
+     */
+    std::shared_ptr<const Prepared> Scaled(const std::shared_ptr<const Prepared>& original, double scale,
+        ResampleFilter filter, const KernelTable& kernels, size_t& hits) {
+
+        const int units = static_cast<int>(std::lround(scale * kScaleUnits));
+        if (units == kScaleUnits) return original;
+        const int width = static_cast<int>(std::lround(original->image.width * static_cast<double>(units) / kScaleUnits));
+        const int height = static_cast<int>(std::lround(original->image.height * static_cast<double>(units) / kScaleUnits));
+        if (width <= 0 || height <= 0) return nullptr;
+
+        Key key = original->key;
+        key.scale_units = units;
+        key.filter = filter;
+        if (auto cached = Instance().Find(key)) {
+            ++hits;
+            return cached;
+        }
+
+        Prepared prepared{ std::move(key), Resample::Scale(original->image, width, height, filter, kernels), std::nullopt };
+        if (original->tolerance_map) prepared.tolerance_map = Resample::Scale(*original->tolerance_map, width, height, filter, kernels);
+        auto entry = std::make_shared<const Prepared>(std::move(prepared));
+        Instance().Insert(entry);
+        return entry;
+    }
+
+    /**
+     * @brief Returns the rotated variants of a template from Load or Scaled, in the order of
+     * `angles`, from the cache if they were built before (see Rotation::BuildVariants). A set
+     * counts its pixels against the same memory cap as every other entry.
+     * @param hits Incremented when the set comes from the cache.
+     */
+    std::shared_ptr<const Rotation::VariantSet> Rotated(const std::shared_ptr<const Prepared>& prepared,
+        COLORREF transparent_color, const std::vector<double>& angles, size_t& hits) {
+
+        Key key = prepared->key;
+        key.angles = angles;
+        key.rotation_fill = transparent_color;
+        auto entry = Instance().FindOrCreate(key, [&] {
+            Prepared rotated{ key, {}, std::nullopt, Rotation::BuildVariants(prepared->image,
+                prepared->tolerance_map ? &*prepared->tolerance_map : nullptr, transparent_color, angles) };
+            return std::make_shared<const Prepared>(std::move(rotated));
+        }, hits);
+        return std::shared_ptr<const Rotation::VariantSet>(entry, &entry->variants);
     }
 }
 
 // =================================================================================================
-// #BLOCK# CORE SEARCH ENGINE
-// The main logic that orchestrates the search process.
+// #BLOCK# SCALE ESTIMATION
+// Coarse-to-fine selection of the scale step to search, from a cheap best-score estimate.
 // =================================================================================================
 
-/**
- * @brief Scans a screen buffer for a source image buffer.
- * @return A vector of MatchResult structs for all found occurrences.
- */
-std::vector<MatchResult> SearchForBitmap(
-    const PixelBuffer& screen_buffer, const PixelBuffer& source_buffer,
-    int search_left, int search_top, int tolerance, COLORREF transparent_color,
-    bool find_all) {
+namespace ScaleEstimate {
 
-    std::vector<MatchResult> matches;
-    if (source_buffer.width > screen_buffer.width || source_buffer.height > screen_buffer.height) {
-        return matches;
-    }
+    // Evenly spaced steps (both ends included) scored before the bisection starts.
+    constexpr int kCoarseSamples = 5;
+    // Best-estimated steps searched in full, in estimate order, until one of them matches.
+    constexpr size_t kMaxFullScans = 3;
+    // Templates whose 2x-downsampled copy would be smaller than this in either dimension are
+    // estimated at full resolution.
+    constexpr int kMinHalvedSize = 8;
 
-    const int max_x = screen_buffer.width - source_buffer.width;
-    const int max_y = screen_buffer.height - source_buffer.height;
+    /**
+     * @brief Number of steps min_scale + i * step that lie within [min_scale, max_scale].
+     * Enumerating scales from this index keeps every step exact, where a running float sum drifts
+     * and can drop or add the last step.
+     */
+    int CountSteps(double min_scale, double max_scale, double step) {
+        // The slack absorbs float input such as 0.8f..1.2f in steps of 0.1f.
+        return static_cast<int>(std::floor((max_scale - min_scale) / step + 1e-4)) + 1;
+    }
 
-    // Iterate through every possible top-left starting position in the screen buffer.
-    for (int y = 0; y <= max_y; ++y) {
-        for (int x = 0; x <= max_x; ++x) {
-            bool found = false;
-            // Dispatch to the appropriate comparison function based on CPU support.
-            if (g_is_avx2_supported) {
-                found = PixelComparison::CheckApproxMatch_AVX2(screen_buffer, source_buffer, x, y, transparent_color, tolerance);
-            }
-            else {
-                found = PixelComparison::CheckApproxMatch_Scalar(screen_buffer, source_buffer, x, y, transparent_color, tolerance);
+    /**
+     * @brief Halves a template with the 2x2 block means of Pyramid::BuildPhases. A block holding a
+     * transparent pixel becomes transparent, so it never scores against the screen.
+     */
+    PixelBuffer Halve(const PixelBuffer& image, COLORREF transparent_color) {
+        PixelBuffer half = std::move(Pyramid::BuildPhases(image, 2)[0]);
+        for (int y = 0; y < half.height; ++y) {
+            for (int x = 0; x < half.width; ++x) {
+                const COLORREF* block = &image.pixels[static_cast<size_t>(2 * y) * image.width + 2 * x];
+                if (block[0] == transparent_color || block[1] == transparent_color ||
+                    block[image.width] == transparent_color || block[image.width + 1] == transparent_color) {
+                    half.pixels[static_cast<size_t>(y) * half.width + x] = transparent_color;
+                }
             }
+        }
+        return half;
+    }
 
-            if (found) {
-                matches.push_back({ search_left + x, search_top + y, source_buffer.width, source_buffer.height });
-                if (!find_all) return matches; // Optimization: if only one is needed, exit immediately.
+    /**
+     * @brief Cheap fitness of one scale step: the best sum of absolute differences of the template
+     * anywhere on the screen, per opaque template pixel (lower is better). Unless the template is
+     * too small, both are compared at half resolution: the halved template against all four
+     * sampling phases of the screen's 2x level (from its ScreenCache), so a match at an odd offset
+     * is not penalized. That is a quarter of the full-resolution work.
+     * @return +infinity if the template has no opaque pixel or does not fit the screen.
+     */
+    double Fitness(ScreenCache& screen_cache, const PixelBuffer& image, COLORREF transparent_color, const SearchOptions& options) {
+        const bool halve = image.width >= 2 * kMinHalvedSize && image.height >= 2 * kMinHalvedSize;
+        const PixelBuffer half = halve ? Halve(image, transparent_color) : PixelBuffer{};
+        const PixelBuffer& source = halve ? half : image;
+
+        const size_t opaque = static_cast<size_t>(std::count_if(source.pixels.begin(), source.pixels.end(),
+            [&](COLORREF pixel) { return pixel != transparent_color; }));
+        if (opaque == 0) return std::numeric_limits<double>::infinity();
+
+        // Plain SAD (tolerance 0) separates neighbouring scales better than the in-tolerance score.
+        SearchOptions estimate_options = options;
+        estimate_options.window_stats = WindowStatsMode::Off;
+        estimate_options.max_score = UINT64_MAX;
+        uint64_t best_score = UINT64_MAX;
+        auto score = [&](const PixelBuffer& screen) {
+            const std::vector<MatchResult> best = SearchBestScores(screen, source, 0, 0, 0, transparent_color, 1, estimate_options);
+            if (!best.empty()) best_score = std::min(best_score, best.front().score);
+        };
+        if (halve) {
+            for (const PixelBuffer& phase : screen_cache.PyramidPhases(1)) score(phase);
+        }
+        else {
+            score(screen_cache.Screen());
+        }
+        return best_score == UINT64_MAX ? std::numeric_limits<double>::infinity() : static_cast<double>(best_score) / opaque;
+    }
+
+    /**
+     * @brief Coarse-to-fine search for the step index in [0, count) with the lowest cost.
+     * kCoarseSamples evenly spaced indices are scored first. Then the neighbours of the best index
+     * at half the previous spacing (rounded up) are scored, moving to whichever of the three is
+     * best, until the spacing is 1. Each index is scored at most once, about
+     * kCoarseSamples + 2 * log2(count / kCoarseSamples) of them in total.
+     * @return Every scored index, lowest cost first (ties keep the lower index).
+     */
+    template <class Cost>
+    std::vector<int> Refine(int count, Cost&& cost) {
+        std::map<int, double> costs;
+        auto score = [&](int index) {
+            auto it = costs.find(index);
+            if (it == costs.end()) it = costs.emplace(index, cost(index)).first;
+            return it->second;
+        };
+
+        const int samples = std::clamp(count, 1, kCoarseSamples);
+        int best = 0;
+        for (int k = 0; k < samples; ++k) {
+            const int index = samples > 1 ? static_cast<int>(static_cast<int64_t>(k) * (count - 1) / (samples - 1)) : 0;
+            if (score(index) < score(best)) best = index;
+        }
+        int spacing = samples > 1 ? (count - 1 + samples - 2) / (samples - 1) : 1;
+        while (spacing > 1) {
+            spacing = (spacing + 1) / 2;
+            const int center = best;
+            for (int index : { center - spacing, center + spacing }) {
+                if (index >= 0 && index < count && score(index) < score(best)) best = index;
             }
         }
+
+        std::vector<int> order;
+        order.reserve(costs.size());
+        for (const auto& entry : costs) order.push_back(entry.first);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] < costs[b]; });
+        return order;
     }
-    return matches;
 }
 
 // =================================================================================================
@@ -480,16 +869,198 @@ std::vector<MatchResult> SearchForBitmap(
 // The public-facing function that will be called by external applications.
 // =================================================================================================
 
-extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
+/**
+ * @brief Parses the options string of ImageSearchEx into a SearchOptions struct.
+ * The string is a list of "key=value" pairs separated by ';'. Keys are case-insensitive, unknown
+ * keys and malformed values are ignored so that older DLLs and newer scripts stay compatible.
+ *   strategy = auto | percandidate | vectorized | exact | solid
+ *   pyramid  = 0 | 1 | 2
+ *   threads  = 0 (one per core) | N
+ *   isa      = scalar | sse2 | sse41 | avx2 | avx512
+ *   stats    = off | mean | variance
+ *   mode     = tolerance | score | ncc
+ *   maxscore = N (score mode: worst score still reported)
+ *   mismatch = N | N% (tolerance mode: opaque pixels allowed out of tolerance)
+ *   threshold = 0.0 - 1.0 (ncc mode: lowest correlation reported)
+ *   overlap  = all | distinct | nms | none
+ *   iou      = 0.0 - 1.0 (overlap=nms: largest overlap kept)
+ *   color    = rgb | luma | gradient (tolerance mode: what the tolerance applies to)
+ *   layout   = interleaved | planar (tolerance mode: screen representation of the scan)
+ *   rotate   = MIN:MAX[:STEP] (degrees counter-clockwise; STEP defaults to 5)
+ *   resample = area | bilinear (filter of the scale steps)
+ *   cache    = MB (memory cap of the decoded, scaled and rotated template cache; 0 = off)
+ *   scaling  = auto | template | screen (what the scale steps resize)
+ *   scalesearch = linear | refine (search every scale step, or only the best estimated ones)
+ *   scaleorder = ascending | nearest (preference order of the scale steps)
+ */
+SearchOptions ParseSearchOptions(std::wstring_view options_str) {
+    SearchOptions options;
+
+    auto trim = [](std::wstring_view v) {
+        size_t b = v.find_first_not_of(L" \t");
+        size_t e = v.find_last_not_of(L" \t");
+        return b == std::wstring_view::npos ? std::wstring_view{} : v.substr(b, e - b + 1);
+    };
+    auto lower = [](std::wstring_view v) {
+        std::wstring out(v);
+        for (wchar_t& c : out) c = static_cast<wchar_t>(towlower(c));
+        return out;
+    };
+
+    while (!options_str.empty()) {
+        size_t sep = options_str.find(L';');
+        std::wstring_view pair = options_str.substr(0, sep);
+        options_str = sep == std::wstring_view::npos ? std::wstring_view{} : options_str.substr(sep + 1);
+
+        size_t eq = pair.find(L'=');
+        if (eq == std::wstring_view::npos) continue;
+        const std::wstring key = lower(trim(pair.substr(0, eq)));
+        const std::wstring value = lower(trim(pair.substr(eq + 1)));
+        if (value.empty()) continue;
+
+        if (key == L"strategy") {
+            if (value == L"auto") options.strategy = SearchStrategy::Auto;
+            else if (value == L"percandidate") options.strategy = SearchStrategy::PerCandidate;
+            else if (value == L"vectorized") options.strategy = SearchStrategy::CandidateVectorized;
+            else if (value == L"exact") options.strategy = SearchStrategy::ExactHash;
+            else if (value == L"solid") options.strategy = SearchStrategy::SolidRun;
+        }
+        else if (key == L"pyramid") {
+            options.pyramid_levels = std::clamp(_wtoi(value.c_str()), 0, Pyramid::kMaxLevels);
+        }
+        else if (key == L"threads") {
+            options.threads = std::max(0, _wtoi(value.c_str()));
+        }
+        else if (key == L"isa") {
+            if (auto level = ParseSimdLevel(value)) options.simd_level = level;
+        }
+        else if (key == L"stats") {
+            if (value == L"off") options.window_stats = WindowStatsMode::Off;
+            else if (value == L"mean") options.window_stats = WindowStatsMode::Mean;
+            else if (value == L"variance") options.window_stats = WindowStatsMode::MeanVariance;
+        }
+        else if (key == L"mode") {
+            if (value == L"tolerance") options.match_mode = MatchMode::Tolerance;
+            else if (value == L"score") options.match_mode = MatchMode::BestScore;
+            else if (value == L"ncc") options.match_mode = MatchMode::Correlation;
+        }
+        else if (key == L"color") {
+            if (value == L"rgb") options.color_space = ColorSpace::Rgb;
+            else if (value == L"luma") options.color_space = ColorSpace::Luma;
+            else if (value == L"gradient") options.color_space = ColorSpace::Gradient;
+        }
+        else if (key == L"layout") {
+            if (value == L"interleaved") options.layout = PixelLayout::Interleaved;
+            else if (value == L"planar") options.layout = PixelLayout::Planar;
+        }
+        else if (key == L"maxscore") {
+            if (value.find_first_not_of(L"0123456789") == std::wstring::npos) options.max_score = std::wcstoull(value.c_str(), nullptr, 10);
+        }
+        else if (key == L"overlap") {
+            if (value == L"all") options.overlap = OverlapPolicy::All;
+            else if (value == L"distinct") options.overlap = OverlapPolicy::Distinct;
+            else if (value == L"nms") options.overlap = OverlapPolicy::Suppress;
+            else if (value == L"none") options.overlap = OverlapPolicy::NoOverlap;
+        }
+        else if (key == L"iou") {
+            if (!value.empty()) options.overlap_iou = std::clamp(std::wcstod(value.c_str(), nullptr), 0.0, 1.0);
+        }
+        else if (key == L"threshold") {
+            if (!value.empty()) options.correlation_threshold = std::clamp(std::wcstod(value.c_str(), nullptr), 0.0, 1.0);
+        }
+        else if (key == L"rotate") {
+            // "rotate=-30:30:5"; a missing or malformed field leaves the rotation disabled.
+            std::array<double, 3> fields{ 0.0, 0.0, 5.0 };
+            size_t field = 0;
+            const wchar_t* cursor = value.c_str();
+            while (field < fields.size()) {
+                wchar_t* end = nullptr;
+                fields[field] = std::wcstod(cursor, &end);
+                if (end == cursor) break;
+                ++field;
+                if (*end != L':') break;
+                cursor = end + 1;
+            }
+            if (field >= 2 && fields[0] <= fields[1] && fields[2] > 0.0) {
+                options.rotation_min = fields[0];
+                options.rotation_max = fields[1];
+                options.rotation_step = fields[2];
+            }
+        }
+        else if (key == L"resample") {
+            if (value == L"area") options.resample = ResampleFilter::Area;
+            else if (value == L"bilinear") options.resample = ResampleFilter::Bilinear;
+        }
+        else if (key == L"scaling") {
+            if (value == L"auto") options.scale_strategy = ScaleStrategy::Auto;
+            else if (value == L"template") options.scale_strategy = ScaleStrategy::Template;
+            else if (value == L"screen") options.scale_strategy = ScaleStrategy::Screen;
+        }
+        else if (key == L"scalesearch") {
+            if (value == L"linear") options.scale_search = ScaleSearch::Linear;
+            else if (value == L"refine") options.scale_search = ScaleSearch::Refine;
+        }
+        else if (key == L"scaleorder") {
+            if (value == L"ascending") options.scale_order = ScaleOrder::Ascending;
+            else if (value == L"nearest") options.scale_order = ScaleOrder::Nearest;
+        }
+        else if (key == L"cache") {
+            // Computed in 64 bits: 4096 MB does not fit the 32-bit size_t of the x86 build.
+            const uint64_t bytes = static_cast<uint64_t>(std::clamp(_wtoi(value.c_str()), 0, 4096)) << 20;
+            options.template_cache_bytes = static_cast<size_t>(std::min<uint64_t>(bytes, SIZE_MAX));
+        }
+        else if (key == L"mismatch") {
+            // "mismatch=N" allows N pixels, "mismatch=N%" allows N percent of the opaque pixels.
+            if (!value.empty() && value.back() == L'%') {
+                options.mismatch_fraction = std::clamp(std::wcstod(value.c_str(), nullptr), 0.0, 100.0) / 100.0;
+            }
+            else {
+                options.mismatch_count = std::max(0, _wtoi(value.c_str()));
+            }
+        }
+    }
+    return options;
+}
+
+/**
+ * @struct ScaledScreen
+ * @brief One level of the capture's scale space (ScaleStrategy::Screen), with its own per-call data.
+ */
+struct ScaledScreen {
+    explicit ScaledScreen(PixelBuffer pixels, const PixelBuffer& capture)
+        : screen(std::move(pixels)), cache(screen),
+          ratio_x(static_cast<double>(capture.width) / screen.width),
+          ratio_y(static_cast<double>(capture.height) / screen.height) {}
+
+    PixelBuffer screen;
+    ScreenCache cache;
+    // Capture pixels per level pixel along each axis.
+    double ratio_x, ratio_y;
+
+    /**
+     * @brief Maps a match found at level coordinates (relative to the capture) to screen coordinates.
+     */
+    void MapToCapture(MatchResult& match, int capture_left, int capture_top) const noexcept {
+        const int right = static_cast<int>(std::lround((match.x + match.w) * ratio_x));
+        const int bottom = static_cast<int>(std::lround((match.y + match.h) * ratio_y));
+        match.x = static_cast<int>(std::lround(match.x * ratio_x));
+        match.y = static_cast<int>(std::lround(match.y * ratio_y));
+        match.w = right - match.x;
+        match.h = bottom - match.y;
+        match.x += capture_left;
+        match.y += capture_top;
+    }
+};
+
+/**
+ * @brief Shared implementation of the ImageSearch and ImageSearchEx exports.
+ */
+const wchar_t* RunImageSearch(
     const wchar_t* sImageFile,
-    int iLeft = 0, int iTop = 0, int iRight = 0, int iBottom = 0,
-    int iTolerance = 10,
-    int iTransparent = 0xFFFFFFFF,
-    int iMultiResults = 0,
-    int iCenterPOS = 1,
-    int iReturnDebug = 0,
-    float fMinScale = 1.0f, float fMaxScale = 1.0f, float fScaleStep = 0.1f,
-    int iFindAllOccurrences = 0
+    int iLeft, int iTop, int iRight, int iBottom,
+    int iTolerance, int iTransparent, int iMultiResults, int iCenterPOS, int iReturnDebug,
+    float fMinScale, float fMaxScale, float fScaleStep,
+    int iFindAllOccurrences, const SearchOptions& options
 ) {
     // Use a large, thread-local static buffer. This is the simplest and most stable way
     // to return a string to AutoIt. It's safe because the memory persists for the call.
@@ -537,54 +1108,222 @@ extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
         return g_szAnswer;
     }
     const PixelBuffer& screen_buffer = *screen_pixels_opt;
+    ScreenCache screen_cache(screen_buffer);
+    SearchStats stats;
 
     // --- 3. Multi-Image & Multi-Scale Search Loop ---
+    // Score mode keeps the best iMultiResults positions (at least one) across every file and scale.
+    // Correlation mode likewise ranks the peaks of every file and scale, best first.
+    const bool scoring = options.match_mode == MatchMode::BestScore;
+    const bool correlating = options.match_mode == MatchMode::Correlation;
+    const bool ranked = scoring || correlating;
+    // Plain find-all searches stop as soon as iMultiResults matches are found across every file and
+    // scale. Ranked modes and overlap filters need the complete set before they can pick from it.
+    const bool limited = iMultiResults > 0 && !ranked && options.overlap == OverlapPolicy::All;
+    ResultLimit result_limit(limited ? static_cast<size_t>(iMultiResults) : SIZE_MAX);
+    const size_t best_count = iMultiResults > 0 ? static_cast<size_t>(iMultiResults) : 1;
+    const KernelTable& kernels = GetKernelTable(options.simd_level);
+    if (options.template_cache_bytes) TemplateCache::Instance().SetCapacity(*options.template_cache_bytes);
+    const bool rotating = options.rotation_step > 0.0;
+    const std::vector<double> angles = Rotation::EnumerateAngles(options.rotation_min, options.rotation_max, options.rotation_step);
     std::vector<MatchResult> all_matches;
-    std::wstring file_list_str(sImageFile);
-    std::wstringstream file_stream(file_list_str);
-    std::wstring file_path;
 
     // Split the input string by '|' to search for multiple files.
-    while (std::getline(file_stream, file_path, L'|')) {
-        if (file_path.empty()) continue;
-
-        HBITMAP hBitmapOrig = LoadImageFromFile(file_path);
-        if (!hBitmapOrig) continue;
-
-        // Loop through the specified scale range.
-        for (float scale = fMinScale; scale <= fMaxScale; scale += fScaleStep) {
-            HBITMAP hBitmapToSearch = hBitmapOrig;
-            bool scaled = false;
-            if (scale != 1.0f) {
-                BITMAP bm;
-                GetObject(hBitmapOrig, sizeof(bm), &bm);
-                int newW = static_cast<int>(round(bm.bmWidth * scale));
-                int newH = static_cast<int>(round(bm.bmHeight * scale));
-                if (newW > 0 && newH > 0) {
-                    hBitmapToSearch = ScaleBitmap(hBitmapOrig, newW, newH);
-                    scaled = true;
-                }
-                else {
-                    continue; // Skip invalid scales.
-                }
+    std::vector<std::wstring> file_paths;
+    std::wstringstream file_stream{ std::wstring(sImageFile) };
+    for (std::wstring file_path; std::getline(file_stream, file_path, L'|');) {
+        if (!file_path.empty()) file_paths.push_back(std::move(file_path));
+    }
+
+    // With many files, resizing the capture once per scale beats resizing every file per scale.
+    // Levels are built on first use, by whichever step needs them first, and shared by every file.
+    const bool scale_screen = options.scale_strategy == ScaleStrategy::Screen ||
+        (options.scale_strategy == ScaleStrategy::Auto && file_paths.size() >= kScreenScaleMinTemplates);
+    struct ScreenLevelSlot {
+        std::once_flag once;
+        std::unique_ptr<ScaledScreen> level;
+    };
+    std::map<int, ScreenLevelSlot> screen_levels;
+    std::mutex screen_levels_mutex;
+    auto screen_level = [&](int scale_units) -> ScaledScreen* {
+        ScreenLevelSlot* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(screen_levels_mutex);
+            slot = &screen_levels[scale_units];
+        }
+        std::call_once(slot->once, [&] {
+            const int width = static_cast<int>(std::lround(screen_buffer.width * static_cast<double>(TemplateCache::kScaleUnits) / scale_units));
+            const int height = static_cast<int>(std::lround(screen_buffer.height * static_cast<double>(TemplateCache::kScaleUnits) / scale_units));
+            if (width <= 0 || height <= 0) return;
+            slot->level = std::make_unique<ScaledScreen>(Resample::Scale(screen_buffer, width, height, options.resample, kernels), screen_buffer);
+        });
+        return slot->level.get();
+    };
+
+    // Scale steps are enumerated from an integer index, so each one is exactly fMinScale + i * fScaleStep.
+    const int scale_steps = ScaleEstimate::CountSteps(fMinScale, fMaxScale, fScaleStep);
+    const bool refining = options.scale_search == ScaleSearch::Refine && scale_steps > ScaleEstimate::kCoarseSamples;
+    auto scale_units_of = [&](int index) {
+        return static_cast<int>(std::lround((fMinScale + index * static_cast<double>(fScaleStep)) * TemplateCache::kScaleUnits));
+    };
+    // Preference order of the linear sweep. A first-match search reports the first step in this
+    // order that matches.
+    std::vector<int> scale_order(scale_steps);
+    for (int index = 0; index < scale_steps; ++index) scale_order[index] = index;
+    if (options.scale_order == ScaleOrder::Nearest) {
+        std::stable_sort(scale_order.begin(), scale_order.end(), [&](int a, int b) {
+            return std::abs(scale_units_of(a) - TemplateCache::kScaleUnits) < std::abs(scale_units_of(b) - TemplateCache::kScaleUnits);
+        });
+    }
+    // The linear sweep spreads its steps over the cores first; each step's own search gets the
+    // cores left over.
+    const int sweep_threads = std::min(ResolveThreadCount(options.threads), scale_steps);
+    SearchOptions step_options = options;
+    step_options.threads = std::max(1, ResolveThreadCount(options.threads) / sweep_threads);
+
+    for (const std::wstring& file_path : file_paths) {
+
+        // Decoded and scaled templates come from the process-wide cache, so a repeated call (e.g. a
+        // wait loop) goes straight to the search.
+        const std::shared_ptr<const TemplateCache::Prepared> original = TemplateCache::Load(file_path, stats.cached_templates);
+        if (!original) continue;
+
+        // Resolves scale step `index` to the template and capture searched at it; false for an invalid scale.
+        struct ScaleStep {
+            ScaledScreen* level = nullptr;
+            std::shared_ptr<const TemplateCache::Prepared> prepared;
+        };
+        auto prepare_step = [&](int index, ScaleStep& step, SearchStats& step_stats) -> bool {
+            const double scale = fMinScale + index * static_cast<double>(fScaleStep);
+            const int scale_units = scale_units_of(index);
+            step.level = nullptr;
+            step.prepared = original;
+            if (scale_screen && scale_units != TemplateCache::kScaleUnits) {
+                step.level = scale_units > 0 ? screen_level(scale_units) : nullptr;
+                return step.level != nullptr;
             }
+            step.prepared = TemplateCache::Scaled(original, scale, options.resample, kernels, step_stats.cached_templates);
+            return step.prepared != nullptr;
+        };
+
+        // Searches one scale step into `out`; returns true when this file needs no further scales.
+        // A cancelled `limit` also skips the remaining rotated variants.
+        auto search_step = [&](const ScaleStep& step, const SearchOptions& step_options, std::vector<MatchResult>& out,
+            SearchStats& step_stats, ResultLimit& limit) -> bool {
+            ScaledScreen* level = step.level;
+            const TemplateCache::Prepared& prepared = *step.prepared;
+            const PixelBuffer& search_screen = level ? level->screen : screen_buffer;
+            ScreenCache& search_cache = level ? level->cache : screen_cache;
+            const int search_left = level ? 0 : iLeft, search_top = level ? 0 : iTop;
+
+            const PixelBuffer* tolerance_map = prepared.tolerance_map ? &*prepared.tolerance_map : nullptr;
+            // Rotated variants come from the template cache and share search_cache, so each one
+            // costs a scan but no decoding, rotation or screen preprocessing.
+            std::shared_ptr<const Rotation::VariantSet> variants;
+            if (rotating) variants = TemplateCache::Rotated(step.prepared, RgbToBgr(iTransparent), angles, step_stats.cached_templates);
 
-            auto source_pixels_opt = GetBitmapPixels(hBitmapToSearch);
-            if (source_pixels_opt) {
-                auto matches = SearchForBitmap(screen_buffer, *source_pixels_opt, iLeft, iTop, iTolerance, RgbToBgr(iTransparent), iFindAllOccurrences != 0);
+            bool found = false;
+            const size_t variant_count = variants ? variants->size() : 1;
+            for (size_t v = 0; v < variant_count && !found && !limit.Stopped(); ++v) {
+                const Rotation::Variant* variant = variants ? &(*variants)[v] : nullptr;
+                const PixelBuffer& source = variant ? variant->image : prepared.image;
+                const PixelBuffer* map = !variant ? tolerance_map : variant->tolerance_map ? &*variant->tolerance_map : nullptr;
+
+                auto matches = scoring
+                    ? SearchBestScores(search_screen, source, search_left, search_top, iTolerance, RgbToBgr(iTransparent), best_count,
+                        step_options, map, &search_cache, &step_stats)
+                    : correlating
+                    ? SearchCorrelation(search_screen, source, search_left, search_top, RgbToBgr(iTransparent), iFindAllOccurrences != 0,
+                        step_options, &search_cache)
+                    : SearchForBitmap(search_screen, source, search_left, search_top, iTolerance, RgbToBgr(iTransparent), iFindAllOccurrences != 0,
+                        step_options, map, &search_cache, &step_stats, &limit);
+                if (level) {
+                    for (MatchResult& match : matches) level->MapToCapture(match, iLeft, iTop);
+                }
+                if (variant) {
+                    for (MatchResult& match : matches) match.angle = static_cast<float>(variant->angle);
+                }
                 if (!matches.empty()) {
-                    all_matches.insert(all_matches.end(), matches.begin(), matches.end());
-                    if (iFindAllOccurrences == 0) break; // Found for this image, move to next scale.
+                    out.insert(out.end(), matches.begin(), matches.end());
+                    // The refining search settles on the first step that matches in every mode.
+                    found = (iFindAllOccurrences == 0 && !ranked) || refining;
                 }
             }
+            return found;
+        };
+
+        if (refining) {
+            // Estimate every step cheaply at a few coarse points and refine by bisection, then search
+            // the best estimates in full, stopping at the first one that matches.
+            const std::vector<int> order = ScaleEstimate::Refine(scale_steps, [&](int index) {
+                ScaleStep step;
+                if (!prepare_step(index, step, stats)) return std::numeric_limits<double>::infinity();
+                ScreenCache& estimate_cache = step.level ? step.level->cache : screen_cache;
+                return ScaleEstimate::Fitness(estimate_cache, step.prepared->image, RgbToBgr(iTransparent), options);
+            });
+            for (size_t k = 0; k < order.size() && k < ScaleEstimate::kMaxFullScans && !result_limit.Reached(); ++k) {
+                ScaleStep step;
+                if (prepare_step(order[k], step, stats) && search_step(step, options, all_matches, stats, result_limit)) break;
+            }
+        }
+        else {
+            // The steps run as bands on the worker pool, claimed in preference order, and each one
+            // collects its own matches. Finished steps are merged strictly in that order, so the
+            // outcome, including what the shared result limit admits, is that of a serial sweep. A
+            // step that ends this file's search cancels every step ranked after it.
+            struct StepOutcome {
+                std::vector<MatchResult> matches;
+                SearchStats stats;
+                bool done = false;
+            };
+            std::vector<StepOutcome> outcomes(scale_order.size());
+            FirstHitToken first_hit;
+            std::mutex merge_mutex;
+            size_t merged = 0;
+            RunBands(scale_steps, sweep_threads, [&](int position) {
+                StepOutcome& outcome = outcomes[position];
+                if (!first_hit.Cancelled(position) && !result_limit.Reached()) {
+                    // Up to everything still unclaimed; the merge trims it to what is left by then.
+                    // The scanners poll the token once per row, so a hit ranked earlier stops this
+                    // step mid-scan.
+                    ResultLimit step_limit(result_limit.Remaining(), [&first_hit, position] { return first_hit.Cancelled(position); });
+                    ScaleStep step;
+                    if (prepare_step(scale_order[position], step, outcome.stats) &&
+                        search_step(step, step_options, outcome.matches, outcome.stats, step_limit)) {
+                        first_hit.Report(position);
+                    }
+                }
 
-            if (scaled) DeleteObject(hBitmapToSearch);
+                std::lock_guard<std::mutex> lock(merge_mutex);
+                outcome.done = true;
+                for (; merged < outcomes.size() && outcomes[merged].done; ++merged) {
+                    stats += outcomes[merged].stats;
+                    if (first_hit.Cancelled(static_cast<int>(merged))) continue;
+                    for (const MatchResult& match : outcomes[merged].matches) {
+                        if (!result_limit.Claim()) break;
+                        all_matches.push_back(match);
+                    }
+                }
+            });
         }
-        DeleteObject(hBitmapOrig);
         // If we are not finding all occurrences and we found at least one match for this file, stop searching other files.
-        if (iFindAllOccurrences == 0 && !all_matches.empty()) break;
+        if (iFindAllOccurrences == 0 && !ranked && !all_matches.empty()) break;
+        if (result_limit.Reached()) break;
     }
 
+    if (scoring) {
+        std::stable_sort(all_matches.begin(), all_matches.end(),
+            [](const MatchResult& a, const MatchResult& b) { return a.score < b.score; });
+    }
+    else if (correlating) {
+        std::stable_sort(all_matches.begin(), all_matches.end(),
+            [](const MatchResult& a, const MatchResult& b) { return a.correlation > b.correlation; });
+    }
+    // Overlaps between files and scales are only visible here; ranked results keep the better match.
+    ApplyOverlapPolicy(all_matches, options.overlap, options.overlap_iou);
+    if (scoring && all_matches.size() > best_count) all_matches.resize(best_count);
+    if (correlating && iFindAllOccurrences == 0 && all_matches.size() > 1) all_matches.resize(1);
+
     // --- 4. Format Results ---
     size_t match_count = all_matches.size();
     if (iMultiResults > 0 && match_count > (size_t)iMultiResults) {
@@ -602,6 +1341,9 @@ extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
                 y += all_matches[i].h / 2;
             }
             matches_stream << x << L"|" << y << L"|" << all_matches[i].w << L"|" << all_matches[i].h;
+            if (scoring) matches_stream << L"|" << all_matches[i].score;
+            if (correlating) matches_stream << L"|" << std::fixed << std::setprecision(4) << all_matches[i].correlation;
+            if (rotating) matches_stream << L"|" << std::defaultfloat << std::setprecision(6) << all_matches[i].angle;
         }
         result_stream << L"{" << match_count << L"}[" << matches_stream.str() << L"]";
     }
@@ -618,8 +1360,18 @@ extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
             << L", Multi=" << iMultiResults
             << L", Center=" << iCenterPOS
             << L", FindAll=" << iFindAllOccurrences
-            << L", AVX2=" << g_is_avx2_supported.load()
-            << L", Scale=(" << std::fixed << std::setprecision(2) << fMinScale << L"," << fMaxScale << L"," << fScaleStep << L")";
+            << L", AVX2=" << (g_detected_simd_level.load() >= SimdLevel::AVX2)
+            << L", ISA=" << GetSimdLevelName(GetKernelTable(options.simd_level).level)
+            << L", Threads=" << ResolveThreadCount(options.threads)
+            << L", Pyramid=" << options.pyramid_levels
+            << L", Verified=" << stats.verified_candidates
+            << L", Cached=" << stats.cached_templates
+            << L", Scale=(" << std::fixed << std::setprecision(2) << fMinScale << L"," << fMaxScale << L"," << fScaleStep << L")"
+            << L", Scaling=" << (scale_screen ? L"screen" : L"template");
+        if (rotating) {
+            result_stream << L", Rotate=(" << options.rotation_min << L"," << options.rotation_max << L"," << options.rotation_step
+                << L")x" << angles.size();
+        }
     }
 
     // --- 6. Final Copy to Static Buffer ---
@@ -635,6 +1387,42 @@ extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
     return g_szAnswer;
 }
 
+extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearch(
+    const wchar_t* sImageFile,
+    int iLeft = 0, int iTop = 0, int iRight = 0, int iBottom = 0,
+    int iTolerance = 10,
+    int iTransparent = 0xFFFFFFFF,
+    int iMultiResults = 0,
+    int iCenterPOS = 1,
+    int iReturnDebug = 0,
+    float fMinScale = 1.0f, float fMaxScale = 1.0f, float fScaleStep = 0.1f,
+    int iFindAllOccurrences = 0
+) {
+    return RunImageSearch(sImageFile, iLeft, iTop, iRight, iBottom, iTolerance, iTransparent, iMultiResults,
+        iCenterPOS, iReturnDebug, fMinScale, fMaxScale, fScaleStep, iFindAllOccurrences, SearchOptions{});
+}
+
+/**
+ * @brief Same as ImageSearch, with an extra options string that selects engine features.
+ * See ParseSearchOptions for the accepted keys. A null or empty string behaves like ImageSearch.
+ */
+extern "C" __declspec(dllexport) const wchar_t* WINAPI ImageSearchEx(
+    const wchar_t* sImageFile,
+    int iLeft = 0, int iTop = 0, int iRight = 0, int iBottom = 0,
+    int iTolerance = 10,
+    int iTransparent = 0xFFFFFFFF,
+    int iMultiResults = 0,
+    int iCenterPOS = 1,
+    int iReturnDebug = 0,
+    float fMinScale = 1.0f, float fMaxScale = 1.0f, float fScaleStep = 0.1f,
+    int iFindAllOccurrences = 0,
+    const wchar_t* sOptions = nullptr
+) {
+    return RunImageSearch(sImageFile, iLeft, iTop, iRight, iBottom, iTolerance, iTransparent, iMultiResults,
+        iCenterPOS, iReturnDebug, fMinScale, fMaxScale, fScaleStep, iFindAllOccurrences,
+        ParseSearchOptions(sOptions ? sOptions : L""));
+}
+
 /**
  * @brief DLL Entry Point. Manages process-wide initialization and cleanup.
  * @param hModule Handle to the DLL module.
@@ -18,6 +18,10 @@
 //    to process multi-image searches. This prevents thread exhaustion and ensures stable
 //    performance even with a large number of images.
 //
+//  - Parallel Scale Sweep: Every scale step of every image is its own pool task. The first step
+//    (smallest scale first) that matches cancels the image's later steps through an atomic token,
+//    so results do not depend on task timing.
+//
 //  - Fully Thread-Safe: The exported ImageSearch function is now fully thread-safe. Multiple
 //    threads can call it concurrently without data corruption, thanks to thread-local storage
 //    for result buffers.
@@ -65,6 +69,8 @@
 #include <queue>
 #include <functional>
 #include <condition_variable>
+#include <atomic>
+#include <climits>
 
 // Intrinsics Header for CPUID and SIMD
 #include <intrin.h>
@@ -174,6 +180,74 @@ struct ImageToSearch {
     LONG height = 0;
 };
 
+/**
+ * @struct SharedImage
+ * @brief One file of a search, shared by the tasks searching its scale steps.
+ * The bitmap is loaded by the first task that needs it and deleted with the struct. GDI cannot
+ * select one bitmap into two DCs at once, so reading and scaling it is serialized by gdi_mutex.
+ */
+struct SharedImage {
+    std::string file_path;
+    std::once_flag load_once;
+    HBITMAP bitmap = nullptr;
+    std::mutex gdi_mutex;
+    // Cancellation token: lowest scale position (in search order) that found a match. Steps after
+    // it cannot be reported, so they are skipped or abandoned as soon as it is set.
+    std::atomic<int> first_hit{ INT_MAX };
+    // Matches found by each step, and the steps still running. Once every step has finished, the
+    // file is resolved: match_count holds the matches it reports (those of its first_hit step).
+    std::vector<size_t> step_matches;
+    std::atomic<int> pending_steps{ 0 };
+    std::atomic<size_t> match_count{ 0 };
+    std::atomic<bool> resolved{ false };
+
+    ~SharedImage() { if (bitmap) DeleteObject(bitmap); }
+
+    bool Cancelled(int position) const { return first_hit.load(std::memory_order_relaxed) < position; }
+
+    void ReportHit(int position) {
+        int current = first_hit.load();
+        while (position < current && !first_hit.compare_exchange_weak(current, position)) {}
+    }
+
+    void StartSteps(int steps) {
+        step_matches.assign(steps, 0);
+        pending_steps.store(steps);
+        resolved.store(steps == 0);
+    }
+
+    // Called exactly once per step, whether it ran, was cancelled or was cut off.
+    void FinishStep(int position, size_t matches) {
+        step_matches[position] = matches;
+        if (pending_steps.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        const int hit = first_hit.load();
+        match_count.store(hit == INT_MAX ? 0 : step_matches[hit], std::memory_order_relaxed);
+        resolved.store(true, std::memory_order_release);
+    }
+};
+
+/**
+ * @struct ResultCutoff
+ * @brief Ordered early exit for iMultiResults. Files are reported in order, so the tasks of file k
+ * can stop as soon as files 0..k-1 are all resolved and together hold max_results matches: none of
+ * file k's matches would be reported. The outcome is the same whichever task finishes first.
+ */
+struct ResultCutoff {
+    const std::vector<std::unique_ptr<SharedImage>>* images = nullptr;
+    size_t max_results = 0;
+
+    bool Reached(size_t file) const {
+        if (max_results == 0) return false;
+        size_t total = 0;
+        for (size_t earlier = 0; earlier < file && total < max_results; ++earlier) {
+            const SharedImage& image = *(*images)[earlier];
+            if (!image.resolved.load(std::memory_order_acquire)) return false;
+            total += image.match_count.load(std::memory_order_relaxed);
+        }
+        return total >= max_results;
+    }
+};
+
 bool check_avx2_support() {
     int cpuInfo[4];
     __cpuidex(cpuInfo, 7, 0);
@@ -406,9 +480,18 @@ static bool CheckApproxMatch_AVX2(const COLORREF* pScreenBits, int screenW, cons
 // CORE SEARCH LOGIC
 // =================================================================================================
 
+/**
+ * @param max_results Stop after this many matches; 0 = no limit.
+ * @param scale_owner Optional file whose scale steps run as separate tasks. The first match is
+ *        reported to it at once, and the scan is abandoned once a step before `scale_position`
+ *        has found a match.
+ * @param cutoff Optional; the scan is abandoned once the files before `file` cover the limit.
+ */
 static std::vector<std::string> SearchForBitmapInCapture(
     const ScreenCapture& screen_capture, const ImageToSearch& image_to_search,
-    int iLeft, int iTop, int iTolerance, int iTransparent, int iFindAllOccurrences)
+    int iLeft, int iTop, int iTolerance, int iTransparent, int iFindAllOccurrences,
+    int max_results = 0, SharedImage* scale_owner = nullptr, int scale_position = 0,
+    const ResultCutoff* cutoff = nullptr, size_t file = 0)
 {
     std::vector<std::string> found_matches;
     if (image_to_search.width > screen_capture.width || image_to_search.height > screen_capture.height) return found_matches;
@@ -416,6 +499,8 @@ static std::vector<std::string> SearchForBitmapInCapture(
     const int screenW = screen_capture.width; const int iMaxX = screen_capture.width - sourceW;
     const int iMaxY = screen_capture.height - sourceH;
     for (int y = 0; y <= iMaxY; ++y) {
+        if (scale_owner && scale_owner->Cancelled(scale_position)) return found_matches;
+        if (cutoff && cutoff->Reached(file)) return found_matches;
         for (int x = 0; x <= iMaxX; ++x) {
             bool found = false;
             if (iTolerance == 0) {
@@ -430,10 +515,14 @@ static std::vector<std::string> SearchForBitmapInCapture(
                 }
             }
             if (found) {
+                // Reported before anything else, so later steps stop as early as possible.
+                if (scale_owner && found_matches.empty()) scale_owner->ReportHit(scale_position);
                 char single_match[64];
                 sprintf_s(single_match, sizeof(single_match), "%d|%d|%d|%d", iLeft + x, iTop + y, sourceW, sourceH);
                 found_matches.push_back(single_match);
                 if (iFindAllOccurrences == 0) return found_matches;
+                // No task needs more than the call reports; the join below picks the first ones.
+                if (max_results > 0 && found_matches.size() >= static_cast<size_t>(max_results)) return found_matches;
             }
         }
     } return found_matches;
@@ -487,58 +576,95 @@ extern "C" __declspec(dllexport) char* WINAPI ImageSearch(
         return szAnswer;
     }
 
-    ThreadPool pool(std::thread::hardware_concurrency());
-    std::vector<std::future<std::vector<std::string>>> futures;
+    // With iMultiResults > 0 every task stops once it has found that many matches itself, or once
+    // the files before its own already hold that many (see ResultCutoff), instead of completing a
+    // full scan that is truncated afterwards. The limit across files is applied in the in-order
+    // join below, so the first iMultiResults matches in file order are returned, whichever task
+    // finishes first.
+    const int max_results = std::max(0, iMultiResults);
+
+    // Scale steps are enumerated from an integer index (smallest first), so each one is exactly
+    // fMinScale + i * fScaleStep, and every (file, step) pair is its own pool task. A file reports
+    // the first step, in this order, that finds a match: once one does, the file's later steps are
+    // cancelled, and the outcome does not depend on which task finishes first.
+    const int scale_steps = static_cast<int>(floor((static_cast<double>(fMaxScale) - fMinScale) / fScaleStep + 1e-4)) + 1;
+
+    std::vector<std::unique_ptr<SharedImage>> images;
     std::vector<char> file_buffer(sImageFile, sImageFile + strlen(sImageFile) + 1);
     char* next_token = nullptr;
     char* current_file = strtok_s(file_buffer.data(), "|", &next_token);
     while (current_file != nullptr) {
         if (strlen(current_file) > 0) {
-            std::string file_path = current_file;
-            futures.push_back(pool.enqueue([=] {
-                int imageType = 0;
-                // FIX: Pass 5 arguments to LoadPicture
-                HBITMAP hBitmapOrig = LoadPicture(file_path.c_str(), 0, 0, imageType, 0);
-                if (!hBitmapOrig) return std::vector<std::string>{};
-                std::vector<std::string> thread_results;
-                for (float scale = fMinScale; scale <= fMaxScale; scale += fScaleStep) {
-                    HBITMAP hBitmapToSearch = nullptr;
-                    bool deleteThisBitmap = false;
-                    if (scale == 1.0f) {
-                        hBitmapToSearch = hBitmapOrig;
-                    }
-                    else {
-                        BITMAP bm; GetObject(hBitmapOrig, sizeof(bm), &bm);
-                        int newW = static_cast<int>(round(bm.bmWidth * scale));
-                        int newH = static_cast<int>(round(bm.bmHeight * scale));
-                        if (newW < 1 || newH < 1) continue;
-                        hBitmapToSearch = ScaleBitmap(hBitmapOrig, newW, newH);
-                        deleteThisBitmap = true;
-                    }
-                    if (hBitmapToSearch) {
-                        ImageToSearch image_to_search;
-                        HDC hdcMem = CreateCompatibleDC(nullptr);
-                        image_to_search.pixels = getbits(hBitmapToSearch, hdcMem, image_to_search.width, image_to_search.height);
-                        DeleteDC(hdcMem);
-                        if (!image_to_search.pixels.empty()) {
-                            thread_results = SearchForBitmapInCapture(screen_capture, image_to_search, iLeft, iTop, iTolerance, iTransparent, iFindAllOccurrences);
+            images.push_back(std::make_unique<SharedImage>());
+            images.back()->file_path = current_file;
+        }
+        current_file = strtok_s(nullptr, "|", &next_token);
+    }
+
+    const ResultCutoff cutoff{ &images, static_cast<size_t>(max_results) };
+    for (auto& image : images) image->StartSteps(scale_steps);
+
+    ThreadPool pool(std::thread::hardware_concurrency());
+    std::vector<std::vector<std::future<std::vector<std::string>>>> futures(images.size());
+    for (size_t file = 0; file < images.size(); ++file) {
+        SharedImage* image = images[file].get();
+        for (int position = 0; position < scale_steps; ++position) {
+            futures[file].push_back(pool.enqueue([=, &screen_capture, &cutoff] {
+                std::vector<std::string> step_results = [&] {
+                    if (image->Cancelled(position) || cutoff.Reached(file)) return std::vector<std::string>{};
+                    std::call_once(image->load_once, [image] {
+                        int imageType = 0;
+                        // FIX: Pass 5 arguments to LoadPicture
+                        image->bitmap = LoadPicture(image->file_path.c_str(), 0, 0, imageType, 0);
+                    });
+                    if (!image->bitmap) return std::vector<std::string>{};
+
+                    const float scale = static_cast<float>(fMinScale + position * static_cast<double>(fScaleStep));
+                    ImageToSearch image_to_search;
+                    {
+                        std::lock_guard<std::mutex> lock(image->gdi_mutex);
+                        HBITMAP hBitmapToSearch = nullptr;
+                        bool deleteThisBitmap = false;
+                        if (fabs(scale - 1.0f) < 1e-4f) {
+                            hBitmapToSearch = image->bitmap;
+                        }
+                        else {
+                            BITMAP bm; GetObject(image->bitmap, sizeof(bm), &bm);
+                            int newW = static_cast<int>(round(bm.bmWidth * scale));
+                            int newH = static_cast<int>(round(bm.bmHeight * scale));
+                            if (newW < 1 || newH < 1) return std::vector<std::string>{};
+                            hBitmapToSearch = ScaleBitmap(image->bitmap, newW, newH);
+                            deleteThisBitmap = true;
+                        }
+                        if (hBitmapToSearch) {
+                            HDC hdcMem = CreateCompatibleDC(nullptr);
+                            image_to_search.pixels = getbits(hBitmapToSearch, hdcMem, image_to_search.width, image_to_search.height);
+                            DeleteDC(hdcMem);
+                            if (deleteThisBitmap) DeleteObject(hBitmapToSearch);
                         }
-                        if (deleteThisBitmap) DeleteObject(hBitmapToSearch);
                     }
-                    if (!thread_results.empty()) break;
-                }
-                if (hBitmapOrig) { DeleteObject(hBitmapOrig); }
-                return thread_results;
+                    if (image_to_search.pixels.empty()) return std::vector<std::string>{};
+
+                    std::vector<std::string> matches = SearchForBitmapInCapture(screen_capture, image_to_search, iLeft, iTop,
+                        iTolerance, iTransparent, iFindAllOccurrences, max_results, image, position, &cutoff, file);
+                    // A cancelled step is never reported.
+                    if (image->Cancelled(position)) matches.clear();
+                    return matches;
+                }();
+                image->FinishStep(position, step_results.size());
+                return step_results;
                 }));
         }
-        current_file = strtok_s(nullptr, "|", &next_token);
     }
 
     std::vector<std::string> all_matches;
-    for (auto& fut : futures) {
-        auto thread_results = fut.get();
-        if (!thread_results.empty()) {
-            all_matches.insert(all_matches.end(), thread_results.begin(), thread_results.end());
+    for (size_t file = 0; file < images.size(); ++file) {
+        for (auto& fut : futures[file]) fut.wait();
+        const int hit = images[file]->first_hit.load();
+        if (hit == INT_MAX) continue;
+        for (std::string& match : futures[file][hit].get()) {
+            if (max_results > 0 && all_matches.size() >= static_cast<size_t>(max_results)) break;
+            all_matches.push_back(std::move(match));
         }
     }
 
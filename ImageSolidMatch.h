@@ -0,0 +1,114 @@
+// =================================================================================================
+//
+// Name ............: ImageSolidMatch.h
+// Description .....: Run-length search for single-color templates.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Free of OS dependencies like ImageKernels.h; checked against a brute-force scan at every kernel
+// level by tests/ImageSolidMatchTest.cpp.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <optional>
+#include <algorithm>
+
+#include "ImageKernels.h"
+#include "ImageTemplate.h"
+
+// =================================================================================================
+// #BLOCK# SOLID COLOR ENGINE
+// Run-length search for single-color templates; cost is linear in the screen size.
+// =================================================================================================
+
+namespace SolidMatch {
+
+    // How much wider than the bounds of one pixel (per channel) the union of all template bounds may
+    // be for the template to still count as a single color.
+    constexpr int kMaxColorSpread = 16;
+
+    /**
+     * @struct Fill
+     * @brief The color range a run-length scan looks for.
+     */
+    struct Fill {
+        // Union of the bounds of every template pixel.
+        COLORREF lo, hi;
+        // True if every pixel has these exact bounds, so a full run stack is a match without verification.
+        bool uniform;
+    };
+
+    /**
+     * @brief Detects templates whose pixels all demand (nearly) the same color.
+     * @return The fill to scan for, or std::nullopt if the template has several colors or any
+     * transparent pixel.
+     */
+    inline std::optional<Fill> Analyze(const ToleranceBounds& bounds) noexcept {
+        if (bounds.lo.empty()) return std::nullopt;
+        Fill fill{ bounds.lo[0], bounds.hi[0], true };
+        int lo[3], hi[3];
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = (bounds.lo[0] >> (8 * c)) & 0xFF;
+            hi[c] = (bounds.hi[0] >> (8 * c)) & 0xFF;
+        }
+        for (size_t i = 0; i < bounds.lo.size(); ++i) {
+            if (TemplateAnalysis::IsUnconstrained(bounds.lo[i], bounds.hi[i])) return std::nullopt;
+            if (bounds.lo[i] == fill.lo && bounds.hi[i] == fill.hi) continue;
+            fill.uniform = false;
+            for (int c = 0; c < 3; ++c) {
+                lo[c] = std::min(lo[c], static_cast<int>((bounds.lo[i] >> (8 * c)) & 0xFF));
+                hi[c] = std::max(hi[c], static_cast<int>((bounds.hi[i] >> (8 * c)) & 0xFF));
+            }
+        }
+        for (int c = 0; c < 3; ++c) {
+            const int pixel_width = static_cast<int>((bounds.hi[0] >> (8 * c)) & 0xFF) - static_cast<int>((bounds.lo[0] >> (8 * c)) & 0xFF);
+            if (hi[c] - lo[c] > pixel_width + kMaxColorSpread) return std::nullopt;
+        }
+        fill.lo = RGB(lo[0], lo[1], lo[2]);
+        fill.hi = RGB(hi[0], hi[1], hi[2]) | 0xFF000000;
+        return fill;
+    }
+
+    /**
+     * @brief Finds every w x h block of in-fill pixels, in scan order.
+     * Each screen row is reduced to in-bounds flags by the SIMD kernel, then walked right to left to
+     * get the run of in-fill pixels starting at each x. A candidate column keeps a count of the
+     * consecutive rows whose run there is at least w long; a count of h is a match of the block
+     * whose bottom row was just read. Non-uniform fills are a superset test, so their hits are verified.
+     * `cancelled` is polled once per screen row; the scan stops as soon as it returns true.
+     */
+    template <class Verify, class OnMatch, class Cancelled>
+    inline void Scan(const PixelBuffer& screen, const Fill& fill, int w, int h, int max_x, int max_y,
+        void (*mark_in_bounds)(const COLORREF*, COLORREF, COLORREF, uint8_t*, size_t) noexcept,
+        Verify&& verify, OnMatch&& on_match, Cancelled&& cancelled) {
+
+        const int count = max_x + 1;
+        std::vector<uint8_t> inside(screen.width);
+        std::vector<int> stack(count, 0);
+        for (int row = 0; row < max_y + h; ++row) {
+            if (cancelled()) return;
+            mark_in_bounds(&screen.pixels[static_cast<size_t>(row) * screen.width], fill.lo, fill.hi, inside.data(), inside.size());
+
+            // Positions past max_x only extend the runs of the candidates to their left. The flags
+            // are noisy on textured screens, so the updates are masks rather than branches.
+            int run = 0;
+            for (int x = screen.width - 1; x >= count; --x) run = (run + 1) & -static_cast<int>(inside[x]);
+            for (int x = count - 1; x >= 0; --x) {
+                run = (run + 1) & -static_cast<int>(inside[x]);
+                stack[x] = (stack[x] + 1) & -static_cast<int>(run >= w);
+            }
+
+            if (row < h - 1) continue;
+            const int y = row - h + 1;
+            for (int x = 0; x < count; ++x) {
+                if (stack[x] >= h && (fill.uniform || verify(x, y)) && !on_match(x, y)) return;
+            }
+        }
+    }
+}
@@ -0,0 +1,486 @@
+// =================================================================================================
+//
+// Name ............: ImageTemplate.h
+// Description .....: One-time analysis of a template: tolerance bounds, opaque spans and probes.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Builds the per-pixel bounds and kernel layouts that the kernels in ImageKernels.h compare
+// against, and picks the anchor and probe pixels of the prefilters. Free of OS dependencies like
+// ImageKernels.h, so the tests in tests/ use the same analysis as the DLL.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "ImageKernels.h"
+
+// =================================================================================================
+// #BLOCK# TEMPLATE ANALYSIS
+// One-time preprocessing of a source image that lets the search engine reject candidates cheaply.
+// =================================================================================================
+
+namespace TemplateAnalysis {
+
+    /**
+     * @brief True if a bounds entry accepts every color (transparent pixel or tolerance 255).
+     * Such pixels can never reject a candidate and are useless as anchors or probes.
+     */
+    inline bool IsUnconstrained(COLORREF lo, COLORREF hi) noexcept {
+        return (lo & 0x00FFFFFF) == 0 && (hi & 0x00FFFFFF) == 0x00FFFFFF;
+    }
+
+    /**
+     * @brief Number of pixels that can reject a candidate; the base of a fractional mismatch budget.
+     */
+    inline size_t CountConstrainedPixels(const ToleranceBounds& bounds) noexcept {
+        size_t count = 0;
+        for (size_t i = 0; i < bounds.lo.size(); ++i) {
+            if (!IsUnconstrained(bounds.lo[i], bounds.hi[i])) ++count;
+        }
+        return count;
+    }
+
+    // Transparent gaps shorter than this stay inside a span: comparing a few always-passing pixels
+    // costs less than starting another span.
+    constexpr int kSpanMergeGap = 8;
+
+    /**
+     * @brief Encodes each template row as a list of runs of constrained pixels (see ToleranceBounds).
+     */
+    inline void BuildOpaqueSpans(ToleranceBounds& bounds) {
+        bounds.spans.clear();
+        for (int y = 0; y < bounds.height; ++y) {
+            const size_t row = static_cast<size_t>(y) * bounds.width;
+            for (int x = 0; x < bounds.width;) {
+                if (IsUnconstrained(bounds.lo[row + x], bounds.hi[row + x])) { ++x; continue; }
+                int end = x + 1;
+                int last_constrained = x;
+                while (end < bounds.width && end - last_constrained <= kSpanMergeGap) {
+                    if (!IsUnconstrained(bounds.lo[row + end], bounds.hi[row + end])) last_constrained = end;
+                    ++end;
+                }
+                bounds.spans.push_back({ y, x, last_constrained + 1 - x });
+                x = last_constrained + 1;
+            }
+        }
+    }
+
+    /**
+     * @brief Fills the packed-row layout of narrow template bounds (see ToleranceBounds).
+     * Templates up to 2 pixels wide get 4 rows per group, up to 4 pixels 2 rows per group.
+     */
+    inline void PackNarrowRows(ToleranceBounds& bounds) {
+        bounds.packed_lo.clear();
+        bounds.packed_hi.clear();
+        bounds.packed_rows = 0;
+        if (bounds.width < 1 || bounds.width > 4 || bounds.height < 1) return;
+
+        const int rows = bounds.width <= 2 ? 4 : 2;
+        const int slot = 8 / rows;
+        const int groups = (bounds.height + rows - 1) / rows;
+        bounds.packed_rows = rows;
+        bounds.packed_lo.assign(static_cast<size_t>(groups) * 8, 0x00000000);
+        bounds.packed_hi.assign(bounds.packed_lo.size(), 0xFFFFFFFF);
+
+        for (int y = 0; y < bounds.height; ++y) {
+            for (int x = 0; x < bounds.width; ++x) {
+                size_t o = static_cast<size_t>(y / rows) * 8 + (y % rows) * slot + x;
+                bounds.packed_lo[o] = bounds.lo[y * bounds.width + x];
+                bounds.packed_hi[o] = bounds.hi[y * bounds.width + x];
+            }
+        }
+    }
+
+    /**
+     * @brief Derives the kernel layouts (span list, packed narrow rows) from the lo/hi arrays.
+     * Called by everything that builds a ToleranceBounds.
+     */
+    inline void FinalizeBounds(ToleranceBounds& bounds) {
+        BuildOpaqueSpans(bounds);
+        PackNarrowRows(bounds);
+    }
+
+    /**
+     * @brief Cuts the fully transparent rows and columns off the edges of a template.
+     * The smaller template fits at more screen positions, including ones where the removed border
+     * would hang over the edge of the search area.
+     * @param offset_x Receives the column of the trimmed area within the original template.
+     * @param offset_y Receives the row of the trimmed area within the original template.
+     * @return The trimmed bounds, or a copy of `bounds` if it has no constrained pixel at all.
+     */
+    inline ToleranceBounds TrimTransparentBorder(const ToleranceBounds& bounds, int& offset_x, int& offset_y) {
+        offset_x = offset_y = 0;
+        if (bounds.spans.empty()) return bounds;
+
+        int left = bounds.width, right = 0;
+        for (const OpaqueSpan& span : bounds.spans) {
+            left = std::min(left, span.x);
+            right = std::max(right, span.x + span.length);
+        }
+        const int top = bounds.spans.front().y;
+        const int bottom = bounds.spans.back().y + 1;
+        if (left == 0 && top == 0 && right == bounds.width && bottom == bounds.height) return bounds;
+
+        ToleranceBounds trimmed;
+        trimmed.width = right - left;
+        trimmed.height = bottom - top;
+        trimmed.lo.reserve(static_cast<size_t>(trimmed.width) * trimmed.height);
+        trimmed.hi.reserve(trimmed.lo.capacity());
+        for (int y = top; y < bottom; ++y) {
+            const size_t row = static_cast<size_t>(y) * bounds.width;
+            trimmed.lo.insert(trimmed.lo.end(), bounds.lo.begin() + row + left, bounds.lo.begin() + row + right);
+            trimmed.hi.insert(trimmed.hi.end(), bounds.hi.begin() + row + left, bounds.hi.begin() + row + right);
+        }
+        FinalizeBounds(trimmed);
+
+        offset_x = left;
+        offset_y = top;
+        return trimmed;
+    }
+
+    /**
+     * @brief Precomputes the saturated [src - tol, src + tol] byte bounds of every template pixel.
+     * @param tolerance_map Optional image of the same size as the template. Each of its R, G and B
+     *        values widens the tolerance of the matching template channel, so regions such as
+     *        anti-aliased edges can be more permissive than the rest. The effective tolerance of a
+     *        channel is max(tolerance, map value). Ignored if nullptr or if its size differs.
+     */
+    inline ToleranceBounds BuildToleranceBounds(
+        const PixelBuffer& source, COLORREF transparent_color, int tolerance, const PixelBuffer* tolerance_map) {
+
+        ToleranceBounds bounds;
+        bounds.width = source.width;
+        bounds.height = source.height;
+        bounds.lo.resize(source.pixels.size());
+        bounds.hi.resize(source.pixels.size());
+
+        const bool use_map = tolerance_map && tolerance_map->width == source.width &&
+            tolerance_map->height == source.height && tolerance_map->pixels.size() == source.pixels.size();
+
+        for (size_t i = 0; i < source.pixels.size(); ++i) {
+            COLORREF pixel = source.pixels[i];
+            if (pixel == transparent_color) {
+                bounds.lo[i] = 0x00000000;
+                bounds.hi[i] = 0xFFFFFFFF;
+                continue;
+            }
+
+            int tol_r = tolerance, tol_g = tolerance, tol_b = tolerance;
+            if (use_map) {
+                COLORREF map_pixel = tolerance_map->pixels[i];
+                tol_r = std::max(tol_r, (int)GetRValue(map_pixel));
+                tol_g = std::max(tol_g, (int)GetGValue(map_pixel));
+                tol_b = std::max(tol_b, (int)GetBValue(map_pixel));
+            }
+
+            // The alpha byte is left at 0x00..0xFF so it never takes part in the comparison.
+            bounds.lo[i] = RGB(std::max(0, GetRValue(pixel) - tol_r),
+                               std::max(0, GetGValue(pixel) - tol_g),
+                               std::max(0, GetBValue(pixel) - tol_b));
+            bounds.hi[i] = RGB(std::min(255, GetRValue(pixel) + tol_r),
+                               std::min(255, GetGValue(pixel) + tol_g),
+                               std::min(255, GetBValue(pixel) + tol_b)) | 0xFF000000;
+        }
+        FinalizeBounds(bounds);
+        return bounds;
+    }
+
+    /**
+     * @brief Luma-mode counterpart of BuildToleranceBounds: the saturated [Y - tol, Y + tol] bounds
+     * of every template pixel's luma (PixelComparison::LumaOf), stored as gray COLORREFs so that the
+     * trimming, span and anchor selection code applies unchanged. A tolerance map widens a pixel by
+     * its largest R, G or B value.
+     */
+    inline ToleranceBounds BuildLumaToleranceBounds(
+        const PixelBuffer& source, COLORREF transparent_color, int tolerance, const PixelBuffer* tolerance_map) {
+
+        ToleranceBounds bounds;
+        bounds.width = source.width;
+        bounds.height = source.height;
+        bounds.lo.resize(source.pixels.size());
+        bounds.hi.resize(source.pixels.size());
+
+        const bool use_map = tolerance_map && tolerance_map->width == source.width &&
+            tolerance_map->height == source.height && tolerance_map->pixels.size() == source.pixels.size();
+
+        for (size_t i = 0; i < source.pixels.size(); ++i) {
+            COLORREF pixel = source.pixels[i];
+            if (pixel == transparent_color) {
+                bounds.lo[i] = 0x00000000;
+                bounds.hi[i] = 0xFFFFFFFF;
+                continue;
+            }
+
+            int tol = tolerance;
+            if (use_map) {
+                COLORREF map_pixel = tolerance_map->pixels[i];
+                tol = std::max({ tol, (int)GetRValue(map_pixel), (int)GetGValue(map_pixel), (int)GetBValue(map_pixel) });
+            }
+
+            const int luma = PixelComparison::LumaOf(pixel);
+            const int lo = std::max(0, luma - tol), hi = std::min(255, luma + tol);
+            bounds.lo[i] = RGB(lo, lo, lo);
+            bounds.hi[i] = RGB(hi, hi, hi) | 0xFF000000;
+        }
+        FinalizeBounds(bounds);
+        return bounds;
+    }
+
+    /**
+     * @brief Gradient-mode counterpart of BuildToleranceBounds: the saturated [G - tol, G + tol]
+     * bounds of the Sobel gradient magnitude G (PixelComparison::SobelMagnitude) of every template
+     * pixel's luma, stored as gray COLORREFs. Only pixels whose whole 3x3 neighbourhood is opaque
+     * are constrained: the gradient at the template border and next to transparent pixels depends
+     * on whatever lies behind them on screen. A tolerance map widens a pixel as in luma mode.
+     */
+    inline ToleranceBounds BuildGradientToleranceBounds(
+        const PixelBuffer& source, COLORREF transparent_color, int tolerance, const PixelBuffer* tolerance_map) {
+
+        const int width = source.width;
+        const int height = source.height;
+        ToleranceBounds bounds;
+        bounds.width = width;
+        bounds.height = height;
+        bounds.lo.assign(source.pixels.size(), 0x00000000);
+        bounds.hi.assign(source.pixels.size(), 0xFFFFFFFF);
+
+        const bool use_map = tolerance_map && tolerance_map->width == source.width &&
+            tolerance_map->height == source.height && tolerance_map->pixels.size() == source.pixels.size();
+
+        std::vector<uint8_t> luma(source.pixels.size());
+        std::vector<uint8_t> opaque(source.pixels.size());
+        for (size_t i = 0; i < source.pixels.size(); ++i) {
+            luma[i] = PixelComparison::LumaOf(source.pixels[i]);
+            opaque[i] = source.pixels[i] != transparent_color;
+        }
+
+        for (int y = 1; y < height - 1; ++y) {
+            for (int x = 1; x < width - 1; ++x) {
+                bool interior = true;
+                for (int dy = -1; dy <= 1 && interior; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) interior &= opaque[(y + dy) * width + x + dx] != 0;
+                }
+                if (!interior) continue;
+
+                const size_t i = static_cast<size_t>(y) * width + x;
+                int tol = tolerance;
+                if (use_map) {
+                    COLORREF map_pixel = tolerance_map->pixels[i];
+                    tol = std::max({ tol, (int)GetRValue(map_pixel), (int)GetGValue(map_pixel), (int)GetBValue(map_pixel) });
+                }
+
+                const int gradient = PixelComparison::SobelMagnitude(&luma[i - width - x], &luma[i - x], &luma[i + width - x], x);
+                const int lo = std::max(0, gradient - tol), hi = std::min(255, gradient + tol);
+                bounds.lo[i] = RGB(lo, lo, lo);
+                bounds.hi[i] = RGB(hi, hi, hi) | 0xFF000000;
+            }
+        }
+        FinalizeBounds(bounds);
+        return bounds;
+    }
+
+    /**
+     * @brief Extracts the one-byte-per-pixel layout of gray bounds (BuildLumaToleranceBounds,
+     * BuildGradientToleranceBounds).
+     */
+    inline ByteBounds ToByteBounds(const ToleranceBounds& bounds) {
+        ByteBounds plane;
+        plane.width = bounds.width;
+        plane.height = bounds.height;
+        plane.lo.resize(bounds.lo.size());
+        plane.hi.resize(bounds.hi.size());
+        for (size_t i = 0; i < bounds.lo.size(); ++i) {
+            plane.lo[i] = GetRValue(bounds.lo[i]);
+            plane.hi[i] = GetRValue(bounds.hi[i]);
+        }
+        plane.spans = bounds.spans;
+        return plane;
+    }
+
+    /**
+     * @brief Splits tolerance bounds into the byte planes of the planar layout.
+     */
+    inline PlanarBounds ToPlanarBounds(const ToleranceBounds& bounds) {
+        PlanarBounds planar;
+        planar.width = bounds.width;
+        planar.height = bounds.height;
+        for (int c = 0; c < 3; ++c) {
+            planar.lo[c].resize(bounds.lo.size());
+            planar.hi[c].resize(bounds.hi.size());
+            for (size_t i = 0; i < bounds.lo.size(); ++i) {
+                planar.lo[c][i] = static_cast<uint8_t>(bounds.lo[i] >> (8 * c));
+                planar.hi[c][i] = static_cast<uint8_t>(bounds.hi[i] >> (8 * c));
+            }
+        }
+        planar.spans = bounds.spans;
+        return planar;
+    }
+
+    // Upper bound on the number of anchors. Each anchor costs one scalar pixel test per candidate, and
+    // beyond a handful the rejection rate no longer improves noticeably.
+    constexpr size_t kMaxAnchorPixels = 6;
+
+    /**
+     * @brief Selects a small set of constrained pixels that are most likely to fail on a wrong candidate.
+     * Pixels are ranked by the rarity of their color (the centre of their bounds) within the template
+     * first and by their contrast against the 4-connected neighbours second. At most one anchor is
+     * taken per distinct color so the set covers as many independent features as possible.
+     * @return The anchors in the order they should be tested (most selective first).
+     */
+    inline std::vector<AnchorPixel> SelectAnchorPixels(const ToleranceBounds& bounds) {
+        struct Candidate {
+            int x, y;
+            COLORREF color;
+            int frequency;
+            int contrast;
+        };
+
+        const int width = bounds.width;
+        const int height = bounds.height;
+        auto constrained = [&](size_t i) noexcept { return !IsUnconstrained(bounds.lo[i], bounds.hi[i]); };
+        auto centre = [&](size_t i) noexcept {
+            COLORREF lo = bounds.lo[i], hi = bounds.hi[i];
+            return RGB((GetRValue(lo) + GetRValue(hi)) / 2, (GetGValue(lo) + GetGValue(hi)) / 2, (GetBValue(lo) + GetBValue(hi)) / 2);
+        };
+
+        std::vector<COLORREF> colors(bounds.lo.size());
+        std::unordered_map<COLORREF, int> histogram;
+        for (size_t i = 0; i < colors.size(); ++i) {
+            if (!constrained(i)) continue;
+            colors[i] = centre(i);
+            ++histogram[colors[i]];
+        }
+        if (histogram.empty()) return {};
+
+        auto channel_distance = [](COLORREF a, COLORREF b) noexcept {
+            return std::max({ abs((int)GetRValue(a) - (int)GetRValue(b)),
+                              abs((int)GetGValue(a) - (int)GetGValue(b)),
+                              abs((int)GetBValue(a) - (int)GetBValue(b)) });
+        };
+
+        std::vector<Candidate> candidates;
+        candidates.reserve(colors.size());
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                size_t i = static_cast<size_t>(y) * width + x;
+                if (!constrained(i)) continue;
+
+                int contrast = 0;
+                const int neighbours[4][2] = { { x - 1, y }, { x + 1, y }, { x, y - 1 }, { x, y + 1 } };
+                for (const auto& n : neighbours) {
+                    if (n[0] < 0 || n[1] < 0 || n[0] >= width || n[1] >= height) continue;
+                    size_t ni = static_cast<size_t>(n[1]) * width + n[0];
+                    if (!constrained(ni)) continue;
+                    contrast = std::max(contrast, channel_distance(colors[i], colors[ni]));
+                }
+                candidates.push_back({ x, y, colors[i], histogram[colors[i]], contrast });
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            if (a.frequency != b.frequency) return a.frequency < b.frequency;
+            return a.contrast > b.contrast;
+        });
+
+        std::vector<AnchorPixel> anchors;
+        std::vector<COLORREF> used_colors;
+        for (const Candidate& c : candidates) {
+            if (anchors.size() >= kMaxAnchorPixels) break;
+            if (std::find(used_colors.begin(), used_colors.end(), c.color) != used_colors.end()) continue;
+            used_colors.push_back(c.color);
+            size_t index = static_cast<size_t>(c.y) * width + c.x;
+            anchors.push_back({ c.x, c.y, bounds.lo[index], bounds.hi[index] });
+        }
+        return anchors;
+    }
+
+    /**
+     * @brief Tests only the anchor pixels of a template at one candidate position.
+     * @param budget Number of anchors allowed to fail (mismatch-budget mode).
+     * @return False if more than `budget` anchors are out of tolerance, meaning the full comparison
+     *         can be skipped.
+     */
+    inline bool AnchorsMatch(
+        const PixelBuffer& screen, const std::vector<AnchorPixel>& anchors, int start_x, int start_y, int budget = 0) noexcept {
+
+        for (const AnchorPixel& anchor : anchors) {
+            COLORREF screen_pixel = screen.pixels[(start_y + anchor.y) * screen.width + start_x + anchor.x];
+            if (!PixelComparison::PixelWithinBounds(screen_pixel, anchor.lo, anchor.hi) && --budget < 0) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Byte-plane AnchorsMatch: tests anchors selected from gray bounds against a BytePlane.
+     */
+    inline bool AnchorsMatch(const BytePlane& screen, const std::vector<AnchorPixel>& anchors, int start_x, int start_y) noexcept {
+        for (const AnchorPixel& anchor : anchors) {
+            unsigned value = screen.pixels[static_cast<size_t>(start_y + anchor.y) * screen.width + start_x + anchor.x];
+            if (value - GetRValue(anchor.lo) > static_cast<unsigned>(GetRValue(anchor.hi) - GetRValue(anchor.lo))) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Planar-layout AnchorsMatch: reassembles each anchor's screen pixel from the byte planes.
+     */
+    inline bool AnchorsMatch(const PlanarBuffer& screen, const std::vector<AnchorPixel>& anchors, int start_x, int start_y) noexcept {
+        for (const AnchorPixel& anchor : anchors) {
+            const size_t i = static_cast<size_t>(start_y + anchor.y) * screen.width + start_x + anchor.x;
+            COLORREF screen_pixel = RGB(screen.planes[0][i], screen.planes[1][i], screen.planes[2][i]);
+            if (!PixelComparison::PixelWithinBounds(screen_pixel, anchor.lo, anchor.hi)) return false;
+        }
+        return true;
+    }
+
+    // Number of template pixels the candidate-vectorized engine tests before falling back to the
+    // full per-candidate comparison for the surviving lanes.
+    constexpr size_t kMaxProbePixels = 16;
+
+    /**
+     * @brief Builds the probe list for the candidate-vectorized engine: the anchors first, followed by
+     * the constrained pixels of the first template row that are not anchors already.
+     */
+    inline std::vector<AnchorPixel> SelectProbePixels(const ToleranceBounds& bounds, const std::vector<AnchorPixel>& anchors) {
+        std::vector<AnchorPixel> probes(anchors.begin(), anchors.end());
+        for (int x = 0; x < bounds.width && probes.size() < kMaxProbePixels; ++x) {
+            if (IsUnconstrained(bounds.lo[x], bounds.hi[x])) continue;
+            bool is_anchor = std::any_of(anchors.begin(), anchors.end(),
+                [x](const AnchorPixel& a) { return a.x == x && a.y == 0; });
+            if (!is_anchor) probes.push_back({ x, 0, bounds.lo[x], bounds.hi[x] });
+        }
+        return probes;
+    }
+
+    /**
+     * @brief Estimates how often the most selective probe pixel matches the screen, from a sparse
+     * sample of candidate positions.
+     * @return The fraction of sampled candidates that pass the first probe (0.0 - 1.0).
+     */
+    inline double EstimateProbePassRate(
+        const PixelBuffer& screen, const AnchorPixel& probe, int max_x, int max_y) noexcept {
+
+        constexpr int kSamplesPerAxis = 64;
+        const int step_x = std::max(1, (max_x + 1) / kSamplesPerAxis);
+        const int step_y = std::max(1, (max_y + 1) / kSamplesPerAxis);
+        const std::vector<AnchorPixel> single{ probe };
+
+        int sampled = 0, passed = 0;
+        for (int y = 0; y <= max_y; y += step_y) {
+            for (int x = 0; x <= max_x; x += step_x) {
+                ++sampled;
+                if (AnchorsMatch(screen, single, x, y)) ++passed;
+            }
+        }
+        return sampled > 0 ? static_cast<double>(passed) / sampled : 1.0;
+    }
+}
+
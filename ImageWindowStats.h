@@ -0,0 +1,161 @@
+// =================================================================================================
+//
+// Name ............: ImageWindowStats.h
+// Description .....: Summed-area tables of a screen and the window statistics prefilter.
+// Author(s) .......: Dao Van Trong - TRONG.PRO
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Shared by the tolerance prefilter and the correlation search. Free of OS dependencies like
+// ImageKernels.h.
+//
+// =================================================================================================
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+
+#include "ImageKernels.h"
+
+// =================================================================================================
+// #BLOCK# WINDOW STATISTICS PREFILTER
+// Summed-area tables of the screen that bound each candidate window's channel sums in O(1).
+// =================================================================================================
+
+namespace WindowStats {
+
+    /**
+     * @struct IntegralTable
+     * @brief Per-channel (R, G, B) summed-area tables of a screen, (width + 1) x (height + 1) each.
+     * Entries are kept modulo 2^bits of `Sum`. A window sum computed from four corners is still exact
+     * as long as the true sum fits in `Sum`, independent of the screen size.
+     */
+    template <class Sum>
+    struct IntegralTable {
+        int stride = 0;
+        std::array<std::vector<Sum>, 3> channels;
+    };
+
+    // The prefilter tables; 32 bits cover every template it supports (see Filter::Supports).
+    using IntegralImage = IntegralTable<uint32_t>;
+
+    /**
+     * @brief Builds the summed-area tables of the channel values, or of their squares if `squared`.
+     */
+    template <class Sum = uint32_t>
+    inline IntegralTable<Sum> BuildIntegralImage(const PixelBuffer& screen, bool squared) {
+        IntegralTable<Sum> table;
+        table.stride = screen.width + 1;
+        for (auto& channel : table.channels) {
+            channel.assign(static_cast<size_t>(table.stride) * (screen.height + 1), 0);
+        }
+
+        for (int y = 0; y < screen.height; ++y) {
+            const COLORREF* row = &screen.pixels[static_cast<size_t>(y) * screen.width];
+            for (int c = 0; c < 3; ++c) {
+                const Sum* above = &table.channels[c][static_cast<size_t>(y) * table.stride];
+                Sum* current = &table.channels[c][static_cast<size_t>(y + 1) * table.stride];
+                const int shift = c * 8;
+                Sum running = 0;
+                for (int x = 0; x < screen.width; ++x) {
+                    Sum value = (row[x] >> shift) & 0xFF;
+                    running += squared ? value * value : value;
+                    current[x + 1] = above[x + 1] + running;
+                }
+            }
+        }
+        return table;
+    }
+
+    template <class Sum>
+    inline Sum WindowSum(const std::vector<Sum>& table, int stride, int x, int y, int width, int height) noexcept {
+        const size_t top = static_cast<size_t>(y) * stride + x;
+        const size_t bottom = static_cast<size_t>(y + height) * stride + x;
+        return table[bottom + width] - table[top + width] - table[bottom] + table[top];
+    }
+
+    /**
+     * @class Filter
+     * @brief Rejects candidate windows whose channel sums (and optionally sums of squares) cannot
+     * come from pixels inside the template bounds.
+     * If every pixel of a window lies in [lo, hi], its channel sum lies in [sum(lo), sum(hi)], and as
+     * the values are non-negative the sum of squares lies in [sum(lo^2), sum(hi^2)]. Transparent
+     * pixels contribute their full 0..255 range. A true match is therefore never rejected.
+     */
+    class Filter {
+    public:
+        /**
+         * @brief True if the window sums of the template cannot overflow the 32-bit tables.
+         */
+        static bool Supports(const ToleranceBounds& bounds) noexcept {
+            return static_cast<uint64_t>(bounds.width) * bounds.height * 255 <= UINT32_MAX;
+        }
+
+        /**
+         * @param squares Tables of squared values to also bound the second moment (i.e. the
+         *        variance), or nullptr for the means only. Ignored for templates whose sums of
+         *        squares could overflow.
+         */
+        Filter(const ToleranceBounds& bounds, const IntegralImage& sums, const IntegralImage* squares) noexcept
+            : sums_(sums), width_(bounds.width), height_(bounds.height) {
+
+            const uint64_t area = static_cast<uint64_t>(bounds.width) * bounds.height;
+            squares_ = area * 255 * 255 <= UINT32_MAX ? squares : nullptr;
+
+            for (int c = 0; c < 3; ++c) {
+                const int shift = c * 8;
+                uint32_t lo_sum = 0, hi_sum = 0, lo_sq = 0, hi_sq = 0;
+                for (size_t i = 0; i < bounds.lo.size(); ++i) {
+                    uint32_t lo = (bounds.lo[i] >> shift) & 0xFF;
+                    uint32_t hi = (bounds.hi[i] >> shift) & 0xFF;
+                    lo_sum += lo; hi_sum += hi;
+                    lo_sq += lo * lo; hi_sq += hi * hi;
+                }
+                sum_lo_[c] = lo_sum; sum_range_[c] = hi_sum - lo_sum;
+                square_lo_[c] = lo_sq; square_range_[c] = hi_sq - lo_sq;
+            }
+        }
+
+        /**
+         * @brief O(1) test of the candidate window with its top-left corner at (x, y).
+         */
+        bool Accepts(int x, int y) const noexcept {
+            for (int c = 0; c < 3; ++c) {
+                uint32_t sum = WindowSum(sums_.channels[c], sums_.stride, x, y, width_, height_);
+                if (sum - sum_lo_[c] > sum_range_[c]) return false;
+            }
+            if (squares_) {
+                for (int c = 0; c < 3; ++c) {
+                    uint32_t sum = WindowSum(squares_->channels[c], squares_->stride, x, y, width_, height_);
+                    if (sum - square_lo_[c] > square_range_[c]) return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Lower bound on the score (see PixelComparison::ScoreBounds_Scalar) of the window at
+         * (x, y). Per channel, the distance of the window sum to [sum(lo), sum(hi)] cannot exceed the
+         * sum of the per-pixel distances to [lo, hi].
+         */
+        uint64_t ScoreLowerBound(int x, int y) const noexcept {
+            uint64_t bound = 0;
+            for (int c = 0; c < 3; ++c) {
+                uint32_t sum = WindowSum(sums_.channels[c], sums_.stride, x, y, width_, height_);
+                uint32_t hi_sum = sum_lo_[c] + sum_range_[c];
+                if (sum < sum_lo_[c]) bound += sum_lo_[c] - sum;
+                else if (sum > hi_sum) bound += sum - hi_sum;
+            }
+            return bound;
+        }
+
+    private:
+        const IntegralImage& sums_;
+        const IntegralImage* squares_ = nullptr;
+        int width_, height_;
+        uint32_t sum_lo_[3], sum_range_[3];
+        uint32_t square_lo_[3], square_range_[3];
+    };
+}
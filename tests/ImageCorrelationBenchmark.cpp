@@ -0,0 +1,121 @@
+// =================================================================================================
+//
+// Name ............: ImageCorrelationBenchmark.cpp
+// Description .....: Times the FFT correlation search against the brute-force score kernels.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// On a synthetic capture (default 1920x1080: smooth gradients, flat panels and noise), for square
+// templates cut from it:
+// - FFT: ComputeSurface plus FindPeaks per template. The screen spectra and moment tables
+//   (BuildScreenData) are built once per call in the DLL and are timed separately.
+// - SAD: the best-score scan of the widest supported kernel set, one early-abandoning
+//   score_bounds call per position with the best score so far as the limit (count 1).
+// Both run on one core by default; the best of `runs` runs is reported. The FFT cost hardly depends
+// on the template size, the SAD cost grows with it, and the last column shows which is faster.
+//
+// Not a test: build it in Release and run it by hand.
+//   ImageCorrelationBenchmark [width height [threads [runs]]]
+//
+// =================================================================================================
+
+#include "ImageCorrelation.h"
+#include "ImageTemplate.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+    template <class Body>
+    double BestMilliseconds(int runs, Body&& body) {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    PixelBuffer MakeCapture(int width, int height) {
+        std::mt19937 rng(5);
+        PixelBuffer screen;
+        screen.width = width;
+        screen.height = height;
+        screen.pixels.resize(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                // Panels of 96x64 pixels: every third one flat, the others a gradient with noise.
+                const int panel = (x / 96) * 7 + (y / 64) * 3;
+                const int noise = static_cast<int>(rng() % 24);
+                const int r = panel % 3 == 0 ? 40 + panel % 100 : (x * 255 / width + noise) & 0xFF;
+                const int g = panel % 3 == 0 ? 90 : (y * 255 / height + noise) & 0xFF;
+                const int b = panel % 3 == 0 ? 160 : ((x + y) % 256 + noise) & 0xFF;
+                screen.pixels[static_cast<size_t>(y) * width + x] = RGB(r, g, b);
+            }
+        }
+        return screen;
+    }
+
+    PixelBuffer Cut(const PixelBuffer& screen, int x0, int y0, int size) {
+        PixelBuffer source;
+        source.width = source.height = size;
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) source.pixels.push_back(screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x]);
+        }
+        return source;
+    }
+
+    /**
+     * @brief Lowest score_bounds score over every position, scanned top to bottom, left to right.
+     */
+    uint64_t BestScore(const KernelTable& kernels, const PixelBuffer& screen, const ToleranceBounds& bounds) {
+        uint64_t best = UINT64_MAX;
+        for (int y = 0; y + bounds.height <= screen.height; ++y) {
+            for (int x = 0; x + bounds.width <= screen.width; ++x) {
+                best = std::min(best, kernels.score_bounds(screen, bounds, x, y, best));
+            }
+        }
+        return best;
+    }
+}
+
+int main(int argc, char** argv) {
+    const int width = argc > 2 ? std::atoi(argv[1]) : 1920;
+    const int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    const int threads = argc > 3 ? std::atoi(argv[3]) : 1;
+    const int runs = argc > 4 ? std::atoi(argv[4]) : 3;
+
+    const KernelTable& kernels = KernelTableFor(DetectSimdLevel());
+    const PixelBuffer screen = MakeCapture(width, height);
+    constexpr COLORREF kNoTransparency = 0xFFFFFFFF;
+
+    Correlation::ScreenData data;
+    const double screen_ms = BestMilliseconds(runs, [&] { data = Correlation::BuildScreenData(screen, threads); });
+    std::printf("%dx%d capture, %d thread(s), %ls score kernels, best of %d\n", width, height, threads, GetSimdLevelName(kernels.level), runs);
+    std::printf("screen spectra and moment tables: %.1f ms once per call\n\n", screen_ms);
+    std::printf("template       FFT ms      SAD ms   faster\n");
+
+    for (int size : { 4, 8, 16, 32, 48, 64, 96, 128 }) {
+        if (size > width || size > height) break;
+        // Columns 96..191 hold gradient panels, so the template is never flat.
+        const PixelBuffer source = Cut(screen, std::min(100, width - size), (height - size) / 2, size);
+        size_t peaks = 0;
+        const double fft_ms = BestMilliseconds(runs, [&] {
+            const Correlation::Surface surface = Correlation::ComputeSurface(data, screen, source, kNoTransparency, threads);
+            peaks = Correlation::FindPeaks(surface, 0.9f).size();
+        });
+
+        const ToleranceBounds bounds = TemplateAnalysis::BuildToleranceBounds(source, kNoTransparency, 0, nullptr);
+        uint64_t best = 0;
+        const double sad_ms = BestMilliseconds(runs, [&] { best = BestScore(kernels, screen, bounds); });
+
+        std::printf("%3dx%-3d   %10.1f  %10.1f   %s%s\n", size, size, fft_ms, sad_ms, fft_ms < sad_ms ? "FFT" : "SAD",
+            peaks == 0 || best != 0 ? "  (missed the template!)" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,248 @@
+// =================================================================================================
+//
+// Name ............: ImageCorrelationTest.cpp
+// Description .....: Checks of the FFT and the correlation surface in ImageCorrelation.h.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// - The complex FFT (single and interleaved sequences) and the real FFT match a naive DFT at every
+//   power-of-two size up to 1024, and the inverse real FFT restores its input.
+// - The correlation surface matches a brute-force evaluation of its definition on small random
+//   screens with transparent template pixels and flat (zero-variance) windows, which must come out
+//   as exactly 0. Templates that are flat, fully transparent or larger than the screen give no
+//   surface, a planted copy with changed brightness and contrast is found as a peak, and the
+//   result does not depend on the thread count.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImageCorrelationTest.cpp -o ImageCorrelationTest
+//
+// =================================================================================================
+
+#include "ImageCorrelation.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Correlation::Complex;
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(13);
+
+    int Random(int count) {
+        return static_cast<int>(g_rng() % static_cast<unsigned>(count));
+    }
+
+    float RandomSample() {
+        return std::uniform_real_distribution<float>(-1.0f, 1.0f)(g_rng);
+    }
+
+    /**
+     * @brief Naive DFT in double precision; `inverse` flips the sign of the exponent, unscaled.
+     */
+    std::vector<std::complex<double>> Dft(const std::vector<Complex>& input, bool inverse) {
+        const int size = static_cast<int>(input.size());
+        const double sign = inverse ? 1.0 : -1.0;
+        std::vector<std::complex<double>> output(size);
+        for (int k = 0; k < size; ++k) {
+            for (int n = 0; n < size; ++n) {
+                const double angle = sign * 6.283185307179586 * static_cast<double>((static_cast<int64_t>(k) * n) % size) / size;
+                output[k] += std::complex<double>(input[n]) * std::complex<double>(std::cos(angle), std::sin(angle));
+            }
+        }
+        return output;
+    }
+
+    // Largest difference relative to the largest expected value; float FFTs stay well below 1e-5.
+    double RelativeError(const Complex* actual, const std::vector<std::complex<double>>& expected, size_t count, size_t stride = 1) {
+        double largest = 1.0, error = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            largest = std::max(largest, std::abs(expected[i]));
+            error = std::max(error, std::abs(std::complex<double>(actual[i * stride]) - expected[i]));
+        }
+        return error / largest;
+    }
+
+    void CheckFft() {
+        for (int bits = 0; bits <= 10; ++bits) {
+            const int size = 1 << bits;
+            const Correlation::FftPlan plan(size);
+            std::vector<Complex> input(size);
+            for (Complex& value : input) value = { RandomSample(), RandomSample() };
+
+            for (bool inverse : { false, true }) {
+                const std::vector<std::complex<double>> expected = Dft(input, inverse);
+                std::vector<Complex> single = input;
+                plan.Transform(single.data(), inverse);
+                Check(RelativeError(single.data(), expected, size) < 1e-5, "complex FFT", size, inverse);
+
+                // Three interleaved sequences: the input and two others.
+                constexpr int kCount = 3;
+                std::vector<Complex> many(static_cast<size_t>(size) * kCount);
+                for (int i = 0; i < size; ++i) {
+                    many[static_cast<size_t>(i) * kCount] = input[i];
+                    many[static_cast<size_t>(i) * kCount + 1] = { RandomSample(), 0.0f };
+                    many[static_cast<size_t>(i) * kCount + 2] = { 0.0f, RandomSample() };
+                }
+                plan.TransformMany(many.data(), kCount, inverse);
+                Check(RelativeError(many.data(), expected, size, kCount) < 1e-5, "interleaved FFT", size, inverse);
+            }
+
+            if (size < 2) continue;
+            const Correlation::RealFftPlan real_plan(size);
+            std::vector<float> samples(size);
+            std::vector<Complex> as_complex(size);
+            for (int i = 0; i < size; ++i) as_complex[i] = samples[i] = RandomSample();
+            std::vector<Complex> bins(real_plan.Bins()), scratch(size / 2);
+            real_plan.Forward(samples.data(), bins.data(), scratch.data());
+            Check(real_plan.Bins() == size / 2 + 1, "real FFT bins", size, real_plan.Bins());
+            Check(RelativeError(bins.data(), Dft(as_complex, false), bins.size()) < 1e-5, "real FFT", size);
+
+            std::vector<float> restored(size);
+            real_plan.Inverse(bins.data(), restored.data(), scratch.data());
+            double error = 0.0;
+            for (int i = 0; i < size; ++i) error = std::max(error, std::abs(restored[i] / (size / 2.0) - samples[i]));
+            Check(error < 1e-5, "inverse real FFT", size);
+        }
+    }
+
+    /**
+     * @brief The correlation coefficient at (x, y) as ComputeSurface defines it, in double precision.
+     * Sets `flat` if the window variance is below the threshold, where the surface holds 0.
+     */
+    double BruteForceCoefficient(const PixelBuffer& screen, const PixelBuffer& source, COLORREF transparent_color,
+        const double means[3], double energy, int x0, int y0, bool& flat) {
+
+        double numerator = 0.0, variance = 0.0;
+        const double area = static_cast<double>(source.width) * source.height;
+        for (int c = 0; c < 3; ++c) {
+            uint64_t sum = 0, square = 0;
+            for (int y = 0; y < source.height; ++y) {
+                for (int x = 0; x < source.width; ++x) {
+                    const uint64_t value = (screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x] >> (8 * c)) & 0xFF;
+                    sum += value;
+                    square += value * value;
+                    const COLORREF pixel = source.pixels[static_cast<size_t>(y) * source.width + x];
+                    if (pixel != transparent_color) numerator += (((pixel >> (8 * c)) & 0xFF) - means[c]) * static_cast<double>(value);
+                }
+            }
+            variance += static_cast<double>(square) - static_cast<double>(sum) * static_cast<double>(sum) / area;
+        }
+        flat = variance < area * Correlation::kMinWindowVariance;
+        return flat ? 0.0 : std::clamp(numerator / std::sqrt(energy * variance), -1.0, 1.0);
+    }
+
+    /**
+     * @brief Compares ComputeSurface with BruteForceCoefficient at every position.
+     * @return The surface computed with one thread.
+     */
+    Correlation::Surface CheckSurface(const PixelBuffer& screen, const PixelBuffer& source, COLORREF transparent_color, int iteration) {
+        const Correlation::ScreenData data = Correlation::BuildScreenData(screen, 1);
+        const Correlation::Surface surface = Correlation::ComputeSurface(data, screen, source, transparent_color, 1);
+
+        // Every stage splits its work into independent bands, so any thread count gives the same bits.
+        const Correlation::ScreenData threaded_data = Correlation::BuildScreenData(screen, 4);
+        const Correlation::Surface threaded = Correlation::ComputeSurface(threaded_data, screen, source, transparent_color, 4);
+        Check(threaded.values == surface.values, "same surface on 4 threads", iteration);
+
+        double means[3] = {}, energy = 0.0;
+        size_t opaque = 0;
+        for (COLORREF pixel : source.pixels) {
+            if (pixel == transparent_color) continue;
+            ++opaque;
+            for (int c = 0; c < 3; ++c) means[c] += (pixel >> (8 * c)) & 0xFF;
+        }
+        for (int c = 0; c < 3 && opaque > 0; ++c) means[c] /= static_cast<double>(opaque);
+        for (COLORREF pixel : source.pixels) {
+            if (pixel == transparent_color) continue;
+            for (int c = 0; c < 3; ++c) energy += std::pow(((pixel >> (8 * c)) & 0xFF) - means[c], 2);
+        }
+
+        const bool fits = source.width <= screen.width && source.height <= screen.height;
+        if (!fits || opaque == 0 || energy < 1.0) {
+            Check(surface.values.empty(), "no surface", iteration, fits, static_cast<int>(opaque));
+            return surface;
+        }
+        Check(surface.width == screen.width - source.width + 1 && surface.height == screen.height - source.height + 1,
+            "surface size", iteration, surface.width, surface.height);
+        if (surface.values.size() != static_cast<size_t>(surface.width) * surface.height) return surface;
+
+        for (int y = 0; y < surface.height; ++y) {
+            for (int x = 0; x < surface.width; ++x) {
+                bool flat = false;
+                const double expected = BruteForceCoefficient(screen, source, transparent_color, means, energy, x, y, flat);
+                const float actual = surface.values[static_cast<size_t>(y) * surface.width + x];
+                if (flat) Check(actual == 0.0f, "flat window is 0", iteration, x, y);
+                else Check(std::abs(actual - expected) < 1e-3, "coefficient", iteration, x, y, static_cast<int>(expected * 1000));
+            }
+        }
+        return surface;
+    }
+
+    PixelBuffer RandomImage(int width, int height) {
+        PixelBuffer image;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(static_cast<size_t>(width) * height);
+        for (COLORREF& pixel : image.pixels) pixel = static_cast<COLORREF>(g_rng()) & 0x00FFFFFF;
+        return image;
+    }
+
+    void FillRect(PixelBuffer& image, int x0, int y0, int width, int height, COLORREF color) {
+        for (int y = y0; y < y0 + height; ++y) {
+            for (int x = x0; x < x0 + width; ++x) image.pixels[static_cast<size_t>(y) * image.width + x] = color;
+        }
+    }
+
+    void CheckCorrelation() {
+        constexpr COLORREF kTransparent = 0x00FF00FF;
+        for (int iteration = 0; iteration < 300; ++iteration) {
+            PixelBuffer screen = RandomImage(1 + Random(40), 1 + Random(30));
+            PixelBuffer source = RandomImage(1 + Random(std::min(screen.width, 12)), 1 + Random(std::min(screen.height, 12)));
+
+            // Flat areas at least as large as the template, so some windows have no variance at all.
+            for (int areas = Random(3); areas > 0; --areas) {
+                const int width = std::min(screen.width, source.width + Random(6)), height = std::min(screen.height, source.height + Random(6));
+                FillRect(screen, Random(screen.width - width + 1), Random(screen.height - height + 1), width, height, static_cast<COLORREF>(g_rng()) & 0x00FFFFFF);
+            }
+            if (iteration % 4 == 1) {
+                for (COLORREF& pixel : source.pixels) if (Random(4) == 0) pixel = kTransparent;
+            }
+            if (iteration % 10 == 2) source.pixels.assign(source.pixels.size(), 0x00406080);   // Flat template.
+            if (iteration % 10 == 3) source.pixels.assign(source.pixels.size(), kTransparent);  // Fully transparent.
+            if (iteration % 10 == 4) source = RandomImage(screen.width + 1, 2);                 // Does not fit.
+            CheckSurface(screen, source, kTransparent, iteration);
+        }
+
+        // A copy of the template with lower contrast and a brightness offset is still a perfect match.
+        PixelBuffer screen = RandomImage(48, 32);
+        const PixelBuffer source = RandomImage(9, 7);
+        for (int y = 0; y < source.height; ++y) {
+            for (int x = 0; x < source.width; ++x) {
+                COLORREF pixel = 0;
+                for (int c = 0; c < 3; ++c) pixel |= static_cast<COLORREF>(((source.pixels[y * source.width + x] >> (8 * c)) & 0xFF) / 2 + 60) << (8 * c);
+                screen.pixels[static_cast<size_t>(11 + y) * screen.width + 23 + x] = pixel;
+            }
+        }
+        const Correlation::Surface surface = CheckSurface(screen, source, kTransparent, -1);
+        const std::vector<std::pair<int, int>> peaks = Correlation::FindPeaks(surface, 0.9f);
+        Check(surface.values.size() > 23 && surface.values[11 * surface.width + 23] > 0.99f, "planted copy correlates");
+        Check(peaks.size() == 1 && peaks[0] == std::make_pair(23, 11), "planted copy is the only peak", static_cast<int>(peaks.size()));
+    }
+}
+
+int main() {
+    CheckFft();
+    CheckCorrelation();
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+// =================================================================================================
+//
+// Name ............: ImageExactMatchTest.cpp
+// Description .....: Checks of the rolling-hash engine in ImageExactMatch.h.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// ExactMatch::Scan2D (fully opaque templates) and ExactMatch::ScanSpan (templates with transparent
+// pixels) must report exactly the positions a brute-force exact scan finds, in the same order:
+// - on random screens with templates cut from them;
+// - on repetitive screens (tiled patterns, two-color noise) where a template matches in many places;
+// - on an adversarial screen full of hash collisions. Thue-Morse sequences of 2048 pixels and their
+//   complements have the same polynomial hash modulo 2^64 for every odd base, so every complement
+//   window is a hash hit that only the verification can reject. This holds along rows (the row hash)
+//   and along columns (the vertical hash of Scan2D).
+// SearchForBitmap with strategy=exact must return the brute-force matches as well.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImageExactMatchTest.cpp -o ImageExactMatchTest -lpthread
+//
+// =================================================================================================
+
+#include "ImageSearchCore.h"
+
+#include <bit>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(5);
+
+    int Random(int count) {
+        return static_cast<int>(g_rng() % static_cast<unsigned>(count));
+    }
+
+    constexpr COLORREF kTransparent = 0x00FF00FF;
+
+    using Positions = std::vector<std::pair<int, int>>;
+
+    PixelBuffer MakeImage(int width, int height) {
+        PixelBuffer image;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(static_cast<size_t>(width) * height);
+        return image;
+    }
+
+    COLORREF& At(PixelBuffer& image, int x, int y) {
+        return image.pixels[static_cast<size_t>(y) * image.width + x];
+    }
+
+    /**
+     * @brief True if every constrained pixel of `bounds` equals the screen pixel under it at (x, y).
+     */
+    bool ExactAt(const PixelBuffer& screen, const ToleranceBounds& bounds, int x, int y) {
+        for (int ty = 0; ty < bounds.height; ++ty) {
+            for (int tx = 0; tx < bounds.width; ++tx) {
+                const size_t i = static_cast<size_t>(ty) * bounds.width + tx;
+                if (TemplateAnalysis::IsUnconstrained(bounds.lo[i], bounds.hi[i])) continue;
+                const COLORREF pixel = screen.pixels[static_cast<size_t>(y + ty) * screen.width + x + tx];
+                if ((pixel & 0x00FFFFFF) != (bounds.lo[i] & 0x00FFFFFF)) return false;
+            }
+        }
+        return true;
+    }
+
+    Positions BruteForce(const PixelBuffer& screen, const ToleranceBounds& bounds) {
+        Positions found;
+        for (int y = 0; y + bounds.height <= screen.height; ++y) {
+            for (int x = 0; x + bounds.width <= screen.width; ++x) {
+                if (ExactAt(screen, bounds, x, y)) found.emplace_back(x, y);
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief Runs the engine SearchForBitmap picks for the template and compares it with BruteForce.
+     * @param expect_2d Which of Scan2D and ScanSpan the template must select.
+     * @return The number of hash hits the engine had to verify.
+     */
+    size_t CheckScan(const PixelBuffer& screen, const PixelBuffer& source, bool expect_2d, int iteration) {
+        int trim_x = 0, trim_y = 0;
+        const ToleranceBounds bounds = TemplateAnalysis::TrimTransparentBorder(
+            TemplateAnalysis::BuildToleranceBounds(source, kTransparent, 0, nullptr), trim_x, trim_y);
+        const OpaqueSpan span = ExactMatch::LongestSpan(bounds);
+        Check(ExactMatch::IsExact(bounds) && span.length > 0, "exact template", iteration);
+        Check(ExactMatch::IsFullyConstrained(bounds) == expect_2d, "engine choice", iteration, expect_2d);
+        if (bounds.width > screen.width || bounds.height > screen.height || span.length == 0) return 0;
+
+        const Positions expected = BruteForce(screen, bounds);
+        const int max_x = screen.width - bounds.width, max_y = screen.height - bounds.height;
+        size_t verified = 0;
+        Positions found;
+        auto verify = [&](int x, int y) { ++verified; return ExactAt(screen, bounds, x, y); };
+        auto on_match = [&](int x, int y) { found.emplace_back(x, y); return true; };
+        auto never = [] { return false; };
+        if (expect_2d) ExactMatch::Scan2D(screen, bounds, max_x, max_y, verify, on_match, never);
+        else ExactMatch::ScanSpan(screen, bounds, span, max_x, max_y, verify, on_match, never);
+        Check(found == expected, "matches brute force", iteration, static_cast<int>(found.size()), static_cast<int>(expected.size()));
+        const size_t hash_hits = verified;
+
+        // A first-match scan stops at the first brute-force match.
+        Positions first;
+        auto on_first = [&](int x, int y) { first.emplace_back(x, y); return false; };
+        if (expect_2d) ExactMatch::Scan2D(screen, bounds, max_x, max_y, verify, on_first, never);
+        else ExactMatch::ScanSpan(screen, bounds, span, max_x, max_y, verify, on_first, never);
+        Check(first == Positions(expected.begin(), expected.begin() + std::min<size_t>(expected.size(), 1)), "first match", iteration);
+
+        // The engine as SearchForBitmap runs it, with the reported rectangle of the untrimmed template.
+        SearchOptions options;
+        options.strategy = SearchStrategy::ExactHash;
+        options.threads = 1;
+        const std::vector<MatchResult> matches = SearchForBitmap(screen, source, 0, 0, 0, kTransparent, true, options);
+        bool same = matches.size() == expected.size();
+        for (size_t i = 0; same && i < matches.size(); ++i) {
+            same = matches[i].x == expected[i].first - trim_x && matches[i].y == expected[i].second - trim_y &&
+                matches[i].w == source.width && matches[i].h == source.height;
+        }
+        Check(same, "SearchForBitmap matches brute force", iteration, static_cast<int>(matches.size()), static_cast<int>(expected.size()));
+        return hash_hits;
+    }
+
+    PixelBuffer Cut(const PixelBuffer& screen, int x0, int y0, int width, int height) {
+        PixelBuffer source = MakeImage(width, height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) At(source, x, y) = screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x];
+        }
+        return source;
+    }
+
+    /**
+     * @brief Random, two-color and tiled screens with templates cut from them; every fourth
+     * template gets transparent pixels, which selects ScanSpan.
+     */
+    void CheckRandomCases() {
+        for (int iteration = 0; iteration < 600; ++iteration) {
+            PixelBuffer screen = MakeImage(1 + Random(120), 1 + Random(50));
+            const int kind = iteration % 3;
+            const int period_x = 1 + Random(5), period_y = 1 + Random(4);
+            const COLORREF tile_seed = static_cast<COLORREF>(g_rng());
+            for (int y = 0; y < screen.height; ++y) {
+                for (int x = 0; x < screen.width; ++x) {
+                    COLORREF pixel = static_cast<COLORREF>(g_rng()) & 0x00FFFFFF;           // Random.
+                    if (kind == 1) pixel = Random(2) ? 0x00102030 : 0x00405060;              // Two colors.
+                    if (kind == 2) pixel = (tile_seed * (1 + x % period_x) * (3 + 2 * (y % period_y))) & 0x00FFFFFF;   // Tiled.
+                    // The alpha byte of a capture is not part of the color.
+                    At(screen, x, y) = pixel == kTransparent ? 0 : pixel | (Random(2) ? 0xFF000000 : 0);
+                }
+            }
+            const int width = 1 + Random(std::min(screen.width, 9)), height = 1 + Random(std::min(screen.height, 6));
+            PixelBuffer source = Cut(screen, Random(screen.width - width + 1), Random(screen.height - height + 1), width, height);
+            for (COLORREF& pixel : source.pixels) pixel &= 0x00FFFFFF;
+            bool transparent = false;
+            if (iteration % 4 == 3 && source.pixels.size() > 1) {
+                // Keep at least one opaque pixel; fully transparent templates never reach the engine.
+                for (size_t i = 1; i < source.pixels.size(); ++i) {
+                    if (Random(3) == 0) { source.pixels[i] = kTransparent; transparent = true; }
+                }
+            }
+            // Trimming may leave a fully constrained core, which Scan2D then handles.
+            int trim_x = 0, trim_y = 0;
+            const bool fully = ExactMatch::IsFullyConstrained(TemplateAnalysis::TrimTransparentBorder(
+                TemplateAnalysis::BuildToleranceBounds(source, kTransparent, 0, nullptr), trim_x, trim_y));
+            Check(fully || transparent, "transparent pixels only from the test", iteration);
+            CheckScan(screen, source, fully, iteration);
+        }
+    }
+
+    /**
+     * @brief The adversarial case: 2048-pixel Thue-Morse rows and columns among their complements.
+     */
+    void CheckHashCollisions() {
+        constexpr int kLength = 2048;
+        constexpr COLORREF kColors[2] = { 0x00102030, 0x00405060 };
+        auto thue_morse = [&](int i, bool complement) { return kColors[(std::popcount(static_cast<unsigned>(i)) & 1) ^ complement]; };
+
+        // Rows: every screen row holds the complement sequence at some offset, and two of them the
+        // sequence itself. Each complement is a hash hit at its offset.
+        PixelBuffer screen = MakeImage(kLength + 15, 40);
+        for (int y = 0; y < screen.height; ++y) {
+            for (int x = 0; x < screen.width; ++x) At(screen, x, y) = 0x00777777;
+            const bool genuine = y == 17 || y == 31;
+            for (int i = 0; i < kLength; ++i) At(screen, y % 16 + i, y) = thue_morse(i, !genuine);
+        }
+        PixelBuffer source = MakeImage(kLength, 1);
+        for (int i = 0; i < kLength; ++i) At(source, i, 0) = thue_morse(i, false);
+        size_t verified = CheckScan(screen, source, true, -1);
+        Check(verified == static_cast<size_t>(screen.height), "every row verified once", static_cast<int>(verified));
+
+        // The same row with a transparent pixel below it goes through ScanSpan.
+        PixelBuffer spanned = MakeImage(kLength, 2);
+        for (int i = 0; i < kLength; ++i) {
+            At(spanned, i, 0) = thue_morse(i, false);
+            At(spanned, i, 1) = kTransparent;
+        }
+        At(spanned, 5, 1) = 0x00777777;
+        verified = CheckScan(screen, spanned, false, -2);
+        Check(verified == static_cast<size_t>(screen.height - 1), "every span verified once", static_cast<int>(verified));
+
+        // Columns: a one-pixel-wide template's row hashes are its pixel values, so the vertical hash
+        // of Scan2D collides the same way.
+        PixelBuffer columns = MakeImage(24, kLength + 7);
+        for (int x = 0; x < columns.width; ++x) {
+            for (int y = 0; y < columns.height; ++y) At(columns, x, y) = 0x00777777;
+            for (int i = 0; i < kLength; ++i) At(columns, x, x % 8 + i) = thue_morse(i, x != 9);
+        }
+        PixelBuffer column = MakeImage(1, kLength);
+        for (int i = 0; i < kLength; ++i) At(column, 0, i) = thue_morse(i, false);
+        verified = CheckScan(columns, column, true, -3);
+        Check(verified == static_cast<size_t>(columns.width), "every column verified once", static_cast<int>(verified));
+    }
+}
+
+int main() {
+    CheckRandomCases();
+    CheckHashCollisions();
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
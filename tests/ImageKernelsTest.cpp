@@ -0,0 +1,315 @@
+// =================================================================================================
+//
+// Name ............: ImageKernelsTest.cpp
+// Description .....: Cross-checks of the comparison kernels in ImageKernels.h against scalar.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// Every kernel of every SIMD level the CPU supports is run on random data next to its scalar
+// counterpart (or, for the probe kernels that have none, a per-lane scalar reference), and the
+// results must be identical:
+// - CheckBoundsMatch, including the packed 2- and 4-row AVX2 kernels of templates up to 4 pixels
+//   wide, CountMismatches and ScoreBounds on templates cut from the screen, with transparent
+//   pixels, so that candidates match, fail by a few pixels, or fail outright;
+// - ProbeCandidates and ProbeCandidatesBudget with the template's own probe pixels;
+// - ConvertToLuma, SobelRow, and the byte-plane check and probe on luma and gradient bounds;
+// - Deinterleave, and the planar check and probe;
+// - MarkInBounds.
+// Screens are either random or drawn from a 3-color palette, so that many candidates match.
+// Levels the CPU lacks are reported and skipped.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImageKernelsTest.cpp -o ImageKernelsTest
+//
+// =================================================================================================
+
+#include "ImageTemplate.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(7);
+
+    int Random(int count) {
+        return static_cast<int>(g_rng() % static_cast<unsigned>(count));
+    }
+
+    constexpr COLORREF kTransparent = 0x00FF00FF;
+
+    /**
+     * @brief A screen of random pixels, or of pixels from a 3-color palette (random alpha bytes).
+     */
+    PixelBuffer MakeScreen(int width, int height, bool palette) {
+        const COLORREF colors[] = { 0x00204060, 0x00224462, 0x00A0A0A0 };
+        PixelBuffer screen;
+        screen.width = width;
+        screen.height = height;
+        screen.pixels.resize(static_cast<size_t>(width) * height);
+        for (COLORREF& pixel : screen.pixels) {
+            pixel = palette ? colors[Random(3)] | (static_cast<COLORREF>(Random(256)) << 24) : static_cast<COLORREF>(g_rng());
+        }
+        return screen;
+    }
+
+    /**
+     * @brief Cuts a template out of the screen, makes about a fifth of its pixels transparent, and
+     * then changes a few screen pixels under it, so the cut position matches only with enough tolerance.
+     */
+    PixelBuffer CutTemplate(PixelBuffer& screen, int x0, int y0, int width, int height) {
+        PixelBuffer source;
+        source.width = width;
+        source.height = height;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const COLORREF pixel = screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x];
+                source.pixels.push_back(Random(5) == 0 ? kTransparent : pixel & 0x00FFFFFF);
+            }
+        }
+        for (int changes = Random(4); changes > 0; --changes) {
+            COLORREF& pixel = screen.pixels[static_cast<size_t>(y0 + Random(height)) * screen.width + x0 + Random(width)];
+            pixel ^= static_cast<COLORREF>(Random(64)) << (8 * Random(3));
+        }
+        return source;
+    }
+
+    // Per-lane references of the probe kernels, which have no scalar version.
+    uint32_t ProbeReference(const PixelBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int lanes, int budget) {
+        uint32_t survivors = 0;
+        for (int lane = 0; lane < lanes; ++lane) {
+            int failures = 0;
+            for (const AnchorPixel& probe : probes) {
+                const COLORREF pixel = screen.pixels[static_cast<size_t>(start_y + probe.y) * screen.width + start_x + lane + probe.x];
+                failures += !PixelComparison::PixelWithinBounds(pixel, probe.lo, probe.hi);
+            }
+            if (failures <= budget) survivors |= 1u << lane;
+        }
+        return survivors;
+    }
+
+    uint32_t ProbeBytesReference(const BytePlane& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int lanes) {
+        uint32_t survivors = 0;
+        for (int lane = 0; lane < lanes; ++lane) {
+            bool passed = true;
+            for (const AnchorPixel& probe : probes) {
+                const uint8_t value = screen.pixels[static_cast<size_t>(start_y + probe.y) * screen.width + start_x + lane + probe.x];
+                passed &= value >= GetRValue(probe.lo) && value <= GetRValue(probe.hi);
+            }
+            if (passed) survivors |= 1u << lane;
+        }
+        return survivors;
+    }
+
+    uint32_t ProbePlanarReference(const PlanarBuffer& screen, const std::vector<AnchorPixel>& probes, int start_x, int start_y, int lanes) {
+        uint32_t survivors = 0;
+        for (int lane = 0; lane < lanes; ++lane) {
+            bool passed = true;
+            for (const AnchorPixel& probe : probes) {
+                const size_t offset = static_cast<size_t>(start_y + probe.y) * screen.width + start_x + lane + probe.x;
+                for (int c = 0; c < 3; ++c) {
+                    const uint8_t value = screen.planes[c][offset];
+                    passed &= value >= static_cast<uint8_t>(probe.lo >> (8 * c)) && value <= static_cast<uint8_t>(probe.hi >> (8 * c));
+                }
+            }
+            if (passed) survivors |= 1u << lane;
+        }
+        return survivors;
+    }
+
+    BytePlane ToPlane(const std::vector<uint8_t>& pixels, int width, int height) {
+        BytePlane plane;
+        plane.pixels = pixels;
+        plane.width = width;
+        plane.height = height;
+        return plane;
+    }
+
+    /**
+     * @brief The 32-bit kernels: full checks, mismatch counts, scores and probes.
+     */
+    void CheckPixelKernels(const KernelTable& kernels, const PixelBuffer& screen, const ToleranceBounds& bounds, int iteration) {
+        const KernelTable& scalar = KernelTableFor(SimdLevel::Scalar);
+        const std::vector<AnchorPixel> anchors = TemplateAnalysis::SelectAnchorPixels(bounds);
+        const std::vector<AnchorPixel> probes = TemplateAnalysis::SelectProbePixels(bounds, anchors);
+        const int last_x = screen.width - bounds.width, last_y = screen.height - bounds.height;
+        const int budget = Random(4);
+
+        for (int y = 0; y <= last_y; ++y) {
+            for (int x = 0; x <= last_x; ++x) {
+                const bool expected = scalar.check_bounds(screen, bounds, x, y);
+                Check(kernels.check_bounds(screen, bounds, x, y) == expected, "check_bounds", iteration, x, y, bounds.packed_rows);
+
+                const int mismatches = scalar.count_mismatches(screen, bounds, x, y, budget);
+                Check(kernels.count_mismatches(screen, bounds, x, y, budget) == mismatches, "count_mismatches", iteration, x, y, mismatches);
+
+                // Below the limit the score is exact; above it, any value past the limit will do.
+                const uint64_t score = scalar.score_bounds(screen, bounds, x, y, UINT64_MAX);
+                Check(kernels.score_bounds(screen, bounds, x, y, UINT64_MAX) == score, "score_bounds", iteration, x, y, static_cast<int>(score));
+                const uint64_t limit = score / 2;
+                const uint64_t abandoned = kernels.score_bounds(screen, bounds, x, y, limit);
+                Check(score <= limit ? abandoned == score : abandoned > limit, "score_bounds limit", iteration, x, y, static_cast<int>(score));
+
+                if (!kernels.probe_candidates || probes.empty() || x + kernels.probe_lanes - 1 > last_x) continue;
+                Check(kernels.probe_candidates(screen, probes, x, y) == ProbeReference(screen, probes, x, y, kernels.probe_lanes, 0),
+                    "probe_candidates", iteration, x, y);
+                Check(kernels.probe_candidates_budget(screen, probes, x, y, budget) == ProbeReference(screen, probes, x, y, kernels.probe_lanes, budget),
+                    "probe_candidates_budget", iteration, x, y, budget);
+            }
+        }
+    }
+
+    /**
+     * @brief The byte-plane kernels on a luma or gradient plane of the screen.
+     */
+    void CheckByteKernels(const KernelTable& kernels, const BytePlane& screen, const ToleranceBounds& gray, int iteration) {
+        const KernelTable& scalar = KernelTableFor(SimdLevel::Scalar);
+        const ByteBounds bounds = TemplateAnalysis::ToByteBounds(gray);
+        const std::vector<AnchorPixel> probes = TemplateAnalysis::SelectProbePixels(gray, TemplateAnalysis::SelectAnchorPixels(gray));
+        const int last_x = screen.width - bounds.width, last_y = screen.height - bounds.height;
+
+        for (int y = 0; y <= last_y; ++y) {
+            for (int x = 0; x <= last_x; ++x) {
+                Check(kernels.check_bytes(screen, bounds, x, y) == scalar.check_bytes(screen, bounds, x, y), "check_bytes", iteration, x, y);
+                if (!kernels.probe_bytes || probes.empty() || x + kernels.plane_lanes - 1 > last_x) continue;
+                Check(kernels.probe_bytes(screen, probes, x, y) == ProbeBytesReference(screen, probes, x, y, kernels.plane_lanes),
+                    "probe_bytes", iteration, x, y);
+            }
+        }
+    }
+
+    /**
+     * @brief The planar kernels, on the scalar deinterleaved screen.
+     */
+    void CheckPlanarKernels(const KernelTable& kernels, const PixelBuffer& screen, const ToleranceBounds& bounds, int iteration) {
+        const KernelTable& scalar = KernelTableFor(SimdLevel::Scalar);
+        PlanarBuffer planar;
+        planar.width = screen.width;
+        planar.height = screen.height;
+        for (auto& plane : planar.planes) plane.resize(screen.pixels.size());
+        scalar.deinterleave(screen.pixels.data(), { planar.planes[0].data(), planar.planes[1].data(), planar.planes[2].data() }, screen.pixels.size());
+
+        const PlanarBounds planar_bounds = TemplateAnalysis::ToPlanarBounds(bounds);
+        const std::vector<AnchorPixel> probes = TemplateAnalysis::SelectProbePixels(bounds, TemplateAnalysis::SelectAnchorPixels(bounds));
+        const int last_x = screen.width - bounds.width, last_y = screen.height - bounds.height;
+
+        for (int y = 0; y <= last_y; ++y) {
+            for (int x = 0; x <= last_x; ++x) {
+                Check(kernels.check_planar(planar, planar_bounds, x, y) == scalar.check_planar(planar, planar_bounds, x, y), "check_planar", iteration, x, y);
+                if (!kernels.probe_planar || probes.empty() || x + kernels.plane_lanes - 1 > last_x) continue;
+                Check(kernels.probe_planar(planar, probes, x, y) == ProbePlanarReference(planar, probes, x, y, kernels.plane_lanes),
+                    "probe_planar", iteration, x, y);
+            }
+        }
+    }
+
+    void CheckSearchKernels(const KernelTable& kernels) {
+        const KernelTable& scalar = KernelTableFor(SimdLevel::Scalar);
+        for (int iteration = 0; iteration < 120; ++iteration) {
+            // Screens at least 72 pixels wider than the template, so that 32-lane probes fit.
+            const bool narrow = iteration % 3 == 0;
+            const int width = narrow ? 1 + Random(4) : 1 + Random(40), height = 1 + Random(narrow ? 12 : 20);
+            PixelBuffer screen = MakeScreen(width + 72 + Random(30), height + Random(24), iteration % 2 == 0);
+            const PixelBuffer source = CutTemplate(screen, Random(screen.width - width + 1), Random(screen.height - height + 1), width, height);
+            const int tolerance = Random(3) == 0 ? 0 : Random(48);
+
+            const ToleranceBounds bounds = TemplateAnalysis::BuildToleranceBounds(source, kTransparent, tolerance, nullptr);
+            CheckPixelKernels(kernels, screen, bounds, iteration);
+            CheckPlanarKernels(kernels, screen, bounds, iteration);
+
+            std::vector<uint8_t> luma(screen.pixels.size()), gradient(screen.pixels.size());
+            scalar.convert_luma(screen.pixels.data(), luma.data(), luma.size());
+            for (int y = 1; y + 1 < screen.height; ++y) {
+                const size_t row = static_cast<size_t>(y) * screen.width;
+                scalar.sobel_row(&luma[row - screen.width], &luma[row], &luma[row + screen.width], &gradient[row], screen.width);
+            }
+            CheckByteKernels(kernels, ToPlane(luma, screen.width, screen.height),
+                TemplateAnalysis::BuildLumaToleranceBounds(source, kTransparent, tolerance, nullptr), iteration);
+            CheckByteKernels(kernels, ToPlane(gradient, screen.width, screen.height),
+                TemplateAnalysis::BuildGradientToleranceBounds(source, kTransparent, tolerance, nullptr), iteration);
+        }
+    }
+
+    /**
+     * @brief The row conversions, at every length up to a few vectors and at unaligned offsets.
+     */
+    void CheckRowKernels(const KernelTable& kernels) {
+        const KernelTable& scalar = KernelTableFor(SimdLevel::Scalar);
+        for (int count = 0; count < 200; ++count) {
+            const int offset = Random(16);
+            std::vector<COLORREF> pixels(offset + count);
+            for (COLORREF& pixel : pixels) pixel = static_cast<COLORREF>(g_rng());
+            const COLORREF* row = pixels.data() + offset;
+
+            std::vector<uint8_t> expected(count + 1), actual(count + 1);
+            scalar.convert_luma(row, expected.data(), count);
+            kernels.convert_luma(row, actual.data(), count);
+            Check(actual == expected, "convert_luma", count, offset);
+
+            std::array<std::vector<uint8_t>, 3> expected_planes, actual_planes;
+            for (int c = 0; c < 3; ++c) {
+                expected_planes[c].assign(count + 1, 0);
+                actual_planes[c].assign(count + 1, 0);
+            }
+            scalar.deinterleave(row, { expected_planes[0].data(), expected_planes[1].data(), expected_planes[2].data() }, count);
+            kernels.deinterleave(row, { actual_planes[0].data(), actual_planes[1].data(), actual_planes[2].data() }, count);
+            Check(actual_planes == expected_planes, "deinterleave", count, offset);
+
+            // Bounds around one pixel of the row, with the alpha byte constrained or not.
+            const COLORREF center = count > 0 ? row[Random(count)] : 0x80808080;
+            const int tolerance = Random(80);
+            COLORREF lo = 0, hi = 0;
+            for (int c = 0; c < 4; ++c) {
+                const int value = (center >> (8 * c)) & 0xFF;
+                const bool free_alpha = c == 3 && count % 2 == 0;
+                lo |= static_cast<COLORREF>(free_alpha ? 0 : std::max(0, value - tolerance)) << (8 * c);
+                hi |= static_cast<COLORREF>(free_alpha ? 255 : std::min(255, value + tolerance)) << (8 * c);
+            }
+            std::fill(expected.begin(), expected.end(), 0);
+            std::fill(actual.begin(), actual.end(), 0);
+            scalar.mark_in_bounds(row, lo, hi, expected.data(), count);
+            kernels.mark_in_bounds(row, lo, hi, actual.data(), count);
+            Check(actual == expected, "mark_in_bounds", count, offset, tolerance);
+
+            // Sobel rows: three luma rows of the same width, with outputs at both unaligned ends.
+            std::vector<uint8_t> lines(3 * (count + 16));
+            for (uint8_t& value : lines) value = static_cast<uint8_t>(g_rng());
+            const uint8_t* above = lines.data() + offset;
+            const uint8_t* middle = above + count + 1;
+            const uint8_t* below = middle + count + 1;
+            std::fill(expected.begin(), expected.end(), 0xAA);
+            std::fill(actual.begin(), actual.end(), 0xAA);
+            if (count > 0) {
+                scalar.sobel_row(above, middle, below, expected.data(), count);
+                kernels.sobel_row(above, middle, below, actual.data(), count);
+            }
+            Check(actual == expected, "sobel_row", count, offset);
+        }
+    }
+}
+
+int main() {
+    const SimdLevel detected = DetectSimdLevel();
+    for (SimdLevel level : { SimdLevel::SSE2, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512BW }) {
+        if (level > detected) {
+            std::printf("%ls not supported, skipped\n", GetSimdLevelName(level));
+            continue;
+        }
+        const int failures = g_failures;
+        const KernelTable& kernels = KernelTableFor(level);
+        CheckSearchKernels(kernels);
+        CheckRowKernels(kernels);
+        std::printf("%ls: %d failure(s)\n", GetSimdLevelName(level), g_failures - failures);
+    }
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// =================================================================================================
+//
+// Name ............: ImagePlanarBenchmark.cpp
+// Description .....: Times layout=planar against layout=interleaved on full HD and 4K captures.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// On a low-contrast noise capture (the case the planar layout is meant for) of 1920x1080 and
+// 3840x2160 pixels, 8, 32 and 128 pixel wide templates of 32 rows are cut from the capture and
+// searched with SearchForBitmap: tolerance 8, find-all, Auto strategy. Each planar run starts from
+// an empty ScreenCache, so its time includes the deinterleave pass, which is also timed on its own.
+// One core by default; the best of `runs` runs is reported.
+//
+// Not a test: build it in Release and run it by hand.
+//   ImagePlanarBenchmark [isa [threads [runs]]]      isa: scalar, sse2, sse41, avx2 or avx512
+//
+// =================================================================================================
+
+#include "ImageSearchCore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    template <class Body>
+    double BestMilliseconds(int runs, Body&& body) {
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    PixelBuffer MakeCapture(int width, int height) {
+        std::mt19937 rng(17);
+        PixelBuffer screen;
+        screen.width = width;
+        screen.height = height;
+        screen.pixels.resize(static_cast<size_t>(width) * height);
+        for (COLORREF& pixel : screen.pixels) pixel = RGB(100 + rng() % 24, 110 + rng() % 24, 120 + rng() % 24);
+        return screen;
+    }
+
+    PixelBuffer Cut(const PixelBuffer& screen, int x0, int y0, int width, int height) {
+        PixelBuffer source;
+        source.width = width;
+        source.height = height;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) source.pixels.push_back(screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x]);
+        }
+        return source;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::optional<SimdLevel> level;
+    if (argc > 1) {
+        const std::string name(argv[1]);
+        level = ParseSimdLevel(std::wstring(name.begin(), name.end()));
+        if (!level) {
+            std::printf("unknown isa '%s'\n", argv[1]);
+            return 1;
+        }
+    }
+    SearchOptions options;
+    options.simd_level = level;
+    options.threads = argc > 2 ? std::atoi(argv[2]) : 1;
+    const int runs = argc > 3 ? std::atoi(argv[3]) : 5;
+    constexpr COLORREF kNoTransparency = 0xFFFFFFFF;
+    constexpr int kTolerance = 8;
+
+    const KernelTable& kernels = GetKernelTable(level);
+    std::printf("%ls kernels, %d thread(s), best of %d, tolerance %d, find-all\n\n", GetSimdLevelName(kernels.level),
+        ResolveThreadCount(options.threads), runs, kTolerance);
+    std::printf("capture     template   interleaved ms   planar ms   faster\n");
+
+    for (const auto& [width, height] : { std::pair{ 1920, 1080 }, std::pair{ 3840, 2160 } }) {
+        const PixelBuffer screen = MakeCapture(width, height);
+        const double split_ms = BestMilliseconds(runs, [&] { ScreenCache(screen).Planar(kernels); });
+        std::printf("%4dx%-4d   split                      %9.1f\n", width, height, split_ms);
+
+        for (int template_width : { 8, 32, 128 }) {
+            const PixelBuffer source = Cut(screen, width / 2, height / 2, template_width, 32);
+            size_t interleaved_count = 0, planar_count = 0;
+
+            options.layout = PixelLayout::Interleaved;
+            const double interleaved_ms = BestMilliseconds(runs, [&] {
+                interleaved_count = SearchForBitmap(screen, source, 0, 0, kTolerance, kNoTransparency, true, options).size();
+            });
+            options.layout = PixelLayout::Planar;
+            const double planar_ms = BestMilliseconds(runs, [&] {
+                planar_count = SearchForBitmap(screen, source, 0, 0, kTolerance, kNoTransparency, true, options).size();
+            });
+
+            std::printf("%4dx%-4d   %3dx32   %14.1f   %9.1f   %s%s\n", width, height, template_width, interleaved_ms, planar_ms,
+                planar_ms < interleaved_ms ? "planar" : "interleaved",
+                interleaved_count == 0 || planar_count != interleaved_count ? "  (results differ or template missed!)" : "");
+        }
+    }
+    return 0;
+}
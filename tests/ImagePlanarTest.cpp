@@ -0,0 +1,164 @@
+// =================================================================================================
+//
+// Name ............: ImagePlanarTest.cpp
+// Description .....: Checks that layout=planar finds exactly what layout=interleaved finds.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// SearchForBitmap runs with PixelLayout::Planar and PixelLayout::Interleaved on the same screens and
+// templates, at every kernel level the CPU supports, and must return the same matches in the same
+// order. The cases cover noisy, low-contrast and few-color screens (many matches), templates with
+// transparent pixels, tolerance maps, both window statistics modes, first-match and find-all
+// searches, OverlapPolicy::NoOverlap, the mismatch budget (which falls back to interleaved), and a
+// large capture scanned in bands on several threads.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImagePlanarTest.cpp -o ImagePlanarTest -lpthread
+//
+// =================================================================================================
+
+#include "ImageSearchCore.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(17);
+
+    int Random(int count) {
+        return static_cast<int>(g_rng() % static_cast<unsigned>(count));
+    }
+
+    constexpr COLORREF kTransparent = 0x00FF00FF;
+
+    /**
+     * @brief A screen of one of three kinds: full-range noise, low-contrast noise around a gray, or
+     * a three-color palette on which small templates match in many places.
+     */
+    PixelBuffer RandomScreen(int width, int height, int kind) {
+        static const COLORREF palette[3] = { 0x00202020, 0x00C08040, 0x00FFFFFF };
+        PixelBuffer screen;
+        screen.width = width;
+        screen.height = height;
+        screen.pixels.resize(static_cast<size_t>(width) * height);
+        for (COLORREF& pixel : screen.pixels) {
+            if (kind == 0) pixel = static_cast<COLORREF>(g_rng()) & 0x00FFFFFF;
+            else if (kind == 1) pixel = RGB(100 + Random(24), 110 + Random(24), 120 + Random(24));
+            else pixel = palette[Random(3)];
+        }
+        return screen;
+    }
+
+    /**
+     * @brief A template cut from the screen at (x0, y0), with each channel moved by up to `jitter`.
+     */
+    PixelBuffer Cut(const PixelBuffer& screen, int x0, int y0, int width, int height, int jitter) {
+        PixelBuffer source;
+        source.width = width;
+        source.height = height;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const COLORREF pixel = screen.pixels[static_cast<size_t>(y0 + y) * screen.width + x0 + x];
+                int channels[3];
+                for (int c = 0; c < 3; ++c) {
+                    const int value = static_cast<int>((pixel >> (8 * c)) & 0xFF) + (jitter ? Random(2 * jitter + 1) - jitter : 0);
+                    channels[c] = std::clamp(value, 0, 255);
+                }
+                // Never the transparent color by accident.
+                const COLORREF cut = RGB(channels[0], channels[1], channels[2]);
+                source.pixels.push_back(cut == kTransparent ? cut - 1 : cut);
+            }
+        }
+        return source;
+    }
+
+    bool SameMatches(const std::vector<MatchResult>& a, const std::vector<MatchResult>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const MatchResult& m, const MatchResult& n) {
+            return m.x == n.x && m.y == n.y && m.w == n.w && m.h == n.h;
+        });
+    }
+
+    /**
+     * @brief Searches with both layouts and checks that the results agree.
+     * @return The interleaved result.
+     */
+    std::vector<MatchResult> CheckLayouts(const PixelBuffer& screen, const PixelBuffer& source, int tolerance, bool find_all,
+        SearchOptions options, const PixelBuffer* tolerance_map, int iteration) {
+
+        options.layout = PixelLayout::Interleaved;
+        const std::vector<MatchResult> interleaved = SearchForBitmap(screen, source, 0, 0, tolerance, kTransparent, find_all, options, tolerance_map);
+        options.layout = PixelLayout::Planar;
+        const std::vector<MatchResult> planar = SearchForBitmap(screen, source, 0, 0, tolerance, kTransparent, find_all, options, tolerance_map);
+        Check(SameMatches(interleaved, planar), "planar matches interleaved", iteration, static_cast<int>(*options.simd_level),
+            static_cast<int>(interleaved.size()), static_cast<int>(planar.size()));
+        return interleaved;
+    }
+
+    void CheckRandomCases(SimdLevel level) {
+        for (int iteration = 0; iteration < 400; ++iteration) {
+            const PixelBuffer screen = RandomScreen(1 + Random(160), 1 + Random(60), iteration % 3);
+            const int width = 1 + Random(std::min(screen.width, 40)), height = 1 + Random(std::min(screen.height, 12));
+            const int x0 = Random(screen.width - width + 1), y0 = Random(screen.height - height + 1);
+            const int tolerance = std::array{ 0, 4, 8, 30 }[Random(4)];
+            PixelBuffer source = Cut(screen, x0, y0, width, height, tolerance / 2);
+            if (iteration % 4 == 1) {
+                for (COLORREF& pixel : source.pixels) if (Random(5) == 0) pixel = kTransparent;
+            }
+
+            PixelBuffer tolerance_map;
+            if (iteration % 8 == 3) {
+                tolerance_map.width = width;
+                tolerance_map.height = height;
+                for (int i = 0; i < width * height; ++i) tolerance_map.pixels.push_back(RGB(Random(40), Random(40), Random(40)));
+            }
+
+            SearchOptions options;
+            options.simd_level = level;
+            options.threads = 1;
+            options.window_stats = std::array{ WindowStatsMode::Off, WindowStatsMode::Mean, WindowStatsMode::MeanVariance }[Random(3)];
+            if (Random(3) == 0) options.overlap = OverlapPolicy::NoOverlap;
+            if (iteration % 10 == 7) options.mismatch_count = 1 + Random(3);
+            const bool find_all = Random(4) != 0;
+
+            const std::vector<MatchResult> matches = CheckLayouts(screen, source, tolerance, find_all, options,
+                tolerance_map.pixels.empty() ? nullptr : &tolerance_map, iteration);
+            // The template was cut from the screen, so without a jitter or a tolerance map it is always found.
+            if (tolerance == 0 && tolerance_map.pixels.empty()) Check(!matches.empty(), "cut template found", iteration);
+        }
+    }
+
+    void CheckBands(SimdLevel level) {
+        // Large enough for ScanBands to split it into bands; the template sits near the bottom.
+        const PixelBuffer screen = RandomScreen(640, 480, 1);
+        const PixelBuffer source = Cut(screen, 301, 407, 24, 16, 0);
+        for (int threads : { 1, 4 }) {
+            for (bool find_all : { false, true }) {
+                SearchOptions options;
+                options.simd_level = level;
+                options.threads = threads;
+                const std::vector<MatchResult> matches = CheckLayouts(screen, source, 8, find_all, options, nullptr, threads);
+                Check(!matches.empty() && matches.back().x == 301 && matches.back().y == 407, "banded search finds the template", threads, find_all);
+            }
+        }
+    }
+}
+
+int main() {
+    const SimdLevel detected = DetectSimdLevel();
+    for (int level = 0; level <= static_cast<int>(detected); ++level) {
+        CheckRandomCases(static_cast<SimdLevel>(level));
+        CheckBands(static_cast<SimdLevel>(level));
+    }
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
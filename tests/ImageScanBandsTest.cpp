@@ -0,0 +1,195 @@
+// =================================================================================================
+//
+// Name ............: ImageScanBandsTest.cpp
+// Description .....: Checks of the band scheduler and merge of ScanBands in ImageSearchCore.h.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// ScanBands runs a row scanner over a grid of synthetic hits on 1 to 16 threads. The result must
+// equal a plain top-to-bottom, left-to-right scan of the hits:
+// - first match, the first k matches, and every match;
+// - with an exclusion rectangle (overlap=none): hits are dense and the rectangles taller than a
+//   band, so band matches conflict across boundaries and the bands are rescanned in the merge.
+// Whatever the bands do, the reported kernel calls must equal the calls the scanner made, also when
+// a first match abandons the bands below it and when a cancelled ResultLimit stops the scan.
+// SearchForBitmap must return the same matches for every thread count as well.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImageScanBandsTest.cpp -o ImageScanBandsTest -lpthread
+//
+// =================================================================================================
+
+#include "ImageSearchCore.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(6);
+
+    using Positions = std::vector<std::pair<int, int>>;
+
+    // Large enough that ScanBands splits the rows into bands (at least 256K candidates).
+    constexpr int kMaxX = 1023, kMaxY = 383;
+    const int kThreadCounts[] = { 1, 2, 3, 4, 8, 16 };
+
+    /**
+     * @brief A (kMaxX + 1) x (kMaxY + 1) grid of hits with the given density, optionally only in
+     * the rows from `first_row` down.
+     */
+    std::vector<uint8_t> MakeHits(double density, int first_row = 0) {
+        std::vector<uint8_t> hits(static_cast<size_t>(kMaxX + 1) * (kMaxY + 1), 0);
+        std::bernoulli_distribution hit(density);
+        for (int y = first_row; y <= kMaxY; ++y) {
+            for (int x = 0; x <= kMaxX; ++x) hits[static_cast<size_t>(y) * (kMaxX + 1) + x] = hit(g_rng);
+        }
+        return hits;
+    }
+
+    /**
+     * @brief The definition: hits in scan order, each one excluding the positions its rectangle
+     * covers from later matches, up to max_matches of them.
+     */
+    Positions Reference(const std::vector<uint8_t>& hits, size_t max_matches, int exclusion_width, int exclusion_height) {
+        Positions found;
+        const bool exclusive = max_matches > 1 && exclusion_width > 0 && exclusion_height > 0;
+        std::vector<uint8_t> accepted(hits.size(), 0);
+        // True if an accepted match at or above row y, whose rectangle reaches (x, y), exists.
+        auto covered = [&](int x, int y) {
+            for (int ay = std::max(0, y - exclusion_height + 1); ay <= y; ++ay) {
+                for (int ax = std::max(0, x - exclusion_width + 1); ax <= std::min(kMaxX, x + exclusion_width - 1); ++ax) {
+                    if (accepted[static_cast<size_t>(ay) * (kMaxX + 1) + ax]) return true;
+                }
+            }
+            return false;
+        };
+        for (int y = 0; y <= kMaxY && found.size() < max_matches; ++y) {
+            for (int x = 0; x <= kMaxX && found.size() < max_matches; ++x) {
+                const size_t i = static_cast<size_t>(y) * (kMaxX + 1) + x;
+                if (!hits[i] || (exclusive && covered(x, y))) continue;
+                if (exclusive) accepted[i] = 1;
+                found.emplace_back(x, y);
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief Runs ScanBands over `hits` with a scanner that follows the ScanCandidates contract.
+     * Checks that kernel_calls equals the number of candidates the scanner tested.
+     */
+    Positions Scan(const std::vector<uint8_t>& hits, size_t max_matches, int threads, int exclusion_width, int exclusion_height,
+        const ResultLimit* result_limit, const char* what) {
+
+        std::atomic<size_t> tested{ 0 };
+        auto scan_row = [&](int y, size_t& calls, const OverlapGuard* guard, auto&& emit) {
+            for (int x = 0; x <= kMaxX; ++x) {
+                if (guard && guard->Blocked(x, y)) continue;
+                ++calls;
+                tested.fetch_add(1, std::memory_order_relaxed);
+                if (hits[static_cast<size_t>(y) * (kMaxX + 1) + x] && !emit(x)) return false;
+            }
+            return true;
+        };
+        Positions found;
+        size_t kernel_calls = 0;
+        ScanBands(kMaxX, kMaxY, max_matches, threads, exclusion_width, exclusion_height, result_limit, kernel_calls, scan_row,
+            [&](int x, int y) { found.emplace_back(x, y); return true; });
+        Check(kernel_calls == tested.load(), what, threads, static_cast<int>(kernel_calls), static_cast<int>(tested.load()));
+        return found;
+    }
+
+    void CheckMerge() {
+        struct Case {
+            double density;
+            int first_row;
+        };
+        // Sparse, medium and dense hits; none at all; and hits only in the last band, so a first
+        // match is found late and every band above runs to its end.
+        const Case cases[] = { { 1e-4, 0 }, { 1e-2, 0 }, { 0.3, 0 }, { 0.0, 0 }, { 1e-3, kMaxY - 4 } };
+        for (const Case& c : cases) {
+            const std::vector<uint8_t> hits = MakeHits(c.density, c.first_row);
+            for (size_t max_matches : { size_t{ 1 }, size_t{ 7 }, SIZE_MAX }) {
+                const Positions expected = Reference(hits, max_matches, 0, 0);
+                for (int threads : kThreadCounts) {
+                    Check(Scan(hits, max_matches, threads, 0, 0, nullptr, "kernel calls") == expected, "bands match the serial scan",
+                        threads, static_cast<int>(max_matches == SIZE_MAX ? -1 : max_matches), static_cast<int>(expected.size()));
+                }
+            }
+
+            // Exclusion rectangles up to 40 rows tall, where bands are 3 to 24 rows.
+            for (const auto& [width, height] : { std::pair{ 1, 1 }, std::pair{ 3, 3 }, std::pair{ 7, 40 }, std::pair{ 64, 5 } }) {
+                for (size_t max_matches : { size_t{ 5 }, SIZE_MAX }) {
+                    const Positions expected = Reference(hits, max_matches, width, height);
+                    for (int threads : kThreadCounts) {
+                        Check(Scan(hits, max_matches, threads, width, height, nullptr, "kernel calls with exclusion") == expected,
+                            "exclusive bands match the serial scan", threads, width, height, static_cast<int>(expected.size()));
+                    }
+                }
+            }
+        }
+    }
+
+    void CheckStopped() {
+        // A limit cancelled from outside (e.g. by an earlier scale step) once some work is done.
+        // The matches reported are a prefix of the serial ones, and every call is still counted.
+        const std::vector<uint8_t> hits = MakeHits(1e-3);
+        const Positions expected = Reference(hits, SIZE_MAX, 0, 0);
+        for (int threads : kThreadCounts) {
+            std::atomic<int> polls{ 0 };
+            const ResultLimit limit(SIZE_MAX, [&] { return polls.fetch_add(1) > 200; });
+            const Positions found = Scan(hits, SIZE_MAX, threads, 0, 0, &limit, "kernel calls when cancelled");
+            Check(found.size() <= expected.size() && std::equal(found.begin(), found.end(), expected.begin()), "cancelled scan is a prefix",
+                threads, static_cast<int>(found.size()));
+        }
+    }
+
+    void CheckSearch() {
+        // Three colors, so a 2x2 template matches in many places and overlap=none has conflicts.
+        PixelBuffer screen;
+        screen.width = 700;
+        screen.height = 500;
+        for (int i = 0; i < screen.width * screen.height; ++i) screen.pixels.push_back(std::array{ 0x00202020u, 0x00C08040u, 0x00FFFFFFu }[g_rng() % 3]);
+        PixelBuffer source;
+        source.width = source.height = 2;
+        source.pixels = { 0x00202020, 0x00C08040, 0x00C08040, 0x00FFFFFF };
+
+        for (OverlapPolicy overlap : { OverlapPolicy::All, OverlapPolicy::NoOverlap }) {
+            for (bool find_all : { false, true }) {
+                SearchOptions options;
+                options.strategy = SearchStrategy::PerCandidate;
+                options.overlap = overlap;
+                options.threads = 1;
+                const std::vector<MatchResult> serial = SearchForBitmap(screen, source, 0, 0, 0, 0xFFFFFFFF, find_all, options);
+                Check(!serial.empty(), "template found", find_all);
+                for (int threads : kThreadCounts) {
+                    options.threads = threads;
+                    const std::vector<MatchResult> banded = SearchForBitmap(screen, source, 0, 0, 0, 0xFFFFFFFF, find_all, options);
+                    const bool same = std::equal(serial.begin(), serial.end(), banded.begin(), banded.end(),
+                        [](const MatchResult& a, const MatchResult& b) { return a.x == b.x && a.y == b.y; });
+                    Check(same, "SearchForBitmap on several threads", threads, static_cast<int>(overlap), find_all, static_cast<int>(banded.size()));
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    CheckMerge();
+    CheckStopped();
+    CheckSearch();
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// =================================================================================================
+//
+// Name ............: ImageSolidMatchTest.cpp
+// Description .....: Checks of the run-length engine in ImageSolidMatch.h.
+//
+// -------------------------------------------------------------------------------------------------
+//
+// SolidMatch::Scan must report exactly the positions where every template pixel lies within its
+// bounds, found by brute force, in scan order, with the in-bounds kernel of every level the CPU
+// supports. The screens hold blocks of the template color (jittered within the tolerance, and
+// exactly on the bounds or one step outside them) that run into the right and bottom edges, and the
+// templates include:
+// - uniform fills, which report without verification, and non-uniform ones, which verify;
+// - colors spread by exactly SolidMatch::kMaxColorSpread per channel (still solid) and by one more
+//   (not solid), and colors at the 0 and 255 ends of the channel range;
+// - templates as wide and as tall as the screen.
+// SearchForBitmap picks the engine automatically for single-color templates and must return the
+// brute-force matches as well.
+//
+// Returns 0 if every check passes. Build with tests/CMakeLists.txt or any C++20 compiler:
+//   g++ -std=c++20 -O2 -I.. ImageSolidMatchTest.cpp -o ImageSolidMatchTest -lpthread
+//
+// =================================================================================================
+
+#include "ImageSearchCore.h"
+
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    int g_failures = 0;
+
+    void Check(bool passed, const char* what, int a = 0, int b = 0, int c = 0, int d = 0) {
+        if (passed) return;
+        ++g_failures;
+        std::printf("FAILED: %s (%d, %d, %d, %d)\n", what, a, b, c, d);
+    }
+
+    std::mt19937 g_rng(20);
+
+    int Random(int count) {
+        return static_cast<int>(g_rng() % static_cast<unsigned>(count));
+    }
+
+    constexpr COLORREF kTransparent = 0x00FF00FF;
+
+    using Positions = std::vector<std::pair<int, int>>;
+
+    int Channel(COLORREF color, int c) {
+        return static_cast<int>((color >> (8 * c)) & 0xFF);
+    }
+
+    COLORREF Shift(COLORREF color, int r, int g, int b) {
+        return RGB(std::clamp(Channel(color, 0) + r, 0, 255), std::clamp(Channel(color, 1) + g, 0, 255), std::clamp(Channel(color, 2) + b, 0, 255));
+    }
+
+    bool InBoundsAt(const PixelBuffer& screen, const ToleranceBounds& bounds, int x, int y) {
+        for (int ty = 0; ty < bounds.height; ++ty) {
+            for (int tx = 0; tx < bounds.width; ++tx) {
+                const size_t i = static_cast<size_t>(ty) * bounds.width + tx;
+                const COLORREF pixel = screen.pixels[static_cast<size_t>(y + ty) * screen.width + x + tx];
+                for (int c = 0; c < 3; ++c) {
+                    if (Channel(pixel, c) < Channel(bounds.lo[i], c) || Channel(pixel, c) > Channel(bounds.hi[i], c)) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Positions BruteForce(const PixelBuffer& screen, const ToleranceBounds& bounds) {
+        Positions found;
+        for (int y = 0; y + bounds.height <= screen.height; ++y) {
+            for (int x = 0; x + bounds.width <= screen.width; ++x) {
+                if (InBoundsAt(screen, bounds, x, y)) found.emplace_back(x, y);
+            }
+        }
+        return found;
+    }
+
+    /**
+     * @brief Compares SolidMatch::Scan at every supported level, and SearchForBitmap, with BruteForce.
+     * @param solid Whether SolidMatch::Analyze must accept the template.
+     */
+    void CheckScan(const PixelBuffer& screen, const PixelBuffer& source, int tolerance, bool solid, int iteration) {
+        const ToleranceBounds bounds = TemplateAnalysis::BuildToleranceBounds(source, kTransparent, tolerance, nullptr);
+        const std::optional<SolidMatch::Fill> fill = SolidMatch::Analyze(bounds);
+        Check(fill.has_value() == solid, "solid template", iteration, solid);
+        if (bounds.width > screen.width || bounds.height > screen.height) return;
+        const Positions expected = BruteForce(screen, bounds);
+
+        const int max_x = screen.width - bounds.width, max_y = screen.height - bounds.height;
+        for (int level = 0; fill && level <= static_cast<int>(DetectSimdLevel()); ++level) {
+            size_t verified = 0;
+            Positions found;
+            SolidMatch::Scan(screen, *fill, bounds.width, bounds.height, max_x, max_y, KernelTableFor(static_cast<SimdLevel>(level)).mark_in_bounds,
+                [&](int x, int y) { ++verified; return InBoundsAt(screen, bounds, x, y); },
+                [&](int x, int y) { found.emplace_back(x, y); return true; },
+                [] { return false; });
+            Check(found == expected, "matches brute force", iteration, level, static_cast<int>(found.size()), static_cast<int>(expected.size()));
+            if (fill->uniform) Check(verified == 0, "uniform fill is not verified", iteration, level, static_cast<int>(verified));
+        }
+
+        SearchOptions options;
+        options.threads = 1;
+        for (bool find_all : { false, true }) {
+            const std::vector<MatchResult> matches = SearchForBitmap(screen, source, 0, 0, tolerance, kTransparent, find_all, options);
+            const size_t count = find_all ? expected.size() : std::min<size_t>(expected.size(), 1);
+            bool same = matches.size() == count;
+            for (size_t i = 0; same && i < count; ++i) same = matches[i].x == expected[i].first && matches[i].y == expected[i].second;
+            Check(same, "SearchForBitmap matches brute force", iteration, find_all, static_cast<int>(matches.size()), static_cast<int>(count));
+        }
+    }
+
+    /**
+     * @brief Fills a screen with noise and blocks of pixels near `color`: within the tolerance, on
+     * its bounds, or one step outside them. Blocks often run into the right or bottom edge.
+     */
+    PixelBuffer MakeScreen(int width, int height, COLORREF color, int tolerance) {
+        PixelBuffer screen;
+        screen.width = width;
+        screen.height = height;
+        screen.pixels.resize(static_cast<size_t>(width) * height);
+        for (COLORREF& pixel : screen.pixels) pixel = static_cast<COLORREF>(g_rng()) & 0x00FFFFFF;
+        for (int blocks = 1 + Random(6); blocks > 0; --blocks) {
+            const int block_width = 1 + Random(width), block_height = 1 + Random(height);
+            const int x0 = Random(2) ? width - block_width : Random(width - block_width + 1);
+            const int y0 = Random(3) ? Random(height - block_height + 1) : height - block_height;
+            for (int y = y0; y < y0 + block_height; ++y) {
+                for (int x = x0; x < x0 + block_width; ++x) {
+                    const int kind = Random(16);
+                    const int step = kind == 0 ? tolerance + 1 : kind == 1 ? -tolerance - 1 : kind == 2 ? tolerance : kind == 3 ? -tolerance
+                        : Random(2 * tolerance + 1) - tolerance;
+                    int delta[3] = { 0, 0, 0 };
+                    delta[Random(3)] = step;
+                    // Alpha never takes part in the comparison.
+                    screen.pixels[static_cast<size_t>(y) * width + x] = Shift(color, delta[0], delta[1], delta[2]) | (Random(2) ? 0xFF000000 : 0);
+                }
+            }
+        }
+        return screen;
+    }
+
+    PixelBuffer SolidTemplate(int width, int height, COLORREF color) {
+        PixelBuffer source;
+        source.width = width;
+        source.height = height;
+        source.pixels.assign(static_cast<size_t>(width) * height, color);
+        return source;
+    }
+
+    void CheckRandomCases() {
+        const COLORREF extremes[] = { 0x00000000, 0x00FFFFFF, 0x0000FF00, 0x00FE0001 };
+        for (int iteration = 0; iteration < 500; ++iteration) {
+            const int width = 1 + Random(90), height = 1 + Random(40);
+            const COLORREF color = iteration % 5 == 4 ? extremes[Random(4)] : static_cast<COLORREF>(g_rng()) & 0x00FFFFFF;
+            if (color == kTransparent) continue;
+            const int tolerance = std::array{ 0, 1, 6, 20 }[Random(4)];
+            const PixelBuffer screen = MakeScreen(width, height, color, tolerance);
+
+            // Screen-wide and screen-tall templates every few iterations; otherwise small ones.
+            const int template_width = iteration % 7 == 0 ? width : 1 + Random(std::min(width, 12));
+            const int template_height = iteration % 11 == 0 ? height : 1 + Random(std::min(height, 8));
+            CheckScan(screen, SolidTemplate(template_width, template_height, color), tolerance, true, iteration);
+        }
+    }
+
+    /**
+     * @brief Templates whose colors spread by exactly kMaxColorSpread in one channel are still
+     * solid (non-uniform, so their hits are verified); one more makes them multi-colored.
+     */
+    void CheckColorSpread() {
+        constexpr int kSpread = SolidMatch::kMaxColorSpread;
+        int iteration = 1000;
+        for (int channel = 0; channel < 3; ++channel) {
+            for (int tolerance : { 0, 5 }) {
+                for (int spread : { kSpread, kSpread + 1 }) {
+                    for (int direction : { 1, -1 }) {
+                        const COLORREF color = RGB(100, 120, 140);
+                        int delta[3] = { 0, 0, 0 };
+                        delta[channel] = direction * spread;
+                        const COLORREF other = Shift(color, delta[0], delta[1], delta[2]);
+
+                        PixelBuffer source = SolidTemplate(2 + iteration % 5, 1 + iteration % 3, color);
+                        source.pixels.back() = other;
+                        // The screen holds both colors and the colors between them.
+                        PixelBuffer screen = MakeScreen(64, 24, color, tolerance);
+                        for (int y = 5; y < 15; ++y) {
+                            for (int x = 20; x < 64; ++x) {
+                                int step[3] = { 0, 0, 0 };
+                                step[channel] = direction * Random(spread + tolerance + 2);
+                                screen.pixels[static_cast<size_t>(y) * screen.width + x] = Shift(color, step[0], step[1], step[2]);
+                            }
+                        }
+                        CheckScan(screen, source, tolerance, spread <= kSpread, iteration++);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    CheckRandomCases();
+    CheckColorSpread();
+    std::printf("%d failure(s)\n", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}